@@ -21,9 +21,13 @@ FRAMEWORKHEADERSINSTALL = \
 HEADERS += \
     $$FRAMEWORKHEADERSINSTALL \
     maliit/namespaceinternal.h \
+    maliit/widgetstate.h \
+    maliit/textmirror.h \
 
 SOURCES += \
     maliit/settingdata.cpp \
+    maliit/widgetstate.cpp \
+    maliit/textmirror.cpp \
 
 frameworkheaders.path += $$INCLUDEDIR/$$MALIIT_FRAMEWORK_HEADER/maliit
 frameworkheaders.files += $$FRAMEWORKHEADERSINSTALL
@@ -0,0 +1,201 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "textmirror.h"
+
+namespace {
+    //! Number of pieces after which the text is rebuilt as a single piece
+    const int MaximumPieces(64);
+}
+
+namespace Maliit {
+
+TextMirror::TextMirror()
+    : mOriginal()
+    , mAdded(new QString)
+    , mPieces()
+    , mLength(0)
+    , mText()
+    , mTextValid(true)
+{
+}
+
+TextMirror::TextMirror(const QString &text)
+    : mOriginal(text)
+    , mAdded(new QString)
+    , mPieces()
+    , mLength(text.length())
+    , mText(text)
+    , mTextValid(true)
+{
+    if (mLength > 0) {
+        const Piece piece = { false, 0, mLength };
+        mPieces.append(piece);
+    }
+}
+
+QString TextMirror::text() const
+{
+    if (not mTextValid) {
+        mText = mid(0, mLength);
+        mTextValid = true;
+    }
+
+    return mText;
+}
+
+QString TextMirror::mid(int position, int length) const
+{
+    position = qBound(0, position, mLength);
+    length = qBound(0, length, mLength - position);
+
+    if (mTextValid) {
+        return mText.mid(position, length);
+    }
+
+    QString result;
+    result.reserve(length);
+
+    int pieceStart = 0;
+    Q_FOREACH (const Piece &piece, mPieces) {
+        if (result.length() == length) {
+            break;
+        }
+
+        const int pieceEnd = pieceStart + piece.length;
+        if (pieceEnd > position) {
+            const int from = qMax(position - pieceStart, 0);
+            const int count = qMin(piece.length - from, length - result.length());
+            result.append(pieceData(piece) + from, count);
+        }
+        pieceStart = pieceEnd;
+    }
+
+    return result;
+}
+
+bool TextMirror::insert(int position, const QString &text)
+{
+    if (position < 0 || position > mLength) {
+        return false;
+    }
+    if (text.isEmpty()) {
+        return true;
+    }
+
+    const int index = split(position);
+
+    // Typing appends to the piece inserted just before, no new piece is needed
+    if (index > 0
+        && mPieces.at(index - 1).added
+        && mPieces.at(index - 1).start + mPieces.at(index - 1).length == mAdded->length()) {
+        mPieces[index - 1].length += text.length();
+    } else {
+        const Piece piece = { true, mAdded->length(), text.length() };
+        mPieces.insert(index, piece);
+    }
+
+    mAdded->append(text);
+    mLength += text.length();
+    mTextValid = false;
+
+    if (mPieces.size() > MaximumPieces) {
+        compact();
+    }
+
+    return true;
+}
+
+bool TextMirror::remove(int position, int length)
+{
+    if (position < 0 || length < 0 || position + length > mLength) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+
+    const int first = split(position);
+    const int last = split(position + length);
+    mPieces.remove(first, last - first);
+
+    mLength -= length;
+    mTextValid = false;
+
+    if (mPieces.size() > MaximumPieces) {
+        compact();
+    }
+
+    return true;
+}
+
+bool TextMirror::replace(int position, int length, const QString &text)
+{
+    if (position < 0 || length < 0 || position + length > mLength) {
+        return false;
+    }
+
+    return remove(position, length) && insert(position, text);
+}
+
+bool TextMirror::operator==(const TextMirror &other) const
+{
+    return mLength == other.mLength && text() == other.text();
+}
+
+bool TextMirror::operator!=(const TextMirror &other) const
+{
+    return not operator==(other);
+}
+
+int TextMirror::split(int position)
+{
+    int pieceStart = 0;
+    for (int index = 0; index < mPieces.size(); ++index) {
+        if (pieceStart == position) {
+            return index;
+        }
+
+        const Piece piece = mPieces.at(index);
+        if (position < pieceStart + piece.length) {
+            const int head = position - pieceStart;
+            const Piece tail = { piece.added, piece.start + head, piece.length - head };
+            mPieces[index].length = head;
+            mPieces.insert(index + 1, tail);
+            return index + 1;
+        }
+        pieceStart += piece.length;
+    }
+
+    return mPieces.size();
+}
+
+void TextMirror::compact()
+{
+    mOriginal = text();
+    // Other copies may still point into the old buffer, start a new one
+    mAdded = QSharedPointer<QString>(new QString);
+    mPieces.clear();
+
+    if (mLength > 0) {
+        const Piece piece = { false, 0, mLength };
+        mPieces.append(piece);
+    }
+}
+
+const QChar *TextMirror::pieceData(const Piece &piece) const
+{
+    return (piece.added ? mAdded->constData() : mOriginal.constData()) + piece.start;
+}
+
+} // namespace Maliit
@@ -0,0 +1,88 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef MALIIT_TEXTMIRROR_H
+#define MALIIT_TEXTMIRROR_H
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+//! \internal
+namespace Maliit {
+
+/*! \internal
+ * \brief Copy of the editor text, kept as a piece table.
+ *
+ * The text is a list of pieces pointing either into the text it was created
+ * with or into a buffer which inserted text is appended to. Edits only change
+ * the list of pieces, so their cost depends on the number of pieces and the
+ * size of the edit, not on the length of the text. The list is compacted into
+ * a single piece once it grows too long.
+ *
+ * Copies share the text buffers, the buffer of inserted text is never
+ * modified except for appending to it. Copies must not be used from
+ * different threads.
+ */
+class TextMirror
+{
+public:
+    TextMirror();
+    explicit TextMirror(const QString &text);
+
+    int length() const { return mLength; }
+    bool isEmpty() const { return mLength == 0; }
+
+    //! Returns the whole text. Built on first use after an edit.
+    QString text() const;
+    //! Returns \a length characters starting at \a position, clamped to the text.
+    QString mid(int position, int length) const;
+
+    //! Inserts \a text at \a position, returns false if \a position is out of range.
+    bool insert(int position, const QString &text);
+    //! Removes \a length characters at \a position, returns false if the range is out of the text.
+    bool remove(int position, int length);
+    //! Replaces \a length characters at \a position by \a text.
+    bool replace(int position, int length, const QString &text);
+
+    //! Number of pieces, for tests.
+    int pieceCount() const { return mPieces.size(); }
+
+    bool operator==(const TextMirror &other) const;
+    bool operator!=(const TextMirror &other) const;
+
+private:
+    struct Piece
+    {
+        bool added; // in mAdded, otherwise in mOriginal
+        int start;
+        int length;
+    };
+
+    //! Makes \a position start a piece, returns the index of that piece.
+    int split(int position);
+    void compact();
+    const QChar *pieceData(const Piece &piece) const;
+
+    QString mOriginal;
+    QSharedPointer<QString> mAdded;
+    QVector<Piece> mPieces;
+    int mLength;
+
+    mutable QString mText;
+    mutable bool mTextValid;
+};
+
+} // namespace Maliit
+
+#endif // MALIIT_TEXTMIRROR_H
@@ -0,0 +1,468 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "widgetstate.h"
+
+#include <maliit/namespaceinternal.h>
+
+namespace {
+    struct AttributeKey
+    {
+        Maliit::WidgetState::Attribute attribute;
+        const char *key;
+    };
+
+    const AttributeKey AttributeKeys[] = {
+        { Maliit::WidgetState::FocusState, Maliit::WidgetStateAttribute::FocusState },
+        { Maliit::WidgetState::ContentType, Maliit::WidgetStateAttribute::ContentType },
+        { Maliit::WidgetState::Correction, Maliit::WidgetStateAttribute::Correction },
+        { Maliit::WidgetState::Prediction, Maliit::WidgetStateAttribute::Prediction },
+        { Maliit::WidgetState::AutoCapitalization, Maliit::WidgetStateAttribute::AutoCapitalization },
+        { Maliit::WidgetState::SurroundingText, Maliit::WidgetStateAttribute::SurroundingText },
+        { Maliit::WidgetState::AnchorPosition, Maliit::WidgetStateAttribute::AnchorPosition },
+        { Maliit::WidgetState::CursorPosition, Maliit::WidgetStateAttribute::CursorPosition },
+        { Maliit::WidgetState::HasSelection, Maliit::WidgetStateAttribute::HasSelection },
+        { Maliit::WidgetState::InputMethodMode, Maliit::WidgetStateAttribute::InputMethodMode },
+        { Maliit::WidgetState::WinId, Maliit::WidgetStateAttribute::WinId },
+        { Maliit::WidgetState::CursorRectangle, Maliit::WidgetStateAttribute::CursorRectangle },
+        { Maliit::WidgetState::HiddenText, Maliit::WidgetStateAttribute::HiddenText },
+        { Maliit::WidgetState::PreeditClickPos, Maliit::WidgetStateAttribute::PreeditClickPos },
+        { Maliit::WidgetState::ToolbarId, Maliit::WidgetStateAttribute::ToolbarId },
+        { Maliit::WidgetState::Toolbar, Maliit::WidgetStateAttribute::Toolbar },
+        { Maliit::WidgetState::VisualizationPriority, Maliit::WidgetStateAttribute::VisualizationPriority },
+        { Maliit::WidgetState::InputMethodHints, Maliit::Internal::inputMethodHints },
+        { Maliit::WidgetState::PreeditRectangle, Maliit::WidgetStateAttribute::PreeditRectangle },
+        { Maliit::WidgetState::Selection, Maliit::WidgetStateAttribute::Selection },
+        { Maliit::WidgetState::SurroundingTextOffset, Maliit::WidgetStateAttribute::SurroundingTextOffset },
+        { Maliit::WidgetState::SurroundingTextLength, Maliit::WidgetStateAttribute::SurroundingTextLength }
+    };
+
+    const int AttributeKeyCount = sizeof(AttributeKeys) / sizeof(AttributeKeys[0]);
+}
+
+namespace Maliit {
+
+WidgetState::WidgetState()
+    : mAttributes()
+    , mFocusState(false)
+    , mContentType(0)
+    , mCorrectionEnabled(false)
+    , mPredictionEnabled(false)
+    , mAutoCapitalizationEnabled(false)
+    , mSurroundingText()
+    , mAnchorPosition(0)
+    , mCursorPosition(0)
+    , mHasSelection(false)
+    , mInputMethodMode(0)
+    , mWinId(0)
+    , mCursorRectangle()
+    , mHiddenText(false)
+    , mPreeditClickPos(0)
+    , mToolbarId(0)
+    , mToolbar()
+    , mVisualizationPriority(false)
+    , mInputMethodHints(0)
+    , mPreeditRectangle()
+    , mSelection()
+    , mSurroundingTextOffset(0)
+    , mSurroundingTextLength(0)
+    , mExtensions()
+{}
+
+WidgetState WidgetState::fromVariantMap(const QVariantMap &map)
+{
+    WidgetState state;
+
+    for (QVariantMap::const_iterator iter = map.constBegin();
+         iter != map.constEnd();
+         ++iter) {
+        state.insert(iter.key(), iter.value());
+    }
+
+    return state;
+}
+
+QVariantMap WidgetState::toVariantMap() const
+{
+    QVariantMap map(mExtensions);
+
+    for (int i = 0; i < AttributeKeyCount; ++i) {
+        if (mAttributes & AttributeKeys[i].attribute) {
+            map.insert(QString::fromLatin1(AttributeKeys[i].key), value(AttributeKeys[i].attribute));
+        }
+    }
+
+    return map;
+}
+
+WidgetState::Attribute WidgetState::attributeForKey(const QString &key)
+{
+    for (int i = 0; i < AttributeKeyCount; ++i) {
+        if (key == QLatin1String(AttributeKeys[i].key)) {
+            return AttributeKeys[i].attribute;
+        }
+    }
+
+    return static_cast<Attribute>(0);
+}
+
+QString WidgetState::keyForAttribute(Attribute attribute)
+{
+    for (int i = 0; i < AttributeKeyCount; ++i) {
+        if (AttributeKeys[i].attribute == attribute) {
+            return QString::fromLatin1(AttributeKeys[i].key);
+        }
+    }
+
+    return QString();
+}
+
+WidgetState::Attributes WidgetState::attributes() const
+{
+    return mAttributes;
+}
+
+bool WidgetState::contains(Attribute attribute) const
+{
+    return mAttributes & attribute;
+}
+
+bool WidgetState::contains(const QString &key) const
+{
+    const Attribute attribute = attributeForKey(key);
+    return attribute ? contains(attribute) : mExtensions.contains(key);
+}
+
+bool WidgetState::isEmpty() const
+{
+    return !mAttributes && mExtensions.isEmpty();
+}
+
+void WidgetState::clear()
+{
+    *this = WidgetState();
+}
+
+QVariant WidgetState::value(const QString &key) const
+{
+    const Attribute attribute = attributeForKey(key);
+    return attribute ? value(attribute) : mExtensions.value(key);
+}
+
+void WidgetState::insert(const QString &key, const QVariant &value)
+{
+    const Attribute attribute = attributeForKey(key);
+
+    if (attribute) {
+        setValue(attribute, value);
+    } else if (value.isValid()) {
+        mExtensions.insert(key, value);
+    } else {
+        mExtensions.remove(key);
+    }
+}
+
+void WidgetState::remove(const QString &key)
+{
+    const Attribute attribute = attributeForKey(key);
+
+    if (attribute) {
+        remove(attribute);
+    } else {
+        mExtensions.remove(key);
+    }
+}
+
+QVariant WidgetState::value(Attribute attribute) const
+{
+    if (not contains(attribute)) {
+        return QVariant();
+    }
+
+    switch (attribute) {
+    case FocusState: return mFocusState;
+    case ContentType: return mContentType;
+    case Correction: return mCorrectionEnabled;
+    case Prediction: return mPredictionEnabled;
+    case AutoCapitalization: return mAutoCapitalizationEnabled;
+    case SurroundingText: return mSurroundingText.text();
+    case AnchorPosition: return mAnchorPosition;
+    case CursorPosition: return mCursorPosition;
+    case HasSelection: return mHasSelection;
+    case InputMethodMode: return mInputMethodMode;
+    case WinId: return mWinId;
+    case CursorRectangle: return mCursorRectangle;
+    case HiddenText: return mHiddenText;
+    case PreeditClickPos: return mPreeditClickPos;
+    case ToolbarId: return mToolbarId;
+    case Toolbar: return mToolbar;
+    case VisualizationPriority: return mVisualizationPriority;
+    case InputMethodHints: return mInputMethodHints;
+    case PreeditRectangle: return mPreeditRectangle;
+    case Selection: return mSelection;
+    case SurroundingTextOffset: return mSurroundingTextOffset;
+    case SurroundingTextLength: return mSurroundingTextLength;
+    }
+
+    return QVariant();
+}
+
+void WidgetState::setValue(Attribute attribute, const QVariant &value)
+{
+    if (not value.isValid()) {
+        remove(attribute);
+        return;
+    }
+
+    bool ok = true;
+
+    switch (attribute) {
+    case FocusState: setFocusState(value.toBool()); break;
+    case ContentType: setContentType(value.toInt(&ok)); break;
+    case Correction: setCorrectionEnabled(value.toBool()); break;
+    case Prediction: setPredictionEnabled(value.toBool()); break;
+    case AutoCapitalization: setAutoCapitalizationEnabled(value.toBool()); break;
+    case SurroundingText: setSurroundingText(value.toString()); break;
+    case AnchorPosition: setAnchorPosition(value.toInt()); break;
+    case CursorPosition: setCursorPosition(value.toInt()); break;
+    case HasSelection: setHasSelection(value.toBool()); break;
+    case InputMethodMode: setInputMethodMode(value.toInt(&ok)); break;
+    case WinId:
+        // after transfer by dbus type can change
+        switch (value.type()) {
+        case QVariant::UInt:
+            setWinId(value.toUInt());
+            break;
+        default:
+            setWinId(value.toULongLong());
+        }
+        break;
+    case CursorRectangle: setCursorRectangle(value.toRect()); break;
+    case HiddenText: setHiddenText(value.toBool()); break;
+    case PreeditClickPos: setPreeditClickPos(value.toInt()); break;
+    case ToolbarId: setToolbarId(value.toInt()); break;
+    case Toolbar: setToolbar(value.toString()); break;
+    case VisualizationPriority: setVisualizationPriority(value.toBool()); break;
+    case InputMethodHints: setInputMethodHints(value.toLongLong()); break;
+    case PreeditRectangle: setPreeditRectangle(value.toRect()); break;
+    case Selection: setSelection(value.toString()); break;
+    case SurroundingTextOffset: setSurroundingTextOffset(value.toInt(&ok)); break;
+    case SurroundingTextLength: setSurroundingTextLength(value.toInt(&ok)); break;
+    }
+
+    // Keep the old semantics of the map based accessors, where a
+    // non-numeric value made the attribute invalid
+    if (not ok) {
+        remove(attribute);
+    }
+}
+
+void WidgetState::remove(Attribute attribute)
+{
+    mAttributes &= ~Attributes(attribute);
+}
+
+QStringList WidgetState::changedKeys(const WidgetState &other) const
+{
+    QStringList keys;
+    const Attributes changed = changedAttributes(other);
+
+    for (int i = 0; i < AttributeKeyCount; ++i) {
+        if (changed & AttributeKeys[i].attribute) {
+            keys.append(QString::fromLatin1(AttributeKeys[i].key));
+        }
+    }
+
+    for (QVariantMap::const_iterator iter = mExtensions.constBegin();
+         iter != mExtensions.constEnd();
+         ++iter) {
+        if (other.mExtensions.value(iter.key()) != iter.value()) {
+            keys.append(iter.key());
+        }
+    }
+
+    return keys;
+}
+
+WidgetState::Attributes WidgetState::changedAttributes(const WidgetState &other) const
+{
+    Attributes changed;
+
+    for (int i = 0; i < AttributeKeyCount; ++i) {
+        const Attribute attribute = AttributeKeys[i].attribute;
+        if (not contains(attribute)) {
+            continue;
+        }
+
+        // the text is compared without building it when the lengths differ
+        if (not other.contains(attribute)
+            || (attribute == SurroundingText ? mSurroundingText != other.mSurroundingText
+                                             : value(attribute) != other.value(attribute))) {
+            changed |= attribute;
+        }
+    }
+
+    return changed;
+}
+
+bool WidgetState::operator==(const WidgetState &other) const
+{
+    return mAttributes == other.mAttributes
+        && not changedAttributes(other)
+        && mExtensions == other.mExtensions;
+}
+
+bool WidgetState::operator!=(const WidgetState &other) const
+{
+    return not operator==(other);
+}
+
+void WidgetState::setFocusState(bool focusState)
+{
+    mFocusState = focusState;
+    mAttributes |= FocusState;
+}
+
+void WidgetState::setContentType(int contentType)
+{
+    mContentType = contentType;
+    mAttributes |= ContentType;
+}
+
+void WidgetState::setCorrectionEnabled(bool enabled)
+{
+    mCorrectionEnabled = enabled;
+    mAttributes |= Correction;
+}
+
+void WidgetState::setPredictionEnabled(bool enabled)
+{
+    mPredictionEnabled = enabled;
+    mAttributes |= Prediction;
+}
+
+void WidgetState::setAutoCapitalizationEnabled(bool enabled)
+{
+    mAutoCapitalizationEnabled = enabled;
+    mAttributes |= AutoCapitalization;
+}
+
+void WidgetState::setSurroundingText(const QString &text)
+{
+    mSurroundingText = TextMirror(text);
+    mAttributes |= SurroundingText;
+}
+
+bool WidgetState::editSurroundingText(int position, int removeLength, const QString &text)
+{
+    return contains(SurroundingText)
+           && mSurroundingText.replace(position, removeLength, text);
+}
+
+void WidgetState::setAnchorPosition(int position)
+{
+    mAnchorPosition = position;
+    mAttributes |= AnchorPosition;
+}
+
+void WidgetState::setCursorPosition(int position)
+{
+    mCursorPosition = position;
+    mAttributes |= CursorPosition;
+}
+
+void WidgetState::setHasSelection(bool hasSelection)
+{
+    mHasSelection = hasSelection;
+    mAttributes |= HasSelection;
+}
+
+void WidgetState::setInputMethodMode(int mode)
+{
+    mInputMethodMode = mode;
+    mAttributes |= InputMethodMode;
+}
+
+void WidgetState::setWinId(qulonglong winId)
+{
+    mWinId = winId;
+    mAttributes |= WinId;
+}
+
+void WidgetState::setCursorRectangle(const QRect &rect)
+{
+    mCursorRectangle = rect;
+    mAttributes |= CursorRectangle;
+}
+
+void WidgetState::setHiddenText(bool hidden)
+{
+    mHiddenText = hidden;
+    mAttributes |= HiddenText;
+}
+
+void WidgetState::setPreeditClickPos(int position)
+{
+    mPreeditClickPos = position;
+    mAttributes |= PreeditClickPos;
+}
+
+void WidgetState::setToolbarId(int id)
+{
+    mToolbarId = id;
+    mAttributes |= ToolbarId;
+}
+
+void WidgetState::setToolbar(const QString &toolbar)
+{
+    mToolbar = toolbar;
+    mAttributes |= Toolbar;
+}
+
+void WidgetState::setVisualizationPriority(bool priority)
+{
+    mVisualizationPriority = priority;
+    mAttributes |= VisualizationPriority;
+}
+
+void WidgetState::setInputMethodHints(qint64 hints)
+{
+    mInputMethodHints = hints;
+    mAttributes |= InputMethodHints;
+}
+
+void WidgetState::setPreeditRectangle(const QRect &rect)
+{
+    mPreeditRectangle = rect;
+    mAttributes |= PreeditRectangle;
+}
+
+void WidgetState::setSelection(const QString &selection)
+{
+    mSelection = selection;
+    mAttributes |= Selection;
+}
+
+void WidgetState::setSurroundingTextOffset(int offset)
+{
+    mSurroundingTextOffset = offset;
+    mAttributes |= SurroundingTextOffset;
+}
+
+void WidgetState::setSurroundingTextLength(int length)
+{
+    mSurroundingTextLength = length;
+    mAttributes |= SurroundingTextLength;
+}
+
+} // namespace Maliit
@@ -0,0 +1,249 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef MALIIT_WIDGETSTATE_H
+#define MALIIT_WIDGETSTATE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QRect>
+
+#include <maliit/textmirror.h>
+
+//! \internal
+namespace Maliit {
+
+//! Attribute names used in the widget state map sent by the input context.
+namespace WidgetStateAttribute {
+    const char * const FocusState = "focusState";
+    const char * const ContentType = "contentType";
+    const char * const Correction = "correctionEnabled";
+    const char * const Prediction = "predictionEnabled";
+    const char * const AutoCapitalization = "autocapitalizationEnabled";
+    const char * const SurroundingText = "surroundingText";
+    const char * const AnchorPosition = "anchorPosition";
+    const char * const CursorPosition = "cursorPosition";
+    const char * const HasSelection = "hasSelection";
+    const char * const InputMethodMode = "inputMethodMode";
+    const char * const WinId = "winId";
+    const char * const CursorRectangle = "cursorRectangle";
+    const char * const HiddenText = "hiddenText";
+    const char * const PreeditClickPos = "preeditClickPos";
+    const char * const ToolbarId = "toolbarId";
+    const char * const Toolbar = "toolbar";
+    const char * const VisualizationPriority = "visualizationPriority";
+    const char * const PreeditRectangle = "preeditRectangle";
+    const char * const Selection = "selection";
+    const char * const SurroundingTextOffset = "surroundingTextOffset";
+    const char * const SurroundingTextLength = "surroundingTextLength";
+}
+
+/*! Keys of a surrounding text edit in a widget state delta.
+ *
+ * Instead of the whole surroundingText, a delta may carry the edit which turns
+ * the previous text into the new one: SurroundingTextEditRemoved characters
+ * at SurroundingTextEditPosition are replaced by SurroundingTextEditText.
+ * The keys are not part of the widget state itself.
+ */
+namespace WidgetStateEdit {
+    const char * const SurroundingTextEditPosition = "surroundingTextEditPosition";
+    const char * const SurroundingTextEditRemoved = "surroundingTextEditRemoved";
+    const char * const SurroundingTextEditText = "surroundingTextEditText";
+}
+
+/*! \internal
+ * \brief State of the focused widget, as sent by the input context.
+ *
+ * Well-known attributes are stored in typed fields, with a bitmask telling
+ * which of them were set. Attributes unknown to the server (e.g. those
+ * added by newer input contexts) are kept as is in extensions().
+ * The typed accessors return a default value for attributes which are not set.
+ */
+class WidgetState
+{
+public:
+    enum Attribute {
+        FocusState            = 1 << 0,
+        ContentType           = 1 << 1,
+        Correction            = 1 << 2,
+        Prediction            = 1 << 3,
+        AutoCapitalization    = 1 << 4,
+        SurroundingText       = 1 << 5,
+        AnchorPosition        = 1 << 6,
+        CursorPosition        = 1 << 7,
+        HasSelection          = 1 << 8,
+        InputMethodMode       = 1 << 9,
+        WinId                 = 1 << 10,
+        CursorRectangle       = 1 << 11,
+        HiddenText            = 1 << 12,
+        PreeditClickPos       = 1 << 13,
+        ToolbarId             = 1 << 14,
+        Toolbar               = 1 << 15,
+        VisualizationPriority = 1 << 16,
+        InputMethodHints      = 1 << 17,
+        PreeditRectangle      = 1 << 18,
+        Selection             = 1 << 19,
+        SurroundingTextOffset = 1 << 20,
+        SurroundingTextLength = 1 << 21
+    };
+    Q_DECLARE_FLAGS(Attributes, Attribute)
+
+    WidgetState();
+
+    //! Converts the map used on the wire into a widget state.
+    static WidgetState fromVariantMap(const QVariantMap &map);
+    //! Converts the widget state into the map used on the wire.
+    QVariantMap toVariantMap() const;
+
+    //! Returns the attribute for \a key, or 0 if \a key is an extension key.
+    static Attribute attributeForKey(const QString &key);
+    //! Returns the name of \a attribute in the map used on the wire.
+    static QString keyForAttribute(Attribute attribute);
+
+    //! Returns the set of typed attributes which are set.
+    Attributes attributes() const;
+    bool contains(Attribute attribute) const;
+    bool contains(const QString &key) const;
+    bool isEmpty() const;
+    void clear();
+
+    //! Generic, string-keyed access for typed and extension attributes.
+    QVariant value(const QString &key) const;
+    //! Sets \a key to \a value; an invalid \a value removes the attribute.
+    void insert(const QString &key, const QVariant &value);
+    void remove(const QString &key);
+
+    QVariant value(Attribute attribute) const;
+    void setValue(Attribute attribute, const QVariant &value);
+    void remove(Attribute attribute);
+
+    //! Returns the keys which are set in this state and differ from \a other.
+    QStringList changedKeys(const WidgetState &other) const;
+    //! Returns the typed attributes which are set in this state and differ from \a other.
+    Attributes changedAttributes(const WidgetState &other) const;
+
+    bool operator==(const WidgetState &other) const;
+    bool operator!=(const WidgetState &other) const;
+
+    bool focusState() const { return mFocusState; }
+    void setFocusState(bool focusState);
+
+    int contentType() const { return mContentType; }
+    void setContentType(int contentType);
+
+    bool correctionEnabled() const { return mCorrectionEnabled; }
+    void setCorrectionEnabled(bool enabled);
+
+    bool predictionEnabled() const { return mPredictionEnabled; }
+    void setPredictionEnabled(bool enabled);
+
+    bool autoCapitalizationEnabled() const { return mAutoCapitalizationEnabled; }
+    void setAutoCapitalizationEnabled(bool enabled);
+
+    QString surroundingText() const { return mSurroundingText.text(); }
+    void setSurroundingText(const QString &text);
+    //! The surrounding text without building a QString of it.
+    const TextMirror &surroundingTextMirror() const { return mSurroundingText; }
+    //! Replaces \a removeLength characters at \a position by \a text, returns false if
+    //! there is no surrounding text or the range is out of it.
+    bool editSurroundingText(int position, int removeLength, const QString &text);
+
+    int anchorPosition() const { return mAnchorPosition; }
+    void setAnchorPosition(int position);
+
+    int cursorPosition() const { return mCursorPosition; }
+    void setCursorPosition(int position);
+
+    bool hasSelection() const { return mHasSelection; }
+    void setHasSelection(bool hasSelection);
+
+    int inputMethodMode() const { return mInputMethodMode; }
+    void setInputMethodMode(int mode);
+
+    qulonglong winId() const { return mWinId; }
+    void setWinId(qulonglong winId);
+
+    const QRect &cursorRectangle() const { return mCursorRectangle; }
+    void setCursorRectangle(const QRect &rect);
+
+    bool hiddenText() const { return mHiddenText; }
+    void setHiddenText(bool hidden);
+
+    int preeditClickPos() const { return mPreeditClickPos; }
+    void setPreeditClickPos(int position);
+
+    int toolbarId() const { return mToolbarId; }
+    void setToolbarId(int id);
+
+    const QString &toolbar() const { return mToolbar; }
+    void setToolbar(const QString &toolbar);
+
+    bool visualizationPriority() const { return mVisualizationPriority; }
+    void setVisualizationPriority(bool priority);
+
+    qint64 inputMethodHints() const { return mInputMethodHints; }
+    void setInputMethodHints(qint64 hints);
+
+    const QRect &preeditRectangle() const { return mPreeditRectangle; }
+    void setPreeditRectangle(const QRect &rect);
+
+    const QString &selection() const { return mSelection; }
+    void setSelection(const QString &selection);
+
+    //! Position of surroundingText() in the whole text, when the application sends only a window of it
+    int surroundingTextOffset() const { return mSurroundingTextOffset; }
+    void setSurroundingTextOffset(int offset);
+
+    //! Length of the whole text, when the application sends only a window of it
+    int surroundingTextLength() const { return mSurroundingTextLength; }
+    void setSurroundingTextLength(int length);
+
+    //! Attributes which have no typed field.
+    const QVariantMap &extensions() const { return mExtensions; }
+
+private:
+    Attributes mAttributes;
+
+    bool mFocusState;
+    int mContentType;
+    bool mCorrectionEnabled;
+    bool mPredictionEnabled;
+    bool mAutoCapitalizationEnabled;
+    TextMirror mSurroundingText;
+    int mAnchorPosition;
+    int mCursorPosition;
+    bool mHasSelection;
+    int mInputMethodMode;
+    qulonglong mWinId;
+    QRect mCursorRectangle;
+    bool mHiddenText;
+    int mPreeditClickPos;
+    int mToolbarId;
+    QString mToolbar;
+    bool mVisualizationPriority;
+    qint64 mInputMethodHints;
+    QRect mPreeditRectangle;
+    QString mSelection;
+    int mSurroundingTextOffset;
+    int mSurroundingTextLength;
+
+    QVariantMap mExtensions;
+};
+
+} // namespace Maliit
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Maliit::WidgetState::Attributes)
+Q_DECLARE_METATYPE(Maliit::WidgetState)
+
+#endif // MALIIT_WIDGETSTATE_H
@@ -21,6 +21,29 @@ PUBLIC_SOURCES += \
     connectionfactory.cpp \
     minputcontextconnection.cpp \
 
+# Unix socket and in-process connections, and what they share with the qdbus based one
+PRIVATE_HEADERS += \
+    mimserverconnection.h \
+    inputcontextmessages.h \
+    unixsocketframe.h \
+    unixsocketchannel.h \
+    unixsocketinputcontextconnection.h \
+    unixsocketserverconnection.h \
+    loopbackinputcontextconnection.h \
+    loopbackserverconnection.h \
+    utf8offsetindex.h \
+
+PRIVATE_SOURCES += \
+    mimserverconnection.cpp \
+    inputcontextmessages.cpp \
+    unixsocketframe.cpp \
+    unixsocketchannel.cpp \
+    unixsocketinputcontextconnection.cpp \
+    unixsocketserverconnection.cpp \
+    loopbackinputcontextconnection.cpp \
+    loopbackserverconnection.cpp \
+    utf8offsetindex.cpp \
+
 # Default to building qdbus based connection
 CONFIG += qdbus-dbus-connection
 
@@ -36,15 +59,23 @@ include($$TOP_DIR/dbus_interfaces/dbus_interfaces.pri)
 
 qdbus-dbus-connection {
     server_adaptor.files = $$DBUS_SERVER_XML
-    server_adaptor.header_flags = -i dbusinputcontextconnection.h -l DBusInputContextConnection
-    server_adaptor.source_flags = -l DBusInputContextConnection
+    server_adaptor.header_flags = -i dbusinputcontextpeer.h -l DBusInputContextPeer
+    server_adaptor.source_flags = -l DBusInputContextPeer
 
     context_adaptor.files = $$DBUS_CONTEXT_XML
     context_adaptor.header_flags = -i dbusserverconnection.h -l DBusServerConnection
     context_adaptor.source_flags = -l DBusServerConnection
 
-    DBUS_ADAPTORS = server_adaptor context_adaptor
-    DBUS_INTERFACES = $$DBUS_SERVER_XML $$DBUS_CONTEXT_XML
+    server2_adaptor.files = $$DBUS_SERVER2_XML
+    server2_adaptor.header_flags = -i dbusinputcontextpeer.h -l DBusInputContextPeer
+    server2_adaptor.source_flags = -l DBusInputContextPeer
+
+    context2_adaptor.files = $$DBUS_CONTEXT2_XML
+    context2_adaptor.header_flags = -i dbusserverconnection.h -l DBusServerConnection
+    context2_adaptor.source_flags = -l DBusServerConnection
+
+    DBUS_ADAPTORS = server_adaptor context_adaptor server2_adaptor context2_adaptor
+    DBUS_INTERFACES = $$DBUS_SERVER_XML $$DBUS_CONTEXT_XML $$DBUS_SERVER2_XML $$DBUS_CONTEXT2_XML
     QDBUSXML2CPP_INTERFACE_HEADER_FLAGS = -i maliit/namespace.h -i maliit/settingdata.h
 
     QT += dbus
@@ -56,18 +87,23 @@ qdbus-dbus-connection {
     PRIVATE_HEADERS += \
         dbuscustomarguments.h \
         dbusinputcontextconnection.h \
+        dbusinputcontextpeer.h \
+        dbusinputcontextlistener.h \
+        lockfreequeue.h \
         serverdbusaddress.h \
-        mimserverconnection.h \
         dbusserverconnection.h \
         inputcontextdbusaddress.h \
+        sharedmemorylane.h \
 
     PRIVATE_SOURCES += \
         dbuscustomarguments.cpp \
         dbusinputcontextconnection.cpp \
+        dbusinputcontextpeer.cpp \
+        dbusinputcontextlistener.cpp \
         serverdbusaddress.cpp \
-        mimserverconnection.cpp \
         dbusserverconnection.cpp \
         inputcontextdbusaddress.cpp \
+        sharedmemorylane.cpp \
 
     # DBus activation
     enable-dbus-activation {
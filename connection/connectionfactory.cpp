@@ -15,6 +15,9 @@
 #include "connectionfactory.h"
 
 #include "dbusinputcontextconnection.h"
+#include "unixsocketinputcontextconnection.h"
+#include "loopbackinputcontextconnection.h"
+#include "loopbackserverconnection.h"
 
 #ifdef HAVE_WAYLAND
 #include "waylandinputmethodconnection.h"
@@ -38,6 +41,29 @@ MInputContextConnection *createInputContextConnectionWithFixedAddress(const QStr
 
 } // namespace DBus
 
+namespace UnixSocket {
+
+MInputContextConnection *createInputContextConnection(const QString &socketPath)
+{
+    return new UnixSocketInputContextConnection(socketPath);
+}
+
+} // namespace UnixSocket
+
+namespace Loopback {
+
+LoopbackInputContextConnection *createInputContextConnection()
+{
+    return new LoopbackInputContextConnection;
+}
+
+MImServerConnection *createServerConnection(LoopbackInputContextConnection *connection)
+{
+    return new LoopbackServerConnection(connection);
+}
+
+} // namespace Loopback
+
 #ifdef HAVE_WAYLAND
 MInputContextConnection *createWestonIMProtocolConnection()
 {
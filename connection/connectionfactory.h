@@ -17,6 +17,9 @@
 
 #include "minputcontextconnection.h"
 
+class LoopbackInputContextConnection;
+class MImServerConnection;
+
 namespace Maliit {
 namespace DBus {
 
@@ -25,6 +28,22 @@ MInputContextConnection *createInputContextConnectionWithFixedAddress(const QStr
 
 } // namespace DBus
 
+namespace UnixSocket {
+
+//! Listens on the SOCK_SEQPACKET Unix socket at \a socketPath
+MInputContextConnection *createInputContextConnection(const QString &socketPath);
+
+} // namespace UnixSocket
+
+namespace Loopback {
+
+//! Connection for an input method server running in the application process
+LoopbackInputContextConnection *createInputContextConnection();
+//! Application side of \a connection
+MImServerConnection *createServerConnection(LoopbackInputContextConnection *connection);
+
+} // namespace Loopback
+
 #ifdef HAVE_WAYLAND
 MInputContextConnection *createWestonIMProtocolConnection();
 #endif
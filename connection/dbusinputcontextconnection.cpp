@@ -14,13 +14,18 @@
 
 #include "dbusinputcontextconnection.h"
 
-#include "minputmethodserver1interface_adaptor.h"
+#include "dbusinputcontextpeer.h"
+#include "dbusinputcontextlistener.h"
 #include "minputmethodcontext1interface_interface.h"
+#include "minputmethodcontext2interface_interface.h"
 #include "dbuscustomarguments.h"
+#include "inputcontextmessages.h"
+#include "sharedmemorylane.h"
 
 #include <QDBusConnection>
 #include <QDBusMessage>
-#include <QDBusServer>
+#include <QDBusPendingCallWatcher>
+#include <QDBusUnixFileDescriptor>
 
 #include <QKeyEvent>
 
@@ -33,21 +38,54 @@ const char * const DBusInterface = "com.meego.inputmethod.uiserver1";
 const char * const DBusClientPath = "/com/meego/inputmethod/inputcontext";
 const char * const DBusClientInterface = "com.meego.inputmethod.inputcontext1";
 
-const char * const DBusLocalPath("/org/freedesktop/DBus/Local");
-const char * const DBusLocalInterface("org.freedesktop.DBus.Local");
-const char * const DisconnectedSignal("Disconnected");
+const quint32 FastLaneCapacity = 64 * 1024; // in bytes, has to be a power of two
+
+// Highest protocol version supported, see negotiateVersion()
+const uint ProtocolVersion = 2;
+
+// Bulk calls handled per event loop iteration, see drainBulkQueue()
+const int BulkCallsPerIteration = 4;
+// Bulk calls queued longer than this are handled regardless of the above
+const qint64 BulkCallMaximumDelay = 100; // in ms
+
+// Idle clients are looked for this often at most, see setHibernationTimeout()
+const int MinimumHibernationCheckInterval = 1000; // in ms
 
 }
 
 DBusInputContextConnection::DBusInputContextConnection(const QSharedPointer<Maliit::Server::DBus::Address> &address)
     : MInputContextConnection(0)
     , mAddress(address)
-    , mServer(mAddress->connect())
-    , mConnectionNumbers()
+    , mDBusThread()
+    , mListener(new DBusInputContextListener(this, mAddress))
+    , mInboundCalls()
+    , mInboundDrainScheduled(0)
+    , mPeers()
     , mProxys()
+    , mSequencedProxys()
+    , mOutgoingSequences()
+    , mPreeditBases()
+    , mFastLanes()
+    , mOfferedFastLanes()
+    , mFastLaneOffers()
+    , mControlSerials()
+    , mBatchingClients()
+    , mBatchProbes()
+    , mBatchClient(0)
+    , mBatch()
+    , mBatchFlushScheduled(false)
+    , mBulkQueue()
+    , mBulkDrainScheduled(false)
+    , mInboundQueueCounters()
+    , mHibernatedClients()
+    , mLastActivity()
+    , mHibernationTimeout(0)
+    , mHibernationTimer()
+    , mClock()
     , lastLanguage()
 {
-    connect(mServer.data(), SIGNAL(newConnection(QDBusConnection)), this, SLOT(newConnection(QDBusConnection)));
+    mClock.start();
+    connect(&mHibernationTimer, SIGNAL(timeout()), this, SLOT(hibernateIdleClients()));
 
     qDBusRegisterMetaType<MImPluginSettingsEntry>();
     qDBusRegisterMetaType<MImPluginSettingsInfo>();
@@ -55,44 +93,360 @@ DBusInputContextConnection::DBusInputContextConnection(const QSharedPointer<Mali
     qDBusRegisterMetaType<Maliit::PreeditTextFormat>();
     qDBusRegisterMetaType<QList<Maliit::PreeditTextFormat> >();
 
-    new Uiserver1Adaptor(this);
+    mListener->moveToThread(&mDBusThread);
+    connect(&mDBusThread, SIGNAL(finished()), mListener, SLOT(deleteLater()));
+    mDBusThread.start();
+    // Applications may connect as soon as the constructor returned
+    QMetaObject::invokeMethod(mListener, "listen", Qt::BlockingQueuedConnection);
 }
 
 DBusInputContextConnection::~DBusInputContextConnection()
 {
+    // Deletes the listener and the peers, nothing is posted anymore afterwards
+    mDBusThread.quit();
+    mDBusThread.wait();
+
+    qDeleteAll(mFastLanes);
+    qDeleteAll(mOfferedFastLanes);
 }
 
 void
-DBusInputContextConnection::newConnection(const QDBusConnection &connection)
+DBusInputContextConnection::postInboundCall(const InboundCall &call)
 {
-    ComMeegoInputmethodInputcontext1Interface *proxy = new ComMeegoInputmethodInputcontext1Interface(QString(), QString::fromLatin1(DBusClientPath), connection, this);
+    InboundCall stampedCall(call);
+    stampedCall.receivedAt = mClock.elapsed();
+    mInboundCalls.enqueue(stampedCall);
+
+    // One drain handles everything queued before it starts, see drainInboundQueue()
+    if (mInboundDrainScheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "drainInboundQueue", Qt::QueuedConnection);
+    }
+}
 
-    static unsigned int connectionCounter = 1; // Start at 1 so 0 can be used as a sentinel value
-    unsigned int connectionNumber = connectionCounter++;
+void
+DBusInputContextConnection::drainInboundQueue()
+{
+    // Reset before looking at the queue, so no call posted meanwhile is left behind
+    mInboundDrainScheduled.fetchAndStoreOrdered(0);
 
-    mConnectionNumbers.insert(connection.name(), connectionNumber);
-    mProxys.insert(connectionNumber, proxy);
-    mConnections.insert(connectionNumber, connection.name());
+    InboundCall call;
+    while (mInboundCalls.dequeue(&call)) {
+        ++mInboundQueueCounters.handedOver;
+        mInboundQueueCounters.handOverMaximumDelay = qMax(mInboundQueueCounters.handOverMaximumDelay,
+                                                          mClock.elapsed() - call.receivedAt);
+        handleInboundCall(call);
+    }
+}
+
+void
+DBusInputContextConnection::handleInboundCall(const InboundCall &call)
+{
+    const unsigned int clientId = call.clientId;
+    const QVariantList &arguments = call.arguments;
+
+    if (call.type == InboundCall::Connected) {
+        newConnection(call.peer);
+        return;
+    }
+
+    DBusInputContextPeer *peer = mPeers.value(clientId);
+    if (!peer) {
+        // disconnected meanwhile
+        return;
+    }
+
+    switch (call.type) {
+    case InboundCall::Connected:
+        break;
+    case InboundCall::Disconnected:
+        handlePeerDisconnection(clientId);
+        break;
+    case InboundCall::ActivateContext:
+        // Activation sends to the application right away, which needs its proxies
+        resumeClient(clientId);
+        flushBulkCalls(clientId);
+        activateContext(clientId);
+        break;
+    case InboundCall::ShowInputMethod:
+        showInputMethod(clientId);
+        break;
+    case InboundCall::HideInputMethod:
+        hideInputMethod(clientId);
+        break;
+    case InboundCall::MouseClickedOnPreedit:
+        mouseClickedOnPreedit(clientId, arguments.at(0).toPoint(), arguments.at(1).toRect());
+        break;
+    case InboundCall::SetPreedit:
+        setPreedit(clientId, arguments.at(0).toString(), arguments.at(1).toInt());
+        break;
+    case InboundCall::UpdateWidgetInformation:
+        flushBulkCalls(clientId);
+        updateWidgetInformation(clientId, arguments.at(0).toMap(), arguments.at(1).toBool());
+        break;
+    case InboundCall::UpdateWidgetInformationDelta:
+        flushBulkCalls(clientId);
+        if (!updateWidgetInformationDelta(clientId, arguments.at(0).toMap(), arguments.at(1).toStringList(),
+                                          arguments.at(2).toUInt(), arguments.at(3).toBool())) {
+            resyncWidgetInformation(clientId);
+        }
+        break;
+    case InboundCall::Reset:
+        if (arguments.isEmpty()) {
+            reset(clientId);
+            // Version 1 applications wait for the reply before accepting commits again
+            peer->busConnection().send(call.message.createReply());
+        } else {
+            reset(clientId, arguments.at(0).toUInt());
+        }
+        break;
+    case InboundCall::AppOrientationAboutToChange:
+        receivedAppOrientationAboutToChange(clientId, arguments.at(0).toInt());
+        break;
+    case InboundCall::AppOrientationChanged:
+        receivedAppOrientationChanged(clientId, arguments.at(0).toInt());
+        break;
+    case InboundCall::SetCopyPasteState:
+        setCopyPasteState(clientId, arguments.at(0).toBool(), arguments.at(1).toBool());
+        break;
+    case InboundCall::ProcessKeyEvent:
+        processKeyEvent(clientId, static_cast<QEvent::Type>(arguments.at(0).toInt()),
+                        static_cast<Qt::Key>(arguments.at(1).toInt()),
+                        static_cast<Qt::KeyboardModifier>(arguments.at(2).toInt()),
+                        arguments.at(3).toString(), arguments.at(4).toBool(), arguments.at(5).toInt(),
+                        arguments.at(6).toUInt(), arguments.at(7).toUInt(), arguments.at(8).toUInt());
+        break;
+    case InboundCall::ProcessPackedKeyEvent:
+        if (!Maliit::InputContextMessage::dispatch(arguments.at(0).toByteArray(), this, clientId)) {
+            qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed key event from client" << clientId;
+        }
+        break;
+    case InboundCall::RegisterAttributeExtension: {
+        const BulkCall bulkCall = { BulkCall::RegisterAttributeExtension, clientId, arguments.at(0).toInt(),
+                                    arguments.at(1).toString(), QString(), QString(), QVariant(),
+                                    call.receivedAt };
+        queueBulkCall(bulkCall);
+        break;
+    }
+    case InboundCall::UnregisterAttributeExtension: {
+        const BulkCall bulkCall = { BulkCall::UnregisterAttributeExtension, clientId, arguments.at(0).toInt(),
+                                    QString(), QString(), QString(), QVariant(),
+                                    call.receivedAt };
+        queueBulkCall(bulkCall);
+        break;
+    }
+    case InboundCall::SetExtendedAttribute: {
+        const BulkCall bulkCall = { BulkCall::SetExtendedAttribute, clientId, arguments.at(0).toInt(),
+                                    arguments.at(1).toString(), arguments.at(2).toString(),
+                                    arguments.at(3).toString(), arguments.at(4),
+                                    call.receivedAt };
+        queueBulkCall(bulkCall);
+        break;
+    }
+    case InboundCall::LoadPluginSettings: {
+        const BulkCall bulkCall = { BulkCall::LoadPluginSettings, clientId, 0,
+                                    arguments.at(0).toString(), QString(), QString(), QVariant(),
+                                    call.receivedAt };
+        queueBulkCall(bulkCall);
+        break;
+    }
+    case InboundCall::NegotiateVersion:
+        peer->busConnection().send(call.message.createReply(negotiateVersion(clientId, arguments.at(0).toUInt())));
+        break;
+    case InboundCall::ResyncWidgetInformation:
+        resyncWidgetInformation(clientId);
+        break;
+    case InboundCall::ResyncPreedit:
+        // The next preedit is sent in full, see sendPreeditString()
+        mPreeditBases.remove(clientId);
+        break;
+    }
+}
 
-    QDBusConnection c(connection);
+void
+DBusInputContextConnection::newConnection(DBusInputContextPeer *peer)
+{
+    const unsigned int connectionNumber = peer->clientId();
+    const QDBusConnection connection = peer->busConnection();
 
-    c.connect(QString(), QString::fromLatin1(DBusLocalPath), QString::fromLatin1(DBusLocalInterface),
-              QString::fromLatin1(DisconnectedSignal),
-              this, SLOT(onDisconnection()));
+    ComMeegoInputmethodInputcontext1Interface *proxy = new ComMeegoInputmethodInputcontext1Interface(QString(), QString::fromLatin1(DBusClientPath), connection, this);
 
-    c.registerObject(QString::fromLatin1(DBusPath), this);
+    mPeers.insert(connectionNumber, peer);
+    mProxys.insert(connectionNumber, proxy);
+    mLastActivity.insert(connectionNumber, mClock.elapsed());
 
+    countControlMessage(connectionNumber);
     proxy->setLanguage(lastLanguage);
+
+    offerFastLane(connectionNumber, connection);
+    probeBatchSupport(connectionNumber);
+}
+
+void
+DBusInputContextConnection::offerFastLane(unsigned int clientId, const QDBusConnection &connection)
+{
+    if (!(connection.connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing))
+        return;
+
+    SharedMemoryLane *lane = SharedMemoryLane::create(FastLaneCapacity);
+    if (!lane)
+        return;
+
+    ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
+
+    // The lane is only used once the application accepted it. Older
+    // applications answer with an error and keep getting everything over D-Bus.
+    countControlMessage(clientId);
+    QDBusPendingCall call = proxy->setFastLane(QDBusUnixFileDescriptor(lane->memoryFd()),
+                                               QDBusUnixFileDescriptor(lane->eventFd()),
+                                               lane->capacity());
+
+    mOfferedFastLanes.insert(clientId, lane);
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    mFastLaneOffers.insert(watcher, clientId);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(fastLaneOfferFinished(QDBusPendingCallWatcher*)));
+}
+
+void
+DBusInputContextConnection::fastLaneOfferFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    const unsigned int clientId = mFastLaneOffers.take(watcher);
+    SharedMemoryLane *lane = mOfferedFastLanes.take(clientId);
+    if (!lane) {
+        // client disconnected meanwhile
+        return;
+    }
+
+    QDBusPendingReply<bool> reply = *watcher;
+    if (reply.isError() || !reply.value()) {
+        delete lane;
+        return;
+    }
+
+    mFastLanes.insert(clientId, lane);
 }
 
 void
-DBusInputContextConnection::onDisconnection()
+DBusInputContextConnection::probeBatchSupport(unsigned int clientId)
 {
-    const QString &name = connection().name();
-    unsigned int connectionNumber = mConnectionNumbers.take(name);
+    ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
+
+    // Older applications answer with an error and keep getting one message per event.
+    // The empty batch is not counted as control message on either side, older
+    // applications could not count it.
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(proxy->applyBatch(QByteArray()), this);
+    mBatchProbes.insert(watcher, clientId);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(batchProbeFinished(QDBusPendingCallWatcher*)));
+}
+
+void
+DBusInputContextConnection::batchProbeFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    const unsigned int clientId = mBatchProbes.take(watcher);
+    if (!watcher->isError() && mProxys.contains(clientId)) {
+        mBatchingClients.insert(clientId);
+    }
+}
+
+void
+DBusInputContextConnection::queueMessage(unsigned int clientId, const QByteArray &message)
+{
+    if (mBatchClient != clientId) {
+        flushBatch();
+        mBatchClient = clientId;
+    }
+
+    mBatch.append(message);
+
+    if (!mBatchFlushScheduled) {
+        mBatchFlushScheduled = true;
+        QMetaObject::invokeMethod(this, "flushBatch", Qt::QueuedConnection);
+    }
+}
+
+void
+DBusInputContextConnection::flushBatch()
+{
+    mBatchFlushScheduled = false;
+
+    if (mBatch.isEmpty())
+        return;
+
+    // Taken before sending, so the countControlMessage() call below does not flush again
+    const unsigned int clientId = mBatchClient;
+    QList<QByteArray> messages;
+    messages.swap(mBatch);
+    mBatchClient = 0;
+
+    const QByteArray batch = (messages.size() == 1)
+                             ? messages.first()
+                             : Maliit::InputContextMessage::encodeBatch(messages);
+
+    if (sendOnFastLane(clientId, batch))
+        return;
+
+    ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
+    if (proxy) {
+        countControlMessage(clientId);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(clientId)) {
+            sequencedProxy->applyBatch(nextSequence(clientId), batch);
+        } else {
+            proxy->applyBatch(batch);
+        }
+    }
+}
+
+void
+DBusInputContextConnection::countControlMessage(unsigned int clientId)
+{
+    // Queued events have to reach the application before this message
+    flushBatch();
+    ++mControlSerials[clientId];
+}
+
+bool
+DBusInputContextConnection::sendOnFastLane(unsigned int clientId, const QByteArray &message)
+{
+    SharedMemoryLane *lane = mFastLanes.value(clientId);
+    return lane && lane->write(message, mControlSerials.value(clientId));
+}
+
+void
+DBusInputContextConnection::handlePeerDisconnection(unsigned int connectionNumber)
+{
+    // The peer lives in the D-Bus thread and is deleted there
+    if (DBusInputContextPeer *peer = mPeers.take(connectionNumber)) {
+        peer->deleteLater();
+    }
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.take(connectionNumber);
-    mConnections.remove(connectionNumber);
     delete proxy;
+    delete mSequencedProxys.take(connectionNumber);
+    mOutgoingSequences.remove(connectionNumber);
+    mPreeditBases.remove(connectionNumber);
+    mHibernatedClients.remove(connectionNumber);
+    mLastActivity.remove(connectionNumber);
+    delete mFastLanes.take(connectionNumber);
+    delete mOfferedFastLanes.take(connectionNumber);
+    mControlSerials.remove(connectionNumber);
+    mBatchingClients.remove(connectionNumber);
+    if (mBatchClient == connectionNumber) {
+        mBatch.clear();
+        mBatchClient = 0;
+    }
+    for (QQueue<BulkCall>::iterator it = mBulkQueue.begin(); it != mBulkQueue.end();) {
+        if (it->clientId == connectionNumber) {
+            it = mBulkQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    mInboundQueueCounters.bulkDepth = mBulkQueue.size();
     handleDisconnection(connectionNumber);
 }
 
@@ -105,9 +459,42 @@ DBusInputContextConnection::sendPreeditString(const QString &string,
     if (activeConnection) {
         MInputContextConnection::sendPreeditString(string, preeditFormats, replacementStart, replacementLength, cursorPos);
 
+        const quint32 epoch = resetEpoch(activeConnection);
+        // Only version 2 applications keep track of the preedit deltas apply to,
+        // also when getting the whole preedit over D-Bus
+        Maliit::InputContextMessage::PreeditBase *base = mSequencedProxys.contains(activeConnection)
+                ? &mPreeditBases[activeConnection] : 0;
+
+        if (mBatchingClients.contains(activeConnection) || mFastLanes.contains(activeConnection)) {
+            const QByteArray message = base
+                    ? Maliit::InputContextMessage::encodeUpdatePreedit(base, string, preeditFormats,
+                                                                       replacementStart, replacementLength,
+                                                                       cursorPos, epoch)
+                    : Maliit::InputContextMessage::encodeUpdatePreedit(string, preeditFormats,
+                                                                       replacementStart, replacementLength,
+                                                                       cursorPos, epoch);
+
+            if (mBatchingClients.contains(activeConnection)) {
+                queueMessage(activeConnection, message);
+                return;
+            }
+            if (sendOnFastLane(activeConnection, message)) {
+                return;
+            }
+        }
+
         ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
         if (proxy) {
-            proxy->updatePreedit(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+            countControlMessage(activeConnection);
+            if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+                if (base) {
+                    base->string = string;
+                    base->formats = preeditFormats;
+                }
+                sequencedProxy->updatePreedit(nextSequence(activeConnection), epoch, string, preeditFormats, replacementStart, replacementLength, cursorPos);
+            } else {
+                proxy->updatePreedit(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+            }
         }
     }
 }
@@ -119,9 +506,30 @@ DBusInputContextConnection::sendCommitString(const QString &string, int replaceS
     if (activeConnection) {
         MInputContextConnection::sendCommitString(string, replaceStart, replaceLength, cursorPos);
 
+        const quint32 epoch = resetEpoch(activeConnection);
+
+        if (mBatchingClients.contains(activeConnection)) {
+            queueMessage(activeConnection,
+                         Maliit::InputContextMessage::encodeCommitString(string, replaceStart,
+                                                                         replaceLength, cursorPos, epoch));
+            return;
+        }
+
+        if (mFastLanes.contains(activeConnection)
+            && sendOnFastLane(activeConnection,
+                              Maliit::InputContextMessage::encodeCommitString(string, replaceStart,
+                                                                              replaceLength, cursorPos, epoch))) {
+            return;
+        }
+
         ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
         if (proxy) {
-            proxy->commitString(string, replaceStart, replaceLength, cursorPos);
+            countControlMessage(activeConnection);
+            if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+                sequencedProxy->commitString(nextSequence(activeConnection), epoch, string, replaceStart, replaceLength, cursorPos);
+            } else {
+                proxy->commitString(string, replaceStart, replaceLength, cursorPos);
+            }
         }
     }
 }
@@ -133,10 +541,34 @@ DBusInputContextConnection::sendKeyEvent(const QKeyEvent &keyEvent,
     if (activeConnection) {
         MInputContextConnection::sendKeyEvent(keyEvent, requestType);
 
+        if (mBatchingClients.contains(activeConnection)) {
+            queueMessage(activeConnection,
+                         Maliit::InputContextMessage::encodeKeyEvent(keyEvent.type(), keyEvent.key(),
+                                                                     keyEvent.modifiers(), keyEvent.text(),
+                                                                     keyEvent.isAutoRepeat(), keyEvent.count(),
+                                                                     requestType));
+            return;
+        }
+
+        if (mFastLanes.contains(activeConnection)
+            && sendOnFastLane(activeConnection,
+                              Maliit::InputContextMessage::encodeKeyEvent(keyEvent.type(), keyEvent.key(),
+                                                                          keyEvent.modifiers(), keyEvent.text(),
+                                                                          keyEvent.isAutoRepeat(), keyEvent.count(),
+                                                                          requestType))) {
+            return;
+        }
+
         ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
         if (proxy) {
-            proxy->keyEvent(keyEvent.type(), keyEvent.key(), keyEvent.modifiers(),
-                            keyEvent.text(), keyEvent.isAutoRepeat(), keyEvent.count(), requestType);
+            countControlMessage(activeConnection);
+            if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+                sequencedProxy->keyEvent(nextSequence(activeConnection), keyEvent.type(), keyEvent.key(), keyEvent.modifiers(),
+                                         keyEvent.text(), keyEvent.isAutoRepeat(), keyEvent.count(), uchar(requestType));
+            } else {
+                proxy->keyEvent(keyEvent.type(), keyEvent.key(), keyEvent.modifiers(),
+                                keyEvent.text(), keyEvent.isAutoRepeat(), keyEvent.count(), requestType);
+            }
         }
     }
 }
@@ -146,7 +578,12 @@ DBusInputContextConnection::notifyImInitiatedHiding()
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
-        proxy->imInitiatedHide();
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->imInitiatedHide(nextSequence(activeConnection));
+        } else {
+            proxy->imInitiatedHide();
+        }
     }
 }
 
@@ -155,24 +592,50 @@ DBusInputContextConnection::setGlobalCorrectionEnabled(bool enabled)
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if ((enabled != globalCorrectionEnabled()) && proxy) {
-        proxy->setGlobalCorrectionEnabled(enabled);
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->setGlobalCorrectionEnabled(nextSequence(activeConnection), enabled);
+        } else {
+            proxy->setGlobalCorrectionEnabled(enabled);
+        }
         MInputContextConnection::setGlobalCorrectionEnabled(enabled);
     }
 }
 
-QRect
-DBusInputContextConnection::preeditRectangle(bool &valid)
+int
+DBusInputContextConnection::requestPreeditRectangle()
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
-    if (proxy) {
-        int x, y, width, height;
-        if (proxy->preeditRectangle(x, y, width, height)) {
-            valid = true;
-            return QRect(x, y, width, height);
-        }
+    if (!proxy) {
+        return MInputContextConnection::requestPreeditRectangle();
     }
-    valid = false;
-    return QRect();
+
+    const int requestId = nextRequestId();
+    countControlMessage(activeConnection);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(proxy->preeditRectangle(), this);
+    mPreeditRectangleRequests.insert(watcher, requestId);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(preeditRectangleRequestFinished(QDBusPendingCallWatcher*)));
+
+    return requestId;
+}
+
+void
+DBusInputContextConnection::preeditRectangleRequestFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    const int requestId = mPreeditRectangleRequests.take(watcher);
+    QDBusPendingReply<bool, int, int, int, int> reply = *watcher;
+    if (reply.isError() || !reply.argumentAt<0>()) {
+        Q_EMIT preeditRectangleReceived(requestId, QRect(), false);
+        return;
+    }
+
+    Q_EMIT preeditRectangleReceived(requestId,
+                                    QRect(reply.argumentAt<1>(), reply.argumentAt<2>(),
+                                          reply.argumentAt<3>(), reply.argumentAt<4>()),
+                                    true);
 }
 
 void
@@ -180,7 +643,12 @@ DBusInputContextConnection::setRedirectKeys(bool enabled)
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if ((enabled != redirectKeysEnabled()) && proxy) {
-        proxy->setRedirectKeys(enabled);
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->setRedirectKeys(nextSequence(activeConnection), enabled);
+        } else {
+            proxy->setRedirectKeys(enabled);
+        }
         MInputContextConnection::setRedirectKeys(enabled);
     }
 }
@@ -190,7 +658,12 @@ DBusInputContextConnection::setDetectableAutoRepeat(bool enabled)
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if ((enabled != detectableAutoRepeat()) && proxy) {
-        proxy->setDetectableAutoRepeat(enabled);
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->setDetectableAutoRepeat(nextSequence(activeConnection), enabled);
+        } else {
+            proxy->setDetectableAutoRepeat(enabled);
+        }
         MInputContextConnection::setDetectableAutoRepeat(enabled);
     }
 }
@@ -200,11 +673,15 @@ DBusInputContextConnection::invokeAction(const QString &action,
                                          const QKeySequence &sequence)
 {
     if (activeConnection) {
+        flushBatch();
+
         QDBusMessage message = QDBusMessage::createSignal(DBusPath, DBusInterface, "invokeAction");
         QList<QVariant> arguments;
         arguments << action << sequence.toString();
         message.setArguments(arguments);
-        QDBusConnection(mConnections.value(activeConnection)).send(message);
+        if (DBusInputContextPeer *peer = mPeers.value(activeConnection)) {
+            peer->busConnection().send(message);
+        }
     }
 }
 
@@ -213,23 +690,92 @@ DBusInputContextConnection::setSelection(int start, int length)
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
-        proxy->setSelection(start, length);
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->setSelection(nextSequence(activeConnection), start, length);
+        } else {
+            proxy->setSelection(start, length);
+        }
     }
 }
 
-QString
-DBusInputContextConnection::selection(bool &valid)
+int
+DBusInputContextConnection::requestSelection()
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
-    if (proxy) {
-        QString selectionText;
-        if (proxy->selection(selectionText)) {
-            valid = true;
-            return selectionText;
-        }
+    if (!proxy) {
+        return MInputContextConnection::requestSelection();
+    }
+
+    const int requestId = nextRequestId();
+    countControlMessage(activeConnection);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(proxy->selection(), this);
+    mSelectionRequests.insert(watcher, requestId);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(selectionRequestFinished(QDBusPendingCallWatcher*)));
+
+    return requestId;
+}
+
+void
+DBusInputContextConnection::selectionRequestFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    const int requestId = mSelectionRequests.take(watcher);
+    QDBusPendingReply<bool, QString> reply = *watcher;
+    if (reply.isError() || !reply.argumentAt<0>()) {
+        Q_EMIT selectionReceived(requestId, QString(), false);
+        return;
     }
-    valid = false;
-    return QString();
+
+    Q_EMIT selectionReceived(requestId, reply.argumentAt<1>(), true);
+}
+
+void
+DBusInputContextConnection::setSurroundingTextWindow(int characters)
+{
+    MInputContextConnection::setSurroundingTextWindow(characters);
+
+    // applications before protocol version 2 always send their whole text
+    ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection);
+    if (sequencedProxy) {
+        countControlMessage(activeConnection);
+        sequencedProxy->setSurroundingTextWindow(nextSequence(activeConnection), surroundingTextWindow());
+    }
+}
+
+int
+DBusInputContextConnection::requestSurroundingText(int start, int length)
+{
+    ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection);
+    if (!sequencedProxy) {
+        return MInputContextConnection::requestSurroundingText(start, length);
+    }
+
+    const int requestId = nextRequestId();
+    countControlMessage(activeConnection);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(sequencedProxy->surroundingText(start, length), this);
+    mSurroundingTextRequests.insert(watcher, qMakePair(requestId, start));
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(surroundingTextRequestFinished(QDBusPendingCallWatcher*)));
+
+    return requestId;
+}
+
+void
+DBusInputContextConnection::surroundingTextRequestFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    const QPair<int, int> request = mSurroundingTextRequests.take(watcher);
+    QDBusPendingReply<bool, QString> reply = *watcher;
+    if (reply.isError() || !reply.argumentAt<0>()) {
+        Q_EMIT surroundingTextReceived(request.first, request.second, QString(), false);
+        return;
+    }
+
+    Q_EMIT surroundingTextReceived(request.first, request.second, reply.argumentAt<1>(), true);
 }
 
 void
@@ -238,16 +784,31 @@ DBusInputContextConnection::setLanguage(const QString &language)
     lastLanguage = language;
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
-        proxy->setLanguage(language);
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->setLanguage(nextSequence(activeConnection), language);
+        } else {
+            proxy->setLanguage(language);
+        }
     }
 }
 
 void
 DBusInputContextConnection::sendActivationLostEvent()
 {
+    // The idle time of a client starts when it is no longer active
+    if (activeConnection) {
+        mLastActivity.insert(activeConnection, mClock.elapsed());
+    }
+
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
-        proxy->activationLostEvent();
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->activationLostEvent(nextSequence(activeConnection));
+        } else {
+            proxy->activationLostEvent();
+        }
     }
 }
 
@@ -258,7 +819,12 @@ DBusInputContextConnection::updateInputMethodArea(const QRegion &region)
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
         QRect rect = region.boundingRect();
-        proxy->updateInputMethodArea(rect.x(), rect.y(), rect.width(), rect.height());
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->updateInputMethodArea(nextSequence(activeConnection), rect.x(), rect.y(), rect.width(), rect.height());
+        } else {
+            proxy->updateInputMethodArea(rect.x(), rect.y(), rect.width(), rect.height());
+        }
     }
 }
 
@@ -271,7 +837,12 @@ DBusInputContextConnection::notifyExtendedAttributeChanged(int id,
 {
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(activeConnection);
     if (proxy) {
-        proxy->notifyExtendedAttributeChanged(id, target, targetItem, attribute, QDBusVariant(value));
+        countControlMessage(activeConnection);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(activeConnection)) {
+            sequencedProxy->notifyExtendedAttributeChanged(nextSequence(activeConnection), id, target, targetItem, attribute, QDBusVariant(value));
+        } else {
+            proxy->notifyExtendedAttributeChanged(id, target, targetItem, attribute, QDBusVariant(value));
+        }
     }
 }
 
@@ -284,9 +855,15 @@ DBusInputContextConnection::notifyExtendedAttributeChanged(const QList<int> &cli
                                                            const QVariant &value)
 {
     Q_FOREACH (int clientId, clientIds) {
+        resumeClient(clientId);
         ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
         if (proxy) {
-            proxy->notifyExtendedAttributeChanged(id, target, targetItem, attribute, QDBusVariant(value));
+            countControlMessage(clientId);
+            if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(clientId)) {
+                sequencedProxy->notifyExtendedAttributeChanged(nextSequence(clientId), id, target, targetItem, attribute, QDBusVariant(value));
+            } else {
+                proxy->notifyExtendedAttributeChanged(id, target, targetItem, attribute, QDBusVariant(value));
+            }
         }
     }
 }
@@ -294,90 +871,229 @@ DBusInputContextConnection::notifyExtendedAttributeChanged(const QList<int> &cli
 void
 DBusInputContextConnection::pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info)
 {
+    resumeClient(clientId);
     ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
     if (proxy) {
-        proxy->pluginSettingsLoaded(info);
+        countControlMessage(clientId);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(clientId)) {
+            sequencedProxy->pluginSettingsLoaded(nextSequence(clientId), info);
+        } else {
+            proxy->pluginSettingsLoaded(info);
+        }
     }
 }
 
-
-unsigned int
-DBusInputContextConnection::connectionNumber()
+void DBusInputContextConnection::resyncWidgetInformation(unsigned int clientId)
 {
-    return mConnectionNumbers.value(connection().name());
+    resumeClient(clientId);
+    ComMeegoInputmethodInputcontext1Interface *proxy = mProxys.value(clientId);
+    if (proxy) {
+        countControlMessage(clientId);
+        if (ComMeegoInputmethodInputcontext2Interface *sequencedProxy = mSequencedProxys.value(clientId)) {
+            sequencedProxy->resyncWidgetInformation(nextSequence(clientId));
+        } else {
+            proxy->resyncWidgetInformation();
+        }
+    }
 }
 
-void DBusInputContextConnection::activateContext()
+void DBusInputContextConnection::queueBulkCall(const BulkCall &call)
 {
-    MInputContextConnection::activateContext(connectionNumber());
-}
+    mBulkQueue.enqueue(call);
 
-void DBusInputContextConnection::showInputMethod()
-{
-    MInputContextConnection::showInputMethod(connectionNumber());
-}
+    mInboundQueueCounters.bulkDepth = mBulkQueue.size();
+    mInboundQueueCounters.bulkMaximumDepth = qMax(mInboundQueueCounters.bulkMaximumDepth,
+                                                  mInboundQueueCounters.bulkDepth);
 
-void DBusInputContextConnection::hideInputMethod()
-{
-    MInputContextConnection::hideInputMethod(connectionNumber());
+    if (!mBulkDrainScheduled) {
+        mBulkDrainScheduled = true;
+        QMetaObject::invokeMethod(this, "drainBulkQueue", Qt::QueuedConnection);
+    }
 }
 
-void DBusInputContextConnection::mouseClickedOnPreedit(int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight)
+void DBusInputContextConnection::drainBulkQueue()
 {
-    MInputContextConnection::mouseClickedOnPreedit(connectionNumber(), QPoint(posX, posY), QRect(preeditRectX, preeditRectY, preeditRectWidth, preeditRectHeight));
+    mBulkDrainScheduled = false;
+
+    // Critical calls which arrived meanwhile were handled already. Only a
+    // few bulk calls are handled before D-Bus gets the next chance to
+    // deliver more, except for those which waited too long.
+    const qint64 now = mClock.elapsed();
+    int handled = 0;
+    while (!mBulkQueue.isEmpty()) {
+        const bool overdue = (now - mBulkQueue.head().queuedAt) >= BulkCallMaximumDelay;
+        if (handled >= BulkCallsPerIteration && !overdue)
+            break;
+
+        const BulkCall call = mBulkQueue.dequeue();
+        mInboundQueueCounters.bulkDepth = mBulkQueue.size();
+        ++mInboundQueueCounters.bulkHandled;
+        if (handled >= BulkCallsPerIteration)
+            ++mInboundQueueCounters.bulkOverdue;
+        ++handled;
+
+        handleBulkCall(call);
+    }
+
+    if (!mBulkQueue.isEmpty() && !mBulkDrainScheduled) {
+        mBulkDrainScheduled = true;
+        QMetaObject::invokeMethod(this, "drainBulkQueue", Qt::QueuedConnection);
+    }
 }
 
-void DBusInputContextConnection::setPreedit(const QString &text, int cursorPos)
+void DBusInputContextConnection::flushBulkCalls(unsigned int clientId)
 {
-    MInputContextConnection::setPreedit(connectionNumber(), text, cursorPos);
+    // The widget state refers to the attribute extensions the application
+    // registered before, bulk calls of other applications keep waiting
+    QList<BulkCall> calls;
+    for (QQueue<BulkCall>::iterator it = mBulkQueue.begin(); it != mBulkQueue.end();) {
+        if (it->clientId == clientId) {
+            calls.append(*it);
+            it = mBulkQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    mInboundQueueCounters.bulkDepth = mBulkQueue.size();
+    mInboundQueueCounters.bulkHandled += calls.size();
+
+    Q_FOREACH (const BulkCall &call, calls) {
+        handleBulkCall(call);
+    }
 }
 
-void DBusInputContextConnection::updateWidgetInformation(const QVariantMap &stateInformation, bool focusChanged)
+void DBusInputContextConnection::handleBulkCall(const BulkCall &call)
 {
-    MInputContextConnection::updateWidgetInformation(connectionNumber(), stateInformation, focusChanged);
+    switch (call.type) {
+    case BulkCall::RegisterAttributeExtension:
+        MInputContextConnection::registerAttributeExtension(call.clientId, call.id, call.name);
+        break;
+    case BulkCall::UnregisterAttributeExtension:
+        MInputContextConnection::unregisterAttributeExtension(call.clientId, call.id);
+        break;
+    case BulkCall::SetExtendedAttribute:
+        MInputContextConnection::setExtendedAttribute(call.clientId, call.id, call.name, call.targetItem,
+                                                      call.attribute, call.value);
+        break;
+    case BulkCall::LoadPluginSettings:
+        MInputContextConnection::loadPluginSettings(call.clientId, call.name);
+        break;
+    }
 }
 
-void DBusInputContextConnection::reset()
+DBusInputContextConnection::InboundQueueCounters DBusInputContextConnection::inboundQueueCounters() const
 {
-    MInputContextConnection::reset(connectionNumber());
+    return mInboundQueueCounters;
 }
 
-void DBusInputContextConnection::appOrientationAboutToChange(int angle)
+uint DBusInputContextConnection::negotiateVersion(unsigned int clientId, uint clientVersion)
 {
-    MInputContextConnection::receivedAppOrientationAboutToChange(connectionNumber(), angle);
+    const uint version = qBound(1u, clientVersion, ProtocolVersion);
+
+    // A hibernated client which negotiated before gets its proxy back here instead of a second one
+    resumeClient(clientId);
+
+    if (version >= 2 && !mSequencedProxys.contains(clientId)) {
+        mSequencedProxys.insert(clientId,
+                                new ComMeegoInputmethodInputcontext2Interface(QString(), QString::fromLatin1(DBusClientPath),
+                                                                              mPeers.value(clientId)->busConnection(),
+                                                                              this));
+        mOutgoingSequences.insert(clientId, 0);
+        // applyBatch is part of version 2, events are packed without waiting for the probe
+        mBatchingClients.insert(clientId);
+    }
+
+    return version;
 }
 
-void DBusInputContextConnection::appOrientationChanged(int angle)
+void DBusInputContextConnection::setHibernationTimeout(int timeout)
 {
-    MInputContextConnection::receivedAppOrientationChanged(connectionNumber(), angle);
+    mHibernationTimeout = qMax(timeout, 0);
+
+    if (mHibernationTimeout == 0) {
+        mHibernationTimer.stop();
+        Q_FOREACH (unsigned int clientId, mHibernatedClients) {
+            resumeClient(clientId);
+        }
+        return;
+    }
+
+    mHibernationTimer.start(qMax(mHibernationTimeout / 2, MinimumHibernationCheckInterval));
 }
 
-void DBusInputContextConnection::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
+void DBusInputContextConnection::hibernateIdleClients()
 {
-    MInputContextConnection::setCopyPasteState(connectionNumber(), copyAvailable, pasteAvailable);
+    const qint64 now = mClock.elapsed();
+
+    for (QHash<unsigned int, qint64>::const_iterator it = mLastActivity.constBegin();
+         it != mLastActivity.constEnd(); ++it) {
+        const unsigned int clientId = it.key();
+        if (clientId != activeConnection && now - it.value() >= mHibernationTimeout) {
+            hibernateClient(clientId);
+        }
+    }
 }
 
-void DBusInputContextConnection::processKeyEvent(int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time)
+void DBusInputContextConnection::hibernateClient(unsigned int clientId)
 {
-    MInputContextConnection::processKeyEvent(connectionNumber(), static_cast<QEvent::Type>(keyType), static_cast<Qt::Key>(keyCode), static_cast<Qt::KeyboardModifier>(modifiers), text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+    // Clients waiting for an answer to the fast lane offer or to the batch probe are kept
+    if (mHibernatedClients.contains(clientId) || mOfferedFastLanes.contains(clientId)
+        || !mBatchProbes.keys(clientId).isEmpty()) {
+        return;
+    }
+
+    if (mBatchClient == clientId) {
+        flushBatch();
+    }
+
+    delete mProxys.take(clientId);
+    delete mSequencedProxys.take(clientId);
+    // The application keeps its end of the lane, it gets everything over D-Bus meanwhile
+    delete mFastLanes.take(clientId);
+
+    mHibernatedClients.insert(clientId);
+    Q_EMIT clientHibernated(clientId);
 }
 
-void DBusInputContextConnection::registerAttributeExtension(int id, const QString &fileName)
+void DBusInputContextConnection::resumeClient(unsigned int clientId)
 {
-    MInputContextConnection::registerAttributeExtension(connectionNumber(), id, fileName);
+    if (!mHibernatedClients.remove(clientId)) {
+        return;
+    }
+
+    mLastActivity.insert(clientId, mClock.elapsed());
+
+    DBusInputContextPeer *peer = mPeers.value(clientId);
+    if (!peer) {
+        return;
+    }
+
+    mProxys.insert(clientId, new ComMeegoInputmethodInputcontext1Interface(QString(), QString::fromLatin1(DBusClientPath),
+                                                                           peer->busConnection(), this));
+    // Sequence numbers are kept for clients which negotiated version 2
+    if (mOutgoingSequences.contains(clientId)) {
+        mSequencedProxys.insert(clientId,
+                                new ComMeegoInputmethodInputcontext2Interface(QString(), QString::fromLatin1(DBusClientPath),
+                                                                              peer->busConnection(), this));
+    }
+
+    offerFastLane(clientId, peer->busConnection());
+
+    Q_EMIT clientResumed(clientId);
 }
 
-void DBusInputContextConnection::unregisterAttributeExtension(int id)
+int DBusInputContextConnection::hibernatedClientCount() const
 {
-    MInputContextConnection::unregisterAttributeExtension(connectionNumber(), id);
+    return mHibernatedClients.size();
 }
 
-void DBusInputContextConnection::setExtendedAttribute(int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value)
+int DBusInputContextConnection::residentClientCount() const
 {
-    MInputContextConnection::setExtendedAttribute(connectionNumber(), id, target, targetItem, attribute, value.variant());
+    return mPeers.size() - mHibernatedClients.size();
 }
 
-void DBusInputContextConnection::loadPluginSettings(const QString &descriptionLanguage)
+uint DBusInputContextConnection::nextSequence(unsigned int clientId)
 {
-    MInputContextConnection::loadPluginSettings(connectionNumber(), descriptionLanguage);
+    return ++mOutgoingSequences[clientId];
 }
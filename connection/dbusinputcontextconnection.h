@@ -16,20 +16,72 @@
 #define DBUSINPUTCONTEXTCONNECTION_H
 
 #include "minputcontextconnection.h"
+#include "inputcontextmessages.h"
 
 #include "serverdbusaddress.h"
+#include "lockfreequeue.h"
 
-#include <QDBusContext>
-#include <QDBusVariant>
+#include <QAtomicInt>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QThread>
 
 class ComMeegoInputmethodInputcontext1Interface;
+class ComMeegoInputmethodInputcontext2Interface;
+class QDBusPendingCallWatcher;
+class DBusInputContextPeer;
+class DBusInputContextListener;
+class SharedMemoryLane;
 
-class DBusInputContextConnection : public MInputContextConnection,
-                                   protected QDBusContext
+/*! \internal
+ * \brief Input context connection to applications over D-Bus.
+ *
+ * The D-Bus sockets are read and the messages demarshalled in a thread of
+ * their own, so a long frame in the thread of the connection does not delay
+ * reading the next key event. Each application talks to its own
+ * DBusInputContextPeer in that thread, which hands the calls over together
+ * with the client id of the application and the time they arrived. The hand
+ * over goes through a lock-free queue and keeps the order of the calls.
+ *
+ * Calls from applications are either latency-critical, like key events,
+ * preedit and widget state updates, or bulk, like extended attributes,
+ * attribute extensions and plugin settings. Critical calls are handled as
+ * soon as they are handed over. Bulk calls are queued and handled a few at
+ * a time from the event loop, so a burst of them does not delay the
+ * critical calls which arrive after it. Bulk calls keep their order among
+ * each other and are never delayed by more than 100 ms after they arrived.
+ * The bulk calls of an application are handled before its activation and
+ * widget state updates, which refer to the attribute extensions it
+ * registered, so they only wait for the critical calls of other applications.
+ */
+class DBusInputContextConnection : public MInputContextConnection
 {
     Q_OBJECT
+    friend class DBusInputContextPeer;
+    friend class DBusInputContextListener;
+
 public:
+    //! Counters of the queue of bulk calls, see inboundQueueCounters()
+    struct InboundQueueCounters
+    {
+        //! Bulk calls waiting to be handled
+        int bulkDepth;
+        //! Highest bulkDepth so far
+        int bulkMaximumDepth;
+        //! Bulk calls handled so far
+        quint64 bulkHandled;
+        //! Bulk calls handled ahead of their turn because they waited too long
+        quint64 bulkOverdue;
+        //! Calls handed over from the D-Bus thread so far
+        quint64 handedOver;
+        //! Longest time between a call arriving in the D-Bus thread and being handled, in ms
+        qint64 handOverMaximumDelay;
+    };
+
     explicit DBusInputContextConnection(const QSharedPointer<Maliit::Server::DBus::Address> &address);
     ~DBusInputContextConnection();
 
@@ -45,13 +97,15 @@ public:
     virtual void notifyImInitiatedHiding();
 
     virtual void setGlobalCorrectionEnabled(bool);
-    virtual QRect preeditRectangle(bool &valid);
+    virtual int requestPreeditRectangle();
     virtual void setRedirectKeys(bool enabled);
     virtual void setDetectableAutoRepeat(bool enabled);
     virtual void invokeAction(const QString &action,
                             const QKeySequence &sequence);
     virtual void setSelection(int start, int length);
-    virtual QString selection(bool &valid);
+    virtual int requestSelection();
+    virtual void setSurroundingTextWindow(int characters);
+    virtual int requestSurroundingText(int start, int length);
     virtual void setLanguage(const QString &language);
     virtual void sendActivationLostEvent();
     virtual void updateInputMethodArea(const QRegion &region);
@@ -69,34 +123,174 @@ public:
     virtual void pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info);
     //! \reimp_end
 
-    void activateContext();
-    void showInputMethod();
-    void hideInputMethod();
-    void mouseClickedOnPreedit(int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight);
-    void setPreedit(const QString &text, int cursorPos);
-    void updateWidgetInformation(const QVariantMap &stateInformation, bool focusChanged);
-    void reset();
-    void appOrientationAboutToChange(int angle);
-    void appOrientationChanged(int angle);
-    void setCopyPasteState(bool copyAvailable, bool pasteAvailable);
-    void processKeyEvent(int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time);
-    void registerAttributeExtension(int id, const QString &fileName);
-    void unregisterAttributeExtension(int id);
-    void setExtendedAttribute(int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value);
-    void loadPluginSettings(const QString &descriptionLanguage);
+    //! \reimp
+    virtual void setHibernationTimeout(int timeout);
+    //! \reimp_end
+
+    //! Returns the counters of the inbound queues. Critical calls are handed over, but never held back.
+    InboundQueueCounters inboundQueueCounters() const;
+
+    //! Number of connected clients whose resources are released, see setHibernationTimeout()
+    int hibernatedClientCount() const;
+    //! Number of connected clients which keep their resources
+    int residentClientCount() const;
 
 private Q_SLOTS:
-    void newConnection(const QDBusConnection &connection);
-    void onDisconnection();
+    void drainInboundQueue();
+    void fastLaneOfferFinished(QDBusPendingCallWatcher *watcher);
+    void preeditRectangleRequestFinished(QDBusPendingCallWatcher *watcher);
+    void selectionRequestFinished(QDBusPendingCallWatcher *watcher);
+    void surroundingTextRequestFinished(QDBusPendingCallWatcher *watcher);
+    void batchProbeFinished(QDBusPendingCallWatcher *watcher);
+    void flushBatch();
+    void drainBulkQueue();
+    void hibernateIdleClients();
 
 private:
-    unsigned int connectionNumber();
+    //! Call from an application, handed over from the D-Bus thread, see postInboundCall()
+    struct InboundCall
+    {
+        enum Type {
+            Connected,
+            Disconnected,
+            ActivateContext,
+            ShowInputMethod,
+            HideInputMethod,
+            MouseClickedOnPreedit,
+            SetPreedit,
+            UpdateWidgetInformation,
+            UpdateWidgetInformationDelta,
+            Reset,
+            AppOrientationAboutToChange,
+            AppOrientationChanged,
+            SetCopyPasteState,
+            ProcessKeyEvent,
+            ProcessPackedKeyEvent,
+            RegisterAttributeExtension,
+            UnregisterAttributeExtension,
+            SetExtendedAttribute,
+            LoadPluginSettings,
+            NegotiateVersion,
+            ResyncWidgetInformation,
+            ResyncPreedit
+        };
+
+        Type type;
+        unsigned int clientId;
+        //! Demarshalled arguments of the D-Bus call
+        QVariantList arguments;
+        //! New peer, for Connected only
+        DBusInputContextPeer *peer;
+        //! Call to reply to, for NegotiateVersion and Reset without epoch only
+        QDBusMessage message;
+        qint64 receivedAt; // in ms of mClock
+    };
+
+    //! Call of the bulk class waiting in mBulkQueue
+    struct BulkCall
+    {
+        enum Type {
+            RegisterAttributeExtension,
+            UnregisterAttributeExtension,
+            SetExtendedAttribute,
+            LoadPluginSettings
+        };
+
+        Type type;
+        unsigned int clientId;
+        int id;
+        //! File name, target or description language, depending on type
+        QString name;
+        QString targetItem;
+        QString attribute;
+        QVariant value;
+        qint64 queuedAt; // arrival in the D-Bus thread, in ms of mClock
+    };
+
+    //! Queues \a call for the thread of the connection. Called in the D-Bus thread only.
+    void postInboundCall(const InboundCall &call);
+    void handleInboundCall(const InboundCall &call);
+    void newConnection(DBusInputContextPeer *peer);
+
+    void offerFastLane(unsigned int clientId, const QDBusConnection &connection);
+    //! Needs to be called for every D-Bus message sent to the application, see SharedMemoryLane
+    void countControlMessage(unsigned int clientId);
+    bool sendOnFastLane(unsigned int clientId, const QByteArray &message);
+
+    //! Returns the protocol version used with \a clientId, at most \a clientVersion
+    uint negotiateVersion(unsigned int clientId, uint clientVersion);
+    //! Returns the next sequence number for a call to \a clientId, see negotiateVersion()
+    uint nextSequence(unsigned int clientId);
+    void resyncWidgetInformation(unsigned int clientId);
+    //! Forgets everything about \a clientId after its peer lost the connection
+    void handlePeerDisconnection(unsigned int clientId);
+
+    //! Releases the proxies and the fast lane of \a clientId
+    void hibernateClient(unsigned int clientId);
+    //! Gives \a clientId its proxies back if it was hibernated, needed before sending to it
+    void resumeClient(unsigned int clientId);
+
+    void probeBatchSupport(unsigned int clientId);
+    //! Queues \a message until control returns to the event loop, see flushBatch()
+    void queueMessage(unsigned int clientId, const QByteArray &message);
+
+    //! Queues a bulk call, see drainBulkQueue()
+    void queueBulkCall(const BulkCall &call);
+    //! Handles the queued bulk calls of \a clientId, needed before its activation and widget state
+    void flushBulkCalls(unsigned int clientId);
+    void handleBulkCall(const BulkCall &call);
 
     const QSharedPointer<Maliit::Server::DBus::Address> mAddress;
-    QScopedPointer<QDBusServer> mServer;
-    QHash<QString, unsigned int> mConnectionNumbers;
+    //! Reads from the D-Bus sockets, see postInboundCall()
+    QThread mDBusThread;
+    //! Lives in mDBusThread, deleted when it finishes
+    DBusInputContextListener *mListener;
+    //! Calls from the D-Bus thread, in the order they arrived
+    LockFreeQueue<InboundCall> mInboundCalls;
+    QAtomicInt mInboundDrainScheduled;
+    //! Objects exported to each application, living in mDBusThread
+    QHash<unsigned int, DBusInputContextPeer *> mPeers;
     QHash<unsigned int, ComMeegoInputmethodInputcontext1Interface *> mProxys;
-    QHash<unsigned int, QString> mConnections;
+    //! Proxys for applications which negotiated protocol version 2
+    QHash<unsigned int, ComMeegoInputmethodInputcontext2Interface *> mSequencedProxys;
+    //! Last sequence number sent to each application
+    QHash<unsigned int, uint> mOutgoingSequences;
+    //! Preedit last sent to each version 2 application, see sendPreeditString()
+    QHash<unsigned int, Maliit::InputContextMessage::PreeditBase> mPreeditBases;
+    //! Shared memory lanes for commit, preedit and key events, accepted by the application
+    QHash<unsigned int, SharedMemoryLane *> mFastLanes;
+    QHash<unsigned int, SharedMemoryLane *> mOfferedFastLanes;
+    QHash<QDBusPendingCallWatcher *, unsigned int> mFastLaneOffers;
+    //! Number of D-Bus messages sent to each application
+    QHash<unsigned int, quint32> mControlSerials;
+    //! Pending requestPreeditRectangle() and requestSelection() calls
+    QHash<QDBusPendingCallWatcher *, int> mPreeditRectangleRequests;
+    QHash<QDBusPendingCallWatcher *, int> mSelectionRequests;
+    //! Pending requestSurroundingText() calls, with the start of the requested range
+    QHash<QDBusPendingCallWatcher *, QPair<int, int> > mSurroundingTextRequests;
+
+    //! Applications which understand applyBatch()
+    QSet<unsigned int> mBatchingClients;
+    QHash<QDBusPendingCallWatcher *, unsigned int> mBatchProbes;
+    //! Commit, preedit and key events for mBatchClient not sent yet
+    unsigned int mBatchClient;
+    QList<QByteArray> mBatch;
+    bool mBatchFlushScheduled;
+
+    //! Bulk calls from all applications, in the order they arrived
+    QQueue<BulkCall> mBulkQueue;
+    bool mBulkDrainScheduled;
+    InboundQueueCounters mInboundQueueCounters;
+
+    //! Clients whose proxies and fast lane are released, see hibernateClient()
+    QSet<unsigned int> mHibernatedClients;
+    //! When each client was active last, in ms of mClock
+    QHash<unsigned int, qint64> mLastActivity;
+    int mHibernationTimeout; // in ms, 0 disables hibernation
+    QTimer mHibernationTimer;
+
+    //! Started before mDBusThread, so it may be read from there
+    QElapsedTimer mClock;
 
     QString lastLanguage;
 };
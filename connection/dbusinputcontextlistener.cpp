@@ -0,0 +1,63 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "dbusinputcontextlistener.h"
+
+#include "dbusinputcontextconnection.h"
+#include "dbusinputcontextpeer.h"
+
+#include <QDBusServer>
+
+namespace
+{
+
+const char * const DBusPath = "/com/meego/inputmethod/uiserver1";
+
+}
+
+DBusInputContextListener::DBusInputContextListener(DBusInputContextConnection *connection,
+                                                   const QSharedPointer<Maliit::Server::DBus::Address> &address)
+    : QObject()
+    , mConnection(connection)
+    , mAddress(address)
+    , mServer()
+    , mLastClientId(0) // 0 is used as a sentinel value, the first client gets 1
+{
+}
+
+DBusInputContextListener::~DBusInputContextListener()
+{
+}
+
+void DBusInputContextListener::listen()
+{
+    mServer.reset(mAddress->connect());
+    connect(mServer.data(), SIGNAL(newConnection(QDBusConnection)),
+            this, SLOT(newConnection(QDBusConnection)));
+}
+
+void DBusInputContextListener::newConnection(const QDBusConnection &connection)
+{
+    const unsigned int clientId = ++mLastClientId;
+
+    // Registered right away, so no call from the application finds the object missing
+    DBusInputContextPeer *peer = new DBusInputContextPeer(mConnection, clientId, connection, this);
+    QDBusConnection c(connection);
+    c.registerObject(QString::fromLatin1(DBusPath), peer);
+
+    DBusInputContextConnection::InboundCall call;
+    call.type = DBusInputContextConnection::InboundCall::Connected;
+    call.clientId = clientId;
+    call.peer = peer;
+    mConnection->postInboundCall(call);
+}
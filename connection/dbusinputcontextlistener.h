@@ -0,0 +1,56 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef DBUSINPUTCONTEXTLISTENER_H
+#define DBUSINPUTCONTEXTLISTENER_H
+
+#include "serverdbusaddress.h"
+
+#include <QObject>
+#include <QDBusConnection>
+#include <QSharedPointer>
+#include <QScopedPointer>
+
+class DBusInputContextConnection;
+
+/*! \internal
+ * \brief Accepts applications for DBusInputContextConnection on its D-Bus thread.
+ *
+ * Lives in the thread reading from the D-Bus sockets. The D-Bus server is
+ * created there, and so are the DBusInputContextPeer objects exported to the
+ * applications, which are children of the listener.
+ */
+class DBusInputContextListener : public QObject
+{
+    Q_OBJECT
+
+public:
+    DBusInputContextListener(DBusInputContextConnection *connection,
+                             const QSharedPointer<Maliit::Server::DBus::Address> &address);
+    ~DBusInputContextListener();
+
+public Q_SLOTS:
+    //! Starts accepting applications, to be called in the D-Bus thread
+    void listen();
+
+private Q_SLOTS:
+    void newConnection(const QDBusConnection &connection);
+
+private:
+    DBusInputContextConnection *mConnection;
+    const QSharedPointer<Maliit::Server::DBus::Address> mAddress;
+    QScopedPointer<QDBusServer> mServer;
+    unsigned int mLastClientId;
+};
+
+#endif // DBUSINPUTCONTEXTLISTENER_H
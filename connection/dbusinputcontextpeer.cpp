@@ -0,0 +1,317 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "dbusinputcontextpeer.h"
+
+#include "dbusinputcontextconnection.h"
+#include "minputmethodserver1interface_adaptor.h"
+#include "minputmethodserver2interface_adaptor.h"
+
+#include <QPoint>
+#include <QRect>
+
+namespace
+{
+
+const char * const DBusLocalPath("/org/freedesktop/DBus/Local");
+const char * const DBusLocalInterface("org.freedesktop.DBus.Local");
+const char * const DisconnectedSignal("Disconnected");
+
+}
+
+DBusInputContextPeer::DBusInputContextPeer(DBusInputContextConnection *connection,
+                                           unsigned int clientId,
+                                           const QDBusConnection &busConnection,
+                                           QObject *parent)
+    : QObject(parent)
+    , mConnection(connection)
+    , mClientId(clientId)
+    , mBusConnection(busConnection)
+    , mIncomingSequence(0)
+{
+    new Uiserver1Adaptor(this);
+    new Uiserver2Adaptor(this);
+
+    mBusConnection.connect(QString(), QString::fromLatin1(DBusLocalPath), QString::fromLatin1(DBusLocalInterface),
+                           QString::fromLatin1(DisconnectedSignal),
+                           this, SLOT(onDisconnection()));
+}
+
+DBusInputContextPeer::~DBusInputContextPeer()
+{
+}
+
+unsigned int DBusInputContextPeer::clientId() const
+{
+    return mClientId;
+}
+
+QDBusConnection DBusInputContextPeer::busConnection() const
+{
+    return mBusConnection;
+}
+
+void DBusInputContextPeer::post(InboundCall::Type type, const QVariantList &arguments)
+{
+    InboundCall call;
+    call.type = type;
+    call.clientId = mClientId;
+    call.arguments = arguments;
+    call.peer = 0;
+    mConnection->postInboundCall(call);
+}
+
+void DBusInputContextPeer::onDisconnection()
+{
+    post(InboundCall::Disconnected);
+}
+
+void DBusInputContextPeer::activateContext()
+{
+    post(InboundCall::ActivateContext);
+}
+
+void DBusInputContextPeer::showInputMethod()
+{
+    post(InboundCall::ShowInputMethod);
+}
+
+void DBusInputContextPeer::hideInputMethod()
+{
+    post(InboundCall::HideInputMethod);
+}
+
+void DBusInputContextPeer::mouseClickedOnPreedit(int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight)
+{
+    post(InboundCall::MouseClickedOnPreedit,
+         QVariantList() << QPoint(posX, posY)
+                        << QRect(preeditRectX, preeditRectY, preeditRectWidth, preeditRectHeight));
+}
+
+void DBusInputContextPeer::setPreedit(const QString &text, int cursorPos)
+{
+    post(InboundCall::SetPreedit, QVariantList() << text << cursorPos);
+}
+
+void DBusInputContextPeer::updateWidgetInformation(const QVariantMap &stateInformation, bool focusChanged)
+{
+    post(InboundCall::UpdateWidgetInformation, QVariantList() << stateInformation << focusChanged);
+}
+
+void DBusInputContextPeer::updateWidgetInformationDelta(const QVariantMap &changedState, const QStringList &removedKeys,
+                                                        uint baseVersion, bool focusChanged)
+{
+    post(InboundCall::UpdateWidgetInformationDelta,
+         QVariantList() << changedState << removedKeys << baseVersion << focusChanged);
+}
+
+void DBusInputContextPeer::reset()
+{
+    // Answered once the reset was handled in the thread of the connection
+    setDelayedReply(true);
+
+    InboundCall call;
+    call.type = InboundCall::Reset;
+    call.clientId = mClientId;
+    call.peer = 0;
+    call.message = message();
+    mConnection->postInboundCall(call);
+}
+
+void DBusInputContextPeer::appOrientationAboutToChange(int angle)
+{
+    post(InboundCall::AppOrientationAboutToChange, QVariantList() << angle);
+}
+
+void DBusInputContextPeer::appOrientationChanged(int angle)
+{
+    post(InboundCall::AppOrientationChanged, QVariantList() << angle);
+}
+
+void DBusInputContextPeer::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
+{
+    post(InboundCall::SetCopyPasteState, QVariantList() << copyAvailable << pasteAvailable);
+}
+
+void DBusInputContextPeer::processKeyEvent(int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time)
+{
+    post(InboundCall::ProcessKeyEvent,
+         QVariantList() << keyType << keyCode << modifiers << text << autoRepeat << count
+                        << nativeScanCode << nativeModifiers << time);
+}
+
+void DBusInputContextPeer::registerAttributeExtension(int id, const QString &fileName)
+{
+    post(InboundCall::RegisterAttributeExtension, QVariantList() << id << fileName);
+}
+
+void DBusInputContextPeer::unregisterAttributeExtension(int id)
+{
+    post(InboundCall::UnregisterAttributeExtension, QVariantList() << id);
+}
+
+void DBusInputContextPeer::setExtendedAttribute(int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value)
+{
+    post(InboundCall::SetExtendedAttribute,
+         QVariantList() << id << target << targetItem << attribute << value.variant());
+}
+
+void DBusInputContextPeer::loadPluginSettings(const QString &descriptionLanguage)
+{
+    post(InboundCall::LoadPluginSettings, QVariantList() << descriptionLanguage);
+}
+
+uint DBusInputContextPeer::negotiateVersion(uint clientVersion)
+{
+    // The proxies for the negotiated version are created in the thread of the connection
+    setDelayedReply(true);
+
+    InboundCall call;
+    call.type = InboundCall::NegotiateVersion;
+    call.clientId = mClientId;
+    call.arguments = QVariantList() << clientVersion;
+    call.peer = 0;
+    call.message = message();
+    mConnection->postInboundCall(call);
+
+    return 0;
+}
+
+void DBusInputContextPeer::checkSequence(uint sequence)
+{
+    const uint expectedSequence = mIncomingSequence + 1;
+
+    if (sequence == expectedSequence) {
+        mIncomingSequence = sequence;
+        return;
+    }
+
+    qWarning() << __PRETTY_FUNCTION__ << "expected call" << expectedSequence
+               << "from client" << mClientId << "but got" << sequence;
+
+    if (static_cast<qint32>(sequence - mIncomingSequence) > 0) {
+        mIncomingSequence = sequence;
+    }
+
+    // The widget state may be out of date after lost or reordered calls
+    post(InboundCall::ResyncWidgetInformation);
+}
+
+void DBusInputContextPeer::activateContext(uint sequence)
+{
+    checkSequence(sequence);
+    activateContext();
+}
+
+void DBusInputContextPeer::showInputMethod(uint sequence)
+{
+    checkSequence(sequence);
+    showInputMethod();
+}
+
+void DBusInputContextPeer::hideInputMethod(uint sequence)
+{
+    checkSequence(sequence);
+    hideInputMethod();
+}
+
+void DBusInputContextPeer::mouseClickedOnPreedit(uint sequence, int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight)
+{
+    checkSequence(sequence);
+    mouseClickedOnPreedit(posX, posY, preeditRectX, preeditRectY, preeditRectWidth, preeditRectHeight);
+}
+
+void DBusInputContextPeer::setPreedit(uint sequence, const QString &text, int cursorPos)
+{
+    checkSequence(sequence);
+    setPreedit(text, cursorPos);
+}
+
+void DBusInputContextPeer::updateWidgetInformation(uint sequence, const QVariantMap &stateInformation, bool focusChanged)
+{
+    checkSequence(sequence);
+    updateWidgetInformation(stateInformation, focusChanged);
+}
+
+void DBusInputContextPeer::updateWidgetInformationDelta(uint sequence, const QVariantMap &changedState, const QStringList &removedKeys,
+                                                        uint baseVersion, bool focusChanged)
+{
+    checkSequence(sequence);
+    updateWidgetInformationDelta(changedState, removedKeys, baseVersion, focusChanged);
+}
+
+void DBusInputContextPeer::reset(uint sequence, uint resetEpoch)
+{
+    checkSequence(sequence);
+    post(InboundCall::Reset, QVariantList() << resetEpoch);
+}
+
+void DBusInputContextPeer::appOrientationAboutToChange(uint sequence, int angle)
+{
+    checkSequence(sequence);
+    appOrientationAboutToChange(angle);
+}
+
+void DBusInputContextPeer::appOrientationChanged(uint sequence, int angle)
+{
+    checkSequence(sequence);
+    appOrientationChanged(angle);
+}
+
+void DBusInputContextPeer::setCopyPasteState(uint sequence, bool copyAvailable, bool pasteAvailable)
+{
+    checkSequence(sequence);
+    setCopyPasteState(copyAvailable, pasteAvailable);
+}
+
+void DBusInputContextPeer::processKeyEvent(uint sequence, int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time)
+{
+    checkSequence(sequence);
+    processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+}
+
+void DBusInputContextPeer::processPackedKeyEvent(uint sequence, const QByteArray &event)
+{
+    checkSequence(sequence);
+    post(InboundCall::ProcessPackedKeyEvent, QVariantList() << event);
+}
+
+void DBusInputContextPeer::registerAttributeExtension(uint sequence, int id, const QString &fileName)
+{
+    checkSequence(sequence);
+    registerAttributeExtension(id, fileName);
+}
+
+void DBusInputContextPeer::unregisterAttributeExtension(uint sequence, int id)
+{
+    checkSequence(sequence);
+    unregisterAttributeExtension(id);
+}
+
+void DBusInputContextPeer::setExtendedAttribute(uint sequence, int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value)
+{
+    checkSequence(sequence);
+    setExtendedAttribute(id, target, targetItem, attribute, value);
+}
+
+void DBusInputContextPeer::loadPluginSettings(uint sequence, const QString &descriptionLanguage)
+{
+    checkSequence(sequence);
+    loadPluginSettings(descriptionLanguage);
+}
+
+void DBusInputContextPeer::resyncPreedit(uint sequence)
+{
+    checkSequence(sequence);
+    post(InboundCall::ResyncPreedit);
+}
@@ -0,0 +1,111 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef DBUSINPUTCONTEXTPEER_H
+#define DBUSINPUTCONTEXTPEER_H
+
+#include "dbusinputcontextconnection.h"
+
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QDBusVariant>
+#include <QObject>
+#include <QVariantMap>
+
+/*! \internal
+ * \brief Object exported to one application connected to DBusInputContextConnection.
+ *
+ * Every peer connection gets its own object, carrying the client id of the
+ * application. Calls from the application are passed on to the
+ * DBusInputContextConnection with that id, so the caller does not have to
+ * be looked up by its connection name.
+ *
+ * Peers live in the D-Bus thread of the connection, see
+ * DBusInputContextListener. Calls are only checked and queued there, they
+ * are handled in the thread of the connection.
+ */
+class DBusInputContextPeer : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+
+public:
+    DBusInputContextPeer(DBusInputContextConnection *connection, unsigned int clientId,
+                         const QDBusConnection &busConnection, QObject *parent = 0);
+    ~DBusInputContextPeer();
+
+    unsigned int clientId() const;
+    QDBusConnection busConnection() const;
+
+    //! From com.meego.inputmethod.uiserver1
+    void activateContext();
+    void showInputMethod();
+    void hideInputMethod();
+    void mouseClickedOnPreedit(int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight);
+    void setPreedit(const QString &text, int cursorPos);
+    void updateWidgetInformation(const QVariantMap &stateInformation, bool focusChanged);
+    void updateWidgetInformationDelta(const QVariantMap &changedState, const QStringList &removedKeys,
+                                      uint baseVersion, bool focusChanged);
+    void reset();
+    void appOrientationAboutToChange(int angle);
+    void appOrientationChanged(int angle);
+    void setCopyPasteState(bool copyAvailable, bool pasteAvailable);
+    void processKeyEvent(int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time);
+    void registerAttributeExtension(int id, const QString &fileName);
+    void unregisterAttributeExtension(int id);
+    void setExtendedAttribute(int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value);
+    void loadPluginSettings(const QString &descriptionLanguage);
+
+    //! Returns the protocol version used with the application, at most \a clientVersion.
+    //! The reply is sent from the thread of the connection.
+    uint negotiateVersion(uint clientVersion);
+
+    //! Sequenced variants from com.meego.inputmethod.uiserver2, available after negotiateVersion()
+    void activateContext(uint sequence);
+    void showInputMethod(uint sequence);
+    void hideInputMethod(uint sequence);
+    void mouseClickedOnPreedit(uint sequence, int posX, int posY, int preeditRectX, int preeditRectY, int preeditRectWidth, int preeditRectHeight);
+    void setPreedit(uint sequence, const QString &text, int cursorPos);
+    void updateWidgetInformation(uint sequence, const QVariantMap &stateInformation, bool focusChanged);
+    void updateWidgetInformationDelta(uint sequence, const QVariantMap &changedState, const QStringList &removedKeys,
+                                      uint baseVersion, bool focusChanged);
+    void reset(uint sequence, uint resetEpoch);
+    void appOrientationAboutToChange(uint sequence, int angle);
+    void appOrientationChanged(uint sequence, int angle);
+    void setCopyPasteState(uint sequence, bool copyAvailable, bool pasteAvailable);
+    void processKeyEvent(uint sequence, int keyType, int keyCode, int modifiers, const QString &text, bool autoRepeat, int count, uint nativeScanCode, uint nativeModifiers, uint time);
+    void processPackedKeyEvent(uint sequence, const QByteArray &event);
+    void registerAttributeExtension(uint sequence, int id, const QString &fileName);
+    void unregisterAttributeExtension(uint sequence, int id);
+    void setExtendedAttribute(uint sequence, int id, const QString &target, const QString &targetItem, const QString &attribute, const QDBusVariant &value);
+    void loadPluginSettings(uint sequence, const QString &descriptionLanguage);
+    void resyncPreedit(uint sequence);
+
+private Q_SLOTS:
+    void onDisconnection();
+
+private:
+    typedef DBusInputContextConnection::InboundCall InboundCall;
+
+    //! Detects lost or reordered calls from the application
+    void checkSequence(uint sequence);
+    //! Queues a call for the thread of the connection
+    void post(InboundCall::Type type, const QVariantList &arguments = QVariantList());
+
+    DBusInputContextConnection *mConnection;
+    const unsigned int mClientId;
+    QDBusConnection mBusConnection;
+    //! Last sequence number received from the application
+    uint mIncomingSequence;
+};
+
+#endif // DBUSINPUTCONTEXTPEER_H
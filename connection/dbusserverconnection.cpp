@@ -16,12 +16,19 @@
 
 #include <maliit/namespace.h>
 #include <maliit/settingdata.h>
+#include <maliit/widgetstate.h>
 
 #include "minputmethodcontext1interface_adaptor.h"
 #include "minputmethodserver1interface_interface.h"
+#include "minputmethodcontext2interface_adaptor.h"
+#include "minputmethodserver2interface_interface.h"
 #include "dbuscustomarguments.h"
+#include "inputcontextmessages.h"
+#include "sharedmemorylane.h"
 
 #include <QDBusConnection>
+#include <QDBusUnixFileDescriptor>
+#include <QSocketNotifier>
 #include <QDebug>
 
 namespace
@@ -32,15 +39,68 @@ namespace
     const char * const DBusLocalPath("/org/freedesktop/DBus/Local");
     const char * const DBusLocalInterface("org.freedesktop.DBus.Local");
     const char * const DisconnectedSignal("Disconnected");
-    const int ConnectionRetryInterval(6*1000); // in ms
+    const int InitialReconnectInterval(250); // in ms
+    const int ConnectionRetryInterval(6*1000); // in ms, upper bound of the reconnection backoff
+    const uint ProtocolVersion(2); // highest version supported, see negotiateVersion()
+
+    unsigned int nextWidgetStateVersion(unsigned int version)
+    {
+        // 0 is reserved for "no valid state"
+        ++version;
+        return version ? version : 1;
+    }
+
+    //! Replaces the new surrounding text in \a changedState by the edit turning \a oldText into it
+    void insertSurroundingTextEdit(QVariantMap &changedState, const QString &oldText)
+    {
+        const QString newText = changedState.take(Maliit::WidgetStateAttribute::SurroundingText).toString();
+
+        // Edits are local, so skip the unchanged head and tail of the text
+        const int commonLength = qMin(oldText.length(), newText.length());
+        int prefix = 0;
+        while (prefix < commonLength && oldText.at(prefix) == newText.at(prefix)) {
+            ++prefix;
+        }
+        int suffix = 0;
+        while (suffix < commonLength - prefix
+               && oldText.at(oldText.length() - 1 - suffix) == newText.at(newText.length() - 1 - suffix)) {
+            ++suffix;
+        }
+
+        changedState.insert(Maliit::WidgetStateEdit::SurroundingTextEditPosition, prefix);
+        changedState.insert(Maliit::WidgetStateEdit::SurroundingTextEditRemoved,
+                            oldText.length() - prefix - suffix);
+        changedState.insert(Maliit::WidgetStateEdit::SurroundingTextEditText,
+                            newText.mid(prefix, newText.length() - prefix - suffix));
+    }
 }
 
 DBusServerConnection::DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address) :
     MImServerConnection(0)
   , mAddress(address)
+  , mReconnectTimer()
+  , mReconnectInterval(InitialReconnectInterval)
   , mProxy(0)
+  , mSequencedProxy(0)
+  , mOutgoingSequence(0)
+  , mIncomingSequence(0)
   , mActive(true)
   , pendingResetCalls()
+  , mLastWidgetState()
+  , mWidgetStateVersion(0)
+  , mDeltaSupport(DeltaSupportUnknown)
+  , mFastLane(0)
+  , mFastLaneNotifier(0)
+  , mDrainingFastLane(false)
+  , mApplyingBatch(false)
+  , mControlMessagesReceived(0)
+  , mKeyRepeatTimer()
+  , mRepeatedKey()
+  , mKeyRepeatRun(false)
+  , mKeyRepeats(0)
+  , mKeyRepeatReleases(false)
+  , mHeldRelease()
+  , mReleaseHeld(false)
 {
     qDBusRegisterMetaType<MImPluginSettingsEntry>();
     qDBusRegisterMetaType<MImPluginSettingsInfo>();
@@ -49,11 +109,48 @@ DBusServerConnection::DBusServerConnection(const QSharedPointer<Maliit::InputCon
     qDBusRegisterMetaType<QList<Maliit::PreeditTextFormat> >();
 
     new Inputcontext1Adaptor(this);
+    new Inputcontext2Adaptor(this);
+
+    // Messages from the shared memory lane have to be handled before any D-Bus
+    // message sent after them. Connecting first makes sure that happens before
+    // the input context sees the D-Bus message.
+    const char * const incomingSignals[] = {
+        SIGNAL(activationLostEvent()),
+        SIGNAL(imInitiatedHide()),
+        SIGNAL(commitString(QString,int,int,int)),
+        SIGNAL(updatePreedit(QString,QList<Maliit::PreeditTextFormat>,int,int,int)),
+        SIGNAL(keyEvent(int,int,int,QString,bool,int,Maliit::EventRequestType)),
+        SIGNAL(updateInputMethodArea(QRect)),
+        SIGNAL(setGlobalCorrectionEnabled(bool)),
+        SIGNAL(getPreeditRectangle(QRect&,bool&)),
+        SIGNAL(setRedirectKeys(bool)),
+        SIGNAL(setDetectableAutoRepeat(bool)),
+        SIGNAL(setSelection(int,int)),
+        SIGNAL(getSelection(QString&,bool&)),
+        SIGNAL(setLanguage(QString)),
+        SIGNAL(setSurroundingTextWindow(int)),
+        SIGNAL(getSurroundingText(int,int,QString&,bool&)),
+        SIGNAL(extendedAttributeChanged(int,QString,QString,QString,QVariant)),
+        SIGNAL(pluginSettingsReceived(QList<MImPluginSettingsInfo>))
+    };
+    for (unsigned int i = 0; i < sizeof(incomingSignals) / sizeof(incomingSignals[0]); ++i) {
+        connect(this, incomingSignals[i], this, SLOT(controlMessageReceived()));
+    }
 
     connect(mAddress.data(), SIGNAL(addressReceived(QString)),
             this, SLOT(openDBusConnection(QString)));
     connect(mAddress.data(), SIGNAL(addressFetchError(QString)),
             this, SLOT(connectToDBusFailed(QString)));
+    connect(mAddress.data(), SIGNAL(serverAvailable()),
+            this, SLOT(onServerAvailable()));
+
+    mReconnectTimer.setSingleShot(true);
+    connect(&mReconnectTimer, SIGNAL(timeout()), this, SLOT(connectToDBus()));
+
+    // Autorepeats piling up are sent once the event loop comes back
+    mKeyRepeatTimer.setSingleShot(true);
+    mKeyRepeatTimer.setInterval(0);
+    connect(&mKeyRepeatTimer, SIGNAL(timeout()), this, SLOT(keyRepeatTimeout()));
 
     QTimer::singleShot(0, this, SLOT(connectToDBus()));
 }
@@ -61,6 +158,7 @@ DBusServerConnection::DBusServerConnection(const QSharedPointer<Maliit::InputCon
 DBusServerConnection::~DBusServerConnection()
 {
     mActive = false;
+    closeFastLane();
     Q_FOREACH (QDBusPendingCallWatcher *watcher, pendingResetCalls) {
         disconnect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
                    this, SLOT(resetCallFinished(QDBusPendingCallWatcher*)));
@@ -74,19 +172,46 @@ void DBusServerConnection::connectToDBus()
 
 void DBusServerConnection::openDBusConnection(const QString &addressString)
 {
+    // a get() started before the connection was established may still answer
+    if (mProxy)
+        return;
+
     if (addressString.isEmpty()) {
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+        scheduleReconnect();
         return;
     }
 
     QDBusConnection connection = QDBusConnection::connectToPeer(addressString, QString::fromLatin1(IMServerConnection));
     if (!connection.isConnected()) {
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+        QDBusConnection::disconnectFromPeer(QString::fromLatin1(IMServerConnection));
+        if (mAddress->addressFailed(addressString)) {
+            connectToDBus();
+            return;
+        }
+        scheduleReconnect();
         return;
     }
 
+    mReconnectTimer.stop();
+    mReconnectInterval = InitialReconnectInterval;
+
     mProxy = new ComMeegoInputmethodUiserver1Interface(QString(), QString::fromLatin1(IMServerPath), connection, this);
 
+    // A (possibly different) server needs to get the full widget state first
+    mWidgetStateVersion = 0;
+    mDeltaSupport = DeltaSupportUnknown;
+
+    closeFastLane();
+    mControlMessagesReceived = 0;
+    clearMessageState();
+
+    // Calls use version 1 until the server agreed on a newer one
+    mOutgoingSequence = 0;
+    mIncomingSequence = 0;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mProxy->negotiateVersion(ProtocolVersion), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(versionNegotiated(QDBusPendingCallWatcher*)));
+
     connection.connect(QString(), QString::fromLatin1(DBusLocalPath), QString::fromLatin1(DBusLocalInterface),
                        QString::fromLatin1(DisconnectedSignal),
                        this, SLOT(onDisconnection()));
@@ -101,18 +226,56 @@ void DBusServerConnection::openDBusConnection(const QString &addressString)
 
 void DBusServerConnection::connectToDBusFailed(const QString &)
 {
-    QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+    if (mProxy)
+        return;
+
+    scheduleReconnect();
+}
+
+void DBusServerConnection::scheduleReconnect()
+{
+    if (!mActive || mReconnectTimer.isActive())
+        return;
+
+    // The address watches the bus for the server, so polling only matters
+    // while no server is around and may back off
+    mReconnectTimer.start(mReconnectInterval);
+    mReconnectInterval = qMin(mReconnectInterval * 2, ConnectionRetryInterval);
+}
+
+void DBusServerConnection::onServerAvailable()
+{
+    if (mProxy || !mActive)
+        return;
+
+    // no point in waiting any longer, the server just announced itself
+    mReconnectTimer.stop();
+    mReconnectInterval = InitialReconnectInterval;
+    connectToDBus();
 }
 
 void DBusServerConnection::onDisconnection()
 {
+    // deliver what the server sent before it went away
+    drainFastLane();
+    closeFastLane();
+
+    mKeyRepeatTimer.stop();
+    mKeyRepeatRun = false;
+    mKeyRepeats = 0;
+    mReleaseHeld = false;
+
+    delete mSequencedProxy;
+    mSequencedProxy = 0;
     delete mProxy;
     mProxy = 0;
     QDBusConnection::disconnectFromPeer(QString::fromLatin1(IMServerConnection));
     Q_EMIT disconnected();
 
-    if (mActive)
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+    // A crashed or upgraded server is usually back soon. The input context
+    // replays its state on connected().
+    mReconnectInterval = InitialReconnectInterval;
+    scheduleReconnect();
 }
 
 void DBusServerConnection::resetCallFinished(QDBusPendingCallWatcher *watcher)
@@ -126,12 +289,78 @@ bool DBusServerConnection::pendingResets()
     return !pendingResetCalls.empty();
 }
 
+void DBusServerConnection::deltaCallFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    if (mDeltaSupport != DeltaSupportUnknown)
+        return;
+
+    if (watcher->isError()) {
+        // Server predates delta updates, fall back to full updates
+        qWarning() << "Widget state delta updates not supported by server:" << watcher->error().message();
+        mDeltaSupport = DeltaUnsupported;
+        sendFullWidgetInformation(false);
+    } else {
+        mDeltaSupport = DeltaSupported;
+    }
+}
+
+void DBusServerConnection::versionNegotiated(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    QDBusPendingReply<uint> reply = *watcher;
+    // Older servers do not know negotiateVersion and keep using version 1.
+    // Also ignore answers for a connection which is gone meanwhile.
+    if (!mProxy || mSequencedProxy || reply.isError() || reply.value() < 2)
+        return;
+
+    mSequencedProxy = new ComMeegoInputmethodUiserver2Interface(QString(), QString::fromLatin1(IMServerPath),
+                                                                mProxy->connection(), this);
+    // Servers supporting version 2 know about widget state deltas
+    if (mDeltaSupport == DeltaSupportUnknown) {
+        mDeltaSupport = DeltaSupported;
+    }
+}
+
+uint DBusServerConnection::nextSequence()
+{
+    return ++mOutgoingSequence;
+}
+
+void DBusServerConnection::checkSequence(uint sequence)
+{
+    const uint expectedSequence = mIncomingSequence + 1;
+
+    if (sequence != expectedSequence) {
+        qWarning() << __PRETTY_FUNCTION__ << "expected call" << expectedSequence
+                   << "from server but got" << sequence;
+    }
+
+    if (static_cast<qint32>(sequence - mIncomingSequence) > 0) {
+        mIncomingSequence = sequence;
+    }
+}
+
 void DBusServerConnection::activateContext()
 {
     if (!mProxy)
         return;
 
-    mProxy->activateContext();
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->activateContext(nextSequence());
+    } else {
+        mProxy->activateContext();
+    }
+
+    // Servers before version 2 drop the state of a client when it gets activated,
+    // newer ones keep it and ask for the full state if they could not
+    if (!mSequencedProxy) {
+        mWidgetStateVersion = 0;
+    }
 }
 
 void DBusServerConnection::showInputMethod()
@@ -139,7 +368,13 @@ void DBusServerConnection::showInputMethod()
     if (!mProxy)
         return;
 
-    mProxy->showInputMethod();
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->showInputMethod(nextSequence());
+    } else {
+        mProxy->showInputMethod();
+    }
 }
 
 void DBusServerConnection::hideInputMethod()
@@ -147,7 +382,13 @@ void DBusServerConnection::hideInputMethod()
     if (!mProxy)
         return;
 
-    mProxy->hideInputMethod();
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->hideInputMethod(nextSequence());
+    } else {
+        mProxy->hideInputMethod();
+    }
 }
 
 void DBusServerConnection::mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect)
@@ -155,8 +396,15 @@ void DBusServerConnection::mouseClickedOnPreedit(const QPoint &pos, const QRect
     if (!mProxy)
         return;
 
-    mProxy->mouseClickedOnPreedit(pos.x(), pos.y(), preeditRect.x(), preeditRect.y(),
-                                  preeditRect.width(), preeditRect.height());
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->mouseClickedOnPreedit(nextSequence(), pos.x(), pos.y(), preeditRect.x(), preeditRect.y(),
+                                               preeditRect.width(), preeditRect.height());
+    } else {
+        mProxy->mouseClickedOnPreedit(pos.x(), pos.y(), preeditRect.x(), preeditRect.y(),
+                                      preeditRect.width(), preeditRect.height());
+    }
 }
 
 void DBusServerConnection::setPreedit(const QString &text, int cursorPos)
@@ -164,7 +412,13 @@ void DBusServerConnection::setPreedit(const QString &text, int cursorPos)
     if (!mProxy)
         return;
 
-    mProxy->setPreedit(text, cursorPos);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->setPreedit(nextSequence(), text, cursorPos);
+    } else {
+        mProxy->setPreedit(text, cursorPos);
+    }
 }
 
 void DBusServerConnection::updateWidgetInformation(const QMap<QString, QVariant> &stateInformation, bool focusChanged)
@@ -172,7 +426,172 @@ void DBusServerConnection::updateWidgetInformation(const QMap<QString, QVariant>
     if (!mProxy)
         return;
 
-    mProxy->updateWidgetInformation(stateInformation, focusChanged);
+    flushKeyRepeats();
+
+    const QMap<QString, QVariant> lastState = mLastWidgetState;
+    mLastWidgetState = stateInformation;
+
+    // The whole text is only sent when the focus moves or the server lost track of it
+    if (mWidgetStateVersion == 0 || mDeltaSupport == DeltaUnsupported || focusChanged) {
+        sendFullWidgetInformation(focusChanged);
+        return;
+    }
+
+    // Both maps are sorted by key, so one pass finds all differences
+    QVariantMap changedState;
+    QStringList removedKeys;
+    QMap<QString, QVariant>::const_iterator oldIter = lastState.constBegin();
+    QMap<QString, QVariant>::const_iterator newIter = stateInformation.constBegin();
+
+    while (oldIter != lastState.constEnd() || newIter != stateInformation.constEnd()) {
+        if (newIter == stateInformation.constEnd()
+            || (oldIter != lastState.constEnd() && oldIter.key() < newIter.key())) {
+            removedKeys.append(oldIter.key());
+            ++oldIter;
+        } else if (oldIter == lastState.constEnd() || newIter.key() < oldIter.key()) {
+            changedState.insert(newIter.key(), newIter.value());
+            ++newIter;
+        } else {
+            if (oldIter.value() != newIter.value()) {
+                changedState.insert(newIter.key(), newIter.value());
+            }
+            ++oldIter;
+            ++newIter;
+        }
+    }
+
+    if (mSequencedProxy) {
+        // Servers speaking version 2 apply text edits to their copy of the text
+        if (changedState.contains(Maliit::WidgetStateAttribute::SurroundingText)
+            && lastState.contains(Maliit::WidgetStateAttribute::SurroundingText)) {
+            insertSurroundingTextEdit(changedState,
+                                      lastState.value(Maliit::WidgetStateAttribute::SurroundingText).toString());
+        }
+
+        mSequencedProxy->updateWidgetInformationDelta(nextSequence(), changedState, removedKeys,
+                                                      mWidgetStateVersion, focusChanged);
+        mWidgetStateVersion = nextWidgetStateVersion(mWidgetStateVersion);
+        return;
+    }
+
+    QDBusPendingCall call = mProxy->updateWidgetInformationDelta(changedState, removedKeys,
+                                                                 mWidgetStateVersion, focusChanged);
+    mWidgetStateVersion = nextWidgetStateVersion(mWidgetStateVersion);
+
+    if (mDeltaSupport == DeltaSupportUnknown) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+        QObject::connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                         this, SLOT(deltaCallFinished(QDBusPendingCallWatcher*)));
+    }
+}
+
+void DBusServerConnection::sendFullWidgetInformation(bool focusChanged)
+{
+    if (!mProxy)
+        return;
+
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->updateWidgetInformation(nextSequence(), mLastWidgetState, focusChanged);
+    } else {
+        mProxy->updateWidgetInformation(mLastWidgetState, focusChanged);
+    }
+    mWidgetStateVersion = 1;
+}
+
+void DBusServerConnection::resyncWidgetInformation()
+{
+    controlMessageReceived();
+    sendFullWidgetInformation(false);
+}
+
+bool DBusServerConnection::setFastLane(const QDBusUnixFileDescriptor &memory,
+                                       const QDBusUnixFileDescriptor &doorbell,
+                                       uint capacity)
+{
+    controlMessageReceived();
+    closeFastLane();
+
+    if (!memory.isValid() || !doorbell.isValid())
+        return false;
+
+    mFastLane = SharedMemoryLane::attach(memory.fileDescriptor(), doorbell.fileDescriptor(), capacity);
+    if (!mFastLane)
+        return false;
+
+    mFastLaneNotifier = new QSocketNotifier(mFastLane->eventFd(), QSocketNotifier::Read, this);
+    connect(mFastLaneNotifier, SIGNAL(activated(int)),
+            this, SLOT(fastLaneDoorbell()));
+
+    return true;
+}
+
+void DBusServerConnection::applyBatch(const QByteArray &messages)
+{
+    // An empty batch is sent by the server to find out whether batches are
+    // supported. It is not counted, see DBusInputContextConnection::probeBatchSupport()
+    if (messages.isEmpty())
+        return;
+
+    controlMessageReceived();
+
+    mApplyingBatch = true;
+    if (!Maliit::InputContextMessage::dispatch(messages, this)) {
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed batch";
+        discardPreeditBase();
+    }
+    mApplyingBatch = false;
+}
+
+void DBusServerConnection::closeFastLane()
+{
+    delete mFastLaneNotifier;
+    mFastLaneNotifier = 0;
+    delete mFastLane;
+    mFastLane = 0;
+}
+
+void DBusServerConnection::controlMessageReceived()
+{
+    // Emitted by drainFastLane() or applyBatch() itself, not by a D-Bus message
+    if (mDrainingFastLane || mApplyingBatch)
+        return;
+
+    drainFastLane();
+    ++mControlMessagesReceived;
+
+    // Messages sent after this D-Bus message have to wait until it was handled
+    if (mFastLane && mFastLane->hasPending()) {
+        QMetaObject::invokeMethod(this, "drainFastLane", Qt::QueuedConnection);
+    }
+}
+
+void DBusServerConnection::fastLaneDoorbell()
+{
+    if (!mFastLane)
+        return;
+
+    mFastLane->clearDoorbell();
+    drainFastLane();
+}
+
+void DBusServerConnection::drainFastLane()
+{
+    if (!mFastLane || mDrainingFastLane)
+        return;
+
+    mDrainingFastLane = true;
+
+    QByteArray message;
+    while (mFastLane && mFastLane->read(&message, mControlMessagesReceived)) {
+        if (!Maliit::InputContextMessage::dispatch(message, this)) {
+            qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed message";
+            discardPreeditBase();
+        }
+    }
+
+    mDrainingFastLane = false;
 }
 
 void DBusServerConnection::reset(bool requireSynchronization)
@@ -180,6 +599,14 @@ void DBusServerConnection::reset(bool requireSynchronization)
     if (!mProxy)
         return;
 
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        // Stale commit and preedit messages are recognized by their epoch, nothing to wait for
+        mSequencedProxy->reset(nextSequence(), requireSynchronization ? startResetEpoch() : resetEpoch());
+        return;
+    }
+
     QDBusPendingCall resetCall = mProxy->reset();
     if (requireSynchronization) {
         QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(resetCall, this);
@@ -194,7 +621,13 @@ void DBusServerConnection::appOrientationAboutToChange(int angle)
     if (!mProxy)
         return;
 
-    mProxy->appOrientationAboutToChange(angle);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->appOrientationAboutToChange(nextSequence(), angle);
+    } else {
+        mProxy->appOrientationAboutToChange(angle);
+    }
 }
 
 void DBusServerConnection::appOrientationChanged(int angle)
@@ -202,7 +635,13 @@ void DBusServerConnection::appOrientationChanged(int angle)
     if (!mProxy)
         return;
 
-    mProxy->appOrientationChanged(angle);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->appOrientationChanged(nextSequence(), angle);
+    } else {
+        mProxy->appOrientationChanged(angle);
+    }
 }
 
 void DBusServerConnection::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
@@ -210,7 +649,13 @@ void DBusServerConnection::setCopyPasteState(bool copyAvailable, bool pasteAvail
     if (!mProxy)
         return;
 
-    mProxy->setCopyPasteState(copyAvailable, pasteAvailable);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->setCopyPasteState(nextSequence(), copyAvailable, pasteAvailable);
+    } else {
+        mProxy->setCopyPasteState(copyAvailable, pasteAvailable);
+    }
 }
 
 void DBusServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
@@ -221,7 +666,114 @@ void DBusServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode
     if (!mProxy)
         return;
 
-    mProxy->processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+    if (!mSequencedProxy) {
+        mProxy->processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+        return;
+    }
+
+    // Autorepeats which pile up while the application is busy reach the
+    // server together. Older servers do not speak version 2.
+    if (autoRepeat && count == 1) {
+        const HeldKey key = { keyCode, modifiers, text, nativeScanCode, nativeModifiers, time };
+        if (coalesceKeyRepeat(keyType, key))
+            return;
+
+        // The first press of a run is sent right away, only the ones
+        // following it in the same event loop iteration are kept back
+        if (keyType == QEvent::KeyPress) {
+            const bool releases = mReleaseHeld && mHeldRelease.isSameKey(key);
+            flushKeyRepeats();
+            sendPackedKeyEvent(Maliit::InputContextMessage::encodeProcessKeyEvent(keyType, keyCode, modifiers,
+                                                                                  text, autoRepeat, count,
+                                                                                  nativeScanCode, nativeModifiers,
+                                                                                  time));
+            mRepeatedKey = key;
+            mKeyRepeatReleases = releases;
+            mKeyRepeatRun = true;
+            mKeyRepeatTimer.start();
+            return;
+        }
+    }
+
+    flushKeyRepeats();
+
+    // No struct traversal on either side
+    sendPackedKeyEvent(Maliit::InputContextMessage::encodeProcessKeyEvent(keyType, keyCode, modifiers,
+                                                                          text, autoRepeat, count,
+                                                                          nativeScanCode, nativeModifiers,
+                                                                          time));
+}
+
+bool DBusServerConnection::HeldKey::isSameKey(const HeldKey &other) const
+{
+    return keyCode == other.keyCode && modifiers == other.modifiers && text == other.text
+        && nativeScanCode == other.nativeScanCode && nativeModifiers == other.nativeModifiers;
+}
+
+bool DBusServerConnection::coalesceKeyRepeat(QEvent::Type keyType, const HeldKey &key)
+{
+    // Autorepeats come as release and press pairs, or as presses only with
+    // detectable autorepeat. Only presses continuing the run of the same key
+    // and pattern are coalesced, releases wait for the press after them.
+    if (keyType == QEvent::KeyRelease) {
+        if (mReleaseHeld || (mKeyRepeatRun && !mRepeatedKey.isSameKey(key)))
+            return false;
+
+        mHeldRelease = key;
+        mReleaseHeld = true;
+    } else if (keyType == QEvent::KeyPress) {
+        if (!mKeyRepeatRun || !mRepeatedKey.isSameKey(key) || mKeyRepeatReleases != mReleaseHeld
+            || (mReleaseHeld && !mHeldRelease.isSameKey(key)))
+            return false;
+
+        mRepeatedKey = key;
+        ++mKeyRepeats;
+        mReleaseHeld = false;
+    } else {
+        return false;
+    }
+
+    if (!mKeyRepeatTimer.isActive())
+        mKeyRepeatTimer.start();
+    return true;
+}
+
+void DBusServerConnection::flushKeyRepeats()
+{
+    mKeyRepeatTimer.stop();
+    mKeyRepeatRun = false;
+
+    if (mKeyRepeats > 0) {
+        sendPackedKeyEvent(Maliit::InputContextMessage::encodeProcessKeyRepeat(mRepeatedKey.keyCode, mRepeatedKey.modifiers,
+                                                                               mRepeatedKey.text, mKeyRepeats,
+                                                                               mKeyRepeatReleases,
+                                                                               mRepeatedKey.nativeScanCode,
+                                                                               mRepeatedKey.nativeModifiers,
+                                                                               mRepeatedKey.time));
+        mKeyRepeats = 0;
+    }
+
+    if (mReleaseHeld) {
+        sendPackedKeyEvent(Maliit::InputContextMessage::encodeProcessKeyEvent(QEvent::KeyRelease, mHeldRelease.keyCode,
+                                                                              mHeldRelease.modifiers, mHeldRelease.text,
+                                                                              true, 1, mHeldRelease.nativeScanCode,
+                                                                              mHeldRelease.nativeModifiers,
+                                                                              mHeldRelease.time));
+        mReleaseHeld = false;
+    }
+}
+
+void DBusServerConnection::keyRepeatTimeout()
+{
+    // The next iteration starts a new run with a press sent right away
+    flushKeyRepeats();
+}
+
+void DBusServerConnection::sendPackedKeyEvent(const QByteArray &event)
+{
+    if (mSequencedProxy) {
+        mSequencedProxy->processPackedKeyEvent(nextSequence(), event);
+    }
 }
 
 void DBusServerConnection::registerAttributeExtension(int id, const QString &fileName)
@@ -229,7 +781,13 @@ void DBusServerConnection::registerAttributeExtension(int id, const QString &fil
     if (!mProxy)
         return;
 
-    mProxy->registerAttributeExtension(id, fileName);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->registerAttributeExtension(nextSequence(), id, fileName);
+    } else {
+        mProxy->registerAttributeExtension(id, fileName);
+    }
 }
 
 void DBusServerConnection::unregisterAttributeExtension(int id)
@@ -237,7 +795,13 @@ void DBusServerConnection::unregisterAttributeExtension(int id)
     if (!mProxy)
         return;
 
-    mProxy->unregisterAttributeExtension(id);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->unregisterAttributeExtension(nextSequence(), id);
+    } else {
+        mProxy->unregisterAttributeExtension(id);
+    }
 }
 
 void DBusServerConnection::setExtendedAttribute(int id, const QString &target, const QString &targetItem,
@@ -246,7 +810,13 @@ void DBusServerConnection::setExtendedAttribute(int id, const QString &target, c
     if (!mProxy)
         return;
 
-    mProxy->setExtendedAttribute(id, target, targetItem, attribute, QDBusVariant(value));
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->setExtendedAttribute(nextSequence(), id, target, targetItem, attribute, QDBusVariant(value));
+    } else {
+        mProxy->setExtendedAttribute(id, target, targetItem, attribute, QDBusVariant(value));
+    }
 }
 
 void DBusServerConnection::loadPluginSettings(const QString &descriptionLanguage)
@@ -254,7 +824,26 @@ void DBusServerConnection::loadPluginSettings(const QString &descriptionLanguage
     if (!mProxy)
         return;
 
-    mProxy->loadPluginSettings(descriptionLanguage);
+    flushKeyRepeats();
+
+    if (mSequencedProxy) {
+        mSequencedProxy->loadPluginSettings(nextSequence(), descriptionLanguage);
+    } else {
+        mProxy->loadPluginSettings(descriptionLanguage);
+    }
+}
+
+void DBusServerConnection::requestFullPreedit()
+{
+    if (!mProxy)
+        return;
+
+    flushKeyRepeats();
+
+    // A version 1 server never sends deltas
+    if (mSequencedProxy) {
+        mSequencedProxy->resyncPreedit(nextSequence());
+    }
 }
 
 
@@ -294,7 +883,127 @@ bool DBusServerConnection::selection(QString &selection) const
     return valid;
 }
 
+bool DBusServerConnection::surroundingText(int start, int length, QString &text) const
+{
+    bool valid = false;
+    getSurroundingText(start, length, text, valid);
+    return valid;
+}
+
 void DBusServerConnection::updateInputMethodArea(int x, int y, int width, int height)
 {
     updateInputMethodArea(QRect(x, y, width, height));
 }
+
+void DBusServerConnection::activationLostEvent(uint sequence)
+{
+    checkSequence(sequence);
+    activationLostEvent();
+}
+
+void DBusServerConnection::imInitiatedHide(uint sequence)
+{
+    checkSequence(sequence);
+    imInitiatedHide();
+}
+
+void DBusServerConnection::commitString(uint sequence, uint resetEpoch, const QString &string,
+                                        int replacementStart, int replacementLength, int cursorPos)
+{
+    checkSequence(sequence);
+    if (!isCurrentResetEpoch(resetEpoch)) {
+        // Sent before the server handled the last reset. Still counted, see SharedMemoryLane.
+        controlMessageReceived();
+        return;
+    }
+    commitString(string, replacementStart, replacementLength, cursorPos);
+}
+
+void DBusServerConnection::updatePreedit(uint sequence, uint resetEpoch, const QString &string,
+                                         const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                         int replacementStart, int replacementLength, int cursorPos)
+{
+    checkSequence(sequence);
+    // Preedit deltas on the shared memory lane or in batches may follow
+    setPreeditBase(string, preeditFormats);
+    if (!isCurrentResetEpoch(resetEpoch)) {
+        controlMessageReceived();
+        return;
+    }
+    updatePreedit(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+}
+
+void DBusServerConnection::keyEvent(uint sequence, int type, int key, int modifiers, const QString &text,
+                                    bool autoRepeat, int count, uchar requestType)
+{
+    checkSequence(sequence);
+    keyEvent(type, key, modifiers, text, autoRepeat, count, static_cast<Maliit::EventRequestType>(requestType));
+}
+
+void DBusServerConnection::updateInputMethodArea(uint sequence, int x, int y, int width, int height)
+{
+    checkSequence(sequence);
+    updateInputMethodArea(QRect(x, y, width, height));
+}
+
+void DBusServerConnection::setGlobalCorrectionEnabled(uint sequence, bool enabled)
+{
+    checkSequence(sequence);
+    setGlobalCorrectionEnabled(enabled);
+}
+
+void DBusServerConnection::setRedirectKeys(uint sequence, bool enabled)
+{
+    checkSequence(sequence);
+    setRedirectKeys(enabled);
+}
+
+void DBusServerConnection::setDetectableAutoRepeat(uint sequence, bool enabled)
+{
+    checkSequence(sequence);
+    setDetectableAutoRepeat(enabled);
+}
+
+void DBusServerConnection::setSelection(uint sequence, int start, int length)
+{
+    checkSequence(sequence);
+    setSelection(start, length);
+}
+
+void DBusServerConnection::setSurroundingTextWindow(uint sequence, int characters)
+{
+    checkSequence(sequence);
+    setSurroundingTextWindow(characters);
+}
+
+void DBusServerConnection::setLanguage(uint sequence, const QString &language)
+{
+    checkSequence(sequence);
+    setLanguage(language);
+}
+
+void DBusServerConnection::notifyExtendedAttributeChanged(uint sequence, int id, const QString &target,
+                                                          const QString &targetItem, const QString &attribute,
+                                                          const QDBusVariant &value)
+{
+    checkSequence(sequence);
+    extendedAttributeChanged(id, target, targetItem, attribute, value.variant());
+}
+
+void DBusServerConnection::pluginSettingsLoaded(uint sequence, const QList<MImPluginSettingsInfo> &info)
+{
+    checkSequence(sequence);
+    pluginSettingsReceived(info);
+}
+
+void DBusServerConnection::resyncWidgetInformation(uint sequence)
+{
+    checkSequence(sequence);
+    resyncWidgetInformation();
+}
+
+void DBusServerConnection::applyBatch(uint sequence, const QByteArray &messages)
+{
+    checkSequence(sequence);
+    applyBatch(messages);
+}
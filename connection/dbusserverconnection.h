@@ -23,10 +23,15 @@
 #include <QDBusPendingCallWatcher>
 
 class ComMeegoInputmethodUiserver1Interface;
+class ComMeegoInputmethodUiserver2Interface;
+class QDBusUnixFileDescriptor;
+class QSocketNotifier;
+class SharedMemoryLane;
 
 class DBusServerConnection : public MImServerConnection
 {
     Q_OBJECT
+    friend class Ut_UnixSocketConnection;
 
 public:
     explicit DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address);
@@ -54,6 +59,7 @@ public:
     virtual void setExtendedAttribute(int id, const QString &target, const QString &targetItem,
                                       const QString &attribute, const QVariant &value);
     virtual void loadPluginSettings(const QString &descriptionLanguage);
+    virtual void requestFullPreedit();
     //! reimpl end
 
     //! forwarding methods for InputContextAdaptor
@@ -70,22 +76,132 @@ public:
 
     bool preeditRectangle(int &x, int &y, int &width, int &height) const;
     bool selection(QString &selection) const;
+    bool surroundingText(int start, int length, QString &text) const;
 
     using MImServerConnection::updateInputMethodArea;
     void updateInputMethodArea(int x, int y, int width, int height);
 
+    //! Sends the full widget state again, requested by the server when a delta could not be applied
+    void resyncWidgetInformation();
+
+    //! Attaches to the shared memory lane offered by the server
+    bool setFastLane(const QDBusUnixFileDescriptor &memory, const QDBusUnixFileDescriptor &doorbell,
+                     uint capacity);
+
+    //! Handles commit, preedit and key events the server sent together
+    void applyBatch(const QByteArray &messages);
+
+    //! Sequenced variants from com.meego.inputmethod.inputcontext2, see negotiateVersion()
+    using MImServerConnection::activationLostEvent;
+    using MImServerConnection::imInitiatedHide;
+    using MImServerConnection::commitString;
+    using MImServerConnection::updatePreedit;
+    using MImServerConnection::setGlobalCorrectionEnabled;
+    using MImServerConnection::setRedirectKeys;
+    using MImServerConnection::setDetectableAutoRepeat;
+    using MImServerConnection::setSelection;
+    using MImServerConnection::setLanguage;
+    using MImServerConnection::setSurroundingTextWindow;
+    void activationLostEvent(uint sequence);
+    void imInitiatedHide(uint sequence);
+    void commitString(uint sequence, uint resetEpoch, const QString &string, int replacementStart,
+                      int replacementLength, int cursorPos);
+    void updatePreedit(uint sequence, uint resetEpoch, const QString &string,
+                       const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                       int replacementStart, int replacementLength, int cursorPos);
+    void keyEvent(uint sequence, int type, int key, int modifiers, const QString &text, bool autoRepeat,
+                  int count, uchar requestType);
+    void updateInputMethodArea(uint sequence, int x, int y, int width, int height);
+    void setGlobalCorrectionEnabled(uint sequence, bool enabled);
+    void setRedirectKeys(uint sequence, bool enabled);
+    void setDetectableAutoRepeat(uint sequence, bool enabled);
+    void setSelection(uint sequence, int start, int length);
+    void setLanguage(uint sequence, const QString &language);
+    void setSurroundingTextWindow(uint sequence, int characters);
+    void notifyExtendedAttributeChanged(uint sequence, int id, const QString &target,
+                                        const QString &targetItem, const QString &attribute,
+                                        const QDBusVariant &value);
+    void pluginSettingsLoaded(uint sequence, const QList<MImPluginSettingsInfo> &info);
+    void resyncWidgetInformation(uint sequence);
+    void applyBatch(uint sequence, const QByteArray &messages);
+
 private Q_SLOTS:
     void connectToDBus();
     void openDBusConnection(const QString &addressString);
     void connectToDBusFailed(const QString &errorMessage);
     void onDisconnection();
+    void onServerAvailable();
     void resetCallFinished(QDBusPendingCallWatcher*);
+    void deltaCallFinished(QDBusPendingCallWatcher*);
+    void versionNegotiated(QDBusPendingCallWatcher*);
+    void controlMessageReceived();
+    void fastLaneDoorbell();
+    void drainFastLane();
+    void keyRepeatTimeout();
 
 private:
+    enum DeltaSupport {
+        DeltaSupportUnknown,
+        DeltaSupported,
+        DeltaUnsupported
+    };
+
+    //! An autorepeat key event kept back for coalescing
+    struct HeldKey {
+        Qt::Key keyCode;
+        Qt::KeyboardModifiers modifiers;
+        QString text;
+        quint32 nativeScanCode;
+        quint32 nativeModifiers;
+        unsigned long time;
+
+        bool isSameKey(const HeldKey &other) const;
+    };
+
+    void sendFullWidgetInformation(bool focusChanged);
+    //! Tries connecting again later, waiting longer each time until a connection succeeds
+    void scheduleReconnect();
+    //! Returns the next sequence number for a call to the server, see negotiateVersion()
+    uint nextSequence();
+    //! Detects lost or reordered calls from the server
+    void checkSequence(uint sequence);
+    void closeFastLane();
+    //! Keeps back an autorepeat key event, returns false if it has to be sent now
+    bool coalesceKeyRepeat(QEvent::Type keyType, const HeldKey &key);
+    //! Sends the autorepeats kept back so far and ends the run. Other calls to the
+    //! server have to do this first, so they reach it after the key events before them.
+    void flushKeyRepeats();
+    void sendPackedKeyEvent(const QByteArray &event);
+
     QSharedPointer<Maliit::InputContext::DBus::Address> mAddress;
+    QTimer mReconnectTimer;
+    int mReconnectInterval; // in ms, see scheduleReconnect()
     ComMeegoInputmethodUiserver1Interface *mProxy;
+    //! Set once the server agreed to use protocol version 2
+    ComMeegoInputmethodUiserver2Interface *mSequencedProxy;
+    uint mOutgoingSequence;
+    uint mIncomingSequence;
     bool mActive;
     QSet<QDBusPendingCallWatcher*> pendingResetCalls;
+
+    QMap<QString, QVariant> mLastWidgetState;
+    unsigned int mWidgetStateVersion; // 0 means the next update has to be a full one
+    DeltaSupport mDeltaSupport;
+
+    SharedMemoryLane *mFastLane;
+    QSocketNotifier *mFastLaneNotifier;
+    bool mDrainingFastLane;
+    bool mApplyingBatch;
+    //! Number of D-Bus messages received from the server, see SharedMemoryLane
+    quint32 mControlMessagesReceived;
+
+    QTimer mKeyRepeatTimer;
+    HeldKey mRepeatedKey;
+    bool mKeyRepeatRun; // the first autorepeat press of mRepeatedKey was sent in this iteration
+    int mKeyRepeats; // autorepeat presses of mRepeatedKey after the first, not sent yet
+    bool mKeyRepeatReleases; // each of them preceded by an autorepeat release
+    HeldKey mHeldRelease;
+    bool mReleaseHeld; // an autorepeat release waits for its press
 };
 
 #endif // DBUSSERVERCONNECTION_H
@@ -18,6 +18,8 @@
 #include <QDBusMessage>
 #include <QDBusVariant>
 #include <QDBusError>
+#include <QDBusServiceWatcher>
+#include <QFile>
 
 namespace {
     const char * const MaliitServerName = "org.maliit.server";
@@ -27,6 +29,23 @@ namespace {
 
     const char * const DBusPropertiesInterface = "org.freedesktop.DBus.Properties";
     const char * const DBusPropertiesGetMethod = "Get";
+
+    // Written by Maliit::Server::DBus::AddressPublisher, relative to $XDG_RUNTIME_DIR
+    const char * const AddressFilePath = "/maliit-server-dbus-address";
+
+    QString readAddressFile()
+    {
+        const QByteArray runtimeDirectory = qgetenv("XDG_RUNTIME_DIR");
+        if (runtimeDirectory.isEmpty()) {
+            return QString();
+        }
+
+        QFile file(QString::fromLocal8Bit(runtimeDirectory) + QLatin1String(AddressFilePath));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QString();
+        }
+        return QString::fromUtf8(file.readAll());
+    }
 }
 
 namespace Maliit {
@@ -41,8 +60,35 @@ Address::~Address()
 {
 }
 
+bool Address::addressFailed(const QString &address)
+{
+    Q_UNUSED(address);
+    return false;
+}
+
+DynamicAddress::DynamicAddress()
+    : mFileAddress()
+    , mStaleAddress()
+{
+    // The server (re)publishes its address when it takes the name, for example
+    // after a crash or an upgrade
+    QDBusServiceWatcher *watcher = new QDBusServiceWatcher(QString::fromLatin1(MaliitServerName),
+                                                           QDBusConnection::sessionBus(),
+                                                           QDBusServiceWatcher::WatchForRegistration,
+                                                           this);
+    connect(watcher, SIGNAL(serviceRegistered(QString)),
+            this, SIGNAL(serverAvailable()));
+}
+
 void DynamicAddress::get()
 {
+    const QString fileAddress = readAddressFile();
+    if (!fileAddress.isEmpty() && fileAddress != mStaleAddress) {
+        mFileAddress = fileAddress;
+        Q_EMIT addressReceived(fileAddress);
+        return;
+    }
+
     QList<QVariant> arguments;
     arguments.push_back(QVariant(QString::fromLatin1(MaliitServerInterface)));
     arguments.push_back(QVariant(QString::fromLatin1(MaliitServerAddressProperty)));
@@ -56,6 +102,16 @@ void DynamicAddress::get()
                                                    SLOT(errorCallback(QDBusError)));
 }
 
+bool DynamicAddress::addressFailed(const QString &address)
+{
+    // Left behind by a server which is gone, the session bus knows better
+    if (address == mFileAddress && address != mStaleAddress) {
+        mStaleAddress = address;
+        return true;
+    }
+    return false;
+}
+
 void DynamicAddress::successCallback(const QDBusVariant &address)
 {
     Q_EMIT addressReceived(address.variant().toString());
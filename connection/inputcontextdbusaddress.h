@@ -34,22 +34,44 @@ public:
 
     virtual void get() = 0;
 
+    //! Called when \a address from addressReceived() could not be connected to.
+    //! Returns true if get() may right away come up with a different address.
+    virtual bool addressFailed(const QString &address);
+
 Q_SIGNALS:
     void addressReceived(const QString &address);
     void addressFetchError(const QString &errorMessage);
+
+    //! Emitted when a server appeared, so that get() should be tried right away
+    void serverAvailable();
 };
 
 
+/*!
+ * \brief Address published by the running server.
+ *
+ * Read from the address file the server keeps in $XDG_RUNTIME_DIR, which
+ * saves a round trip to the session bus. The session bus is only asked
+ * when there is no file or the address in it turned out to be stale.
+ */
 class DynamicAddress : public Address
 {
     Q_OBJECT
 
 public:
+    DynamicAddress();
     void get();
+    bool addressFailed(const QString &address);
 
 private Q_SLOTS:
     void successCallback(const QDBusVariant &address);
     void errorCallback(const QDBusError &error);
+
+private:
+    //! Last address read from the address file
+    QString mFileAddress;
+    //! Address from the address file which could not be connected to
+    QString mStaleAddress;
 };
 
 class FixedAddress : public Address
@@ -0,0 +1,371 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "inputcontextmessages.h"
+#include "mimserverconnection.h"
+#include "minputcontextconnection.h"
+
+#include <QDataStream>
+
+namespace Maliit {
+namespace InputContextMessage {
+
+namespace {
+    const QDataStream::Version StreamVersion = QDataStream::Qt_5_0;
+
+    // Unchanged characters below which UpdatePreeditDelta is not worth it
+    const int MinimumUnchangedPreeditLength = 8;
+
+    void initStream(QDataStream &stream)
+    {
+        stream.setVersion(StreamVersion);
+    }
+
+    bool sameFormat(const Maliit::PreeditTextFormat &a, const Maliit::PreeditTextFormat &b)
+    {
+        return a.start == b.start && a.length == b.length && a.preeditFace == b.preeditFace;
+    }
+
+    void writeFormats(QDataStream &stream, const QList<Maliit::PreeditTextFormat> &formats, int first)
+    {
+        stream << quint32(formats.size() - first);
+        for (int i = first; i < formats.size(); ++i) {
+            const Maliit::PreeditTextFormat &format = formats.at(i);
+            stream << qint32(format.start) << qint32(format.length) << qint32(format.preeditFace);
+        }
+    }
+
+    void readFormats(QDataStream &stream, QList<Maliit::PreeditTextFormat> *formats)
+    {
+        quint32 formatCount;
+        stream >> formatCount;
+        for (quint32 i = 0; i < formatCount && stream.status() == QDataStream::Ok; ++i) {
+            qint32 start, length, face;
+            stream >> start >> length >> face;
+            formats->append(Maliit::PreeditTextFormat(start, length,
+                                                      static_cast<Maliit::PreeditFace>(face)));
+        }
+    }
+
+    //! Reads the reset epoch ending a message. Messages without one count as current.
+    quint32 readResetEpoch(QDataStream &stream, MImServerConnection *connection)
+    {
+        quint32 resetEpoch = connection->resetEpoch();
+        if (stream.status() == QDataStream::Ok && !stream.atEnd()) {
+            stream >> resetEpoch;
+        }
+        return resetEpoch;
+    }
+}
+
+QByteArray encodeCommitString(const QString &string, int replacementStart,
+                              int replacementLength, int cursorPos, quint32 resetEpoch)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(CommitString) << string
+           << qint32(replacementStart) << qint32(replacementLength) << qint32(cursorPos)
+           << resetEpoch;
+
+    return message;
+}
+
+QByteArray encodeUpdatePreedit(const QString &string,
+                               const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                               int replacementStart, int replacementLength, int cursorPos,
+                               quint32 resetEpoch)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(UpdatePreedit) << string;
+    writeFormats(stream, preeditFormats, 0);
+    stream << qint32(replacementStart) << qint32(replacementLength) << qint32(cursorPos)
+           << resetEpoch;
+
+    return message;
+}
+
+QByteArray encodeUpdatePreedit(PreeditBase *base, const QString &string,
+                               const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                               int replacementStart, int replacementLength, int cursorPos,
+                               quint32 resetEpoch)
+{
+    const QString &oldString = base->string;
+    const int shorter = qMin(oldString.size(), string.size());
+
+    int prefix = 0;
+    while (prefix < shorter && oldString.at(prefix) == string.at(prefix)) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < shorter - prefix
+           && oldString.at(oldString.size() - 1 - suffix) == string.at(string.size() - 1 - suffix)) {
+        ++suffix;
+    }
+
+    if (prefix + suffix < MinimumUnchangedPreeditLength) {
+        base->string = string;
+        base->formats = preeditFormats;
+        return encodeUpdatePreedit(string, preeditFormats, replacementStart, replacementLength,
+                                   cursorPos, resetEpoch);
+    }
+
+    // Formats usually only change behind the edited part
+    int keptFormats = 0;
+    while (keptFormats < qMin(base->formats.size(), preeditFormats.size())
+           && sameFormat(base->formats.at(keptFormats), preeditFormats.at(keptFormats))) {
+        ++keptFormats;
+    }
+
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(UpdatePreeditDelta) << qint32(prefix) << qint32(oldString.size() - prefix - suffix)
+           << string.mid(prefix, string.size() - prefix - suffix) << quint32(keptFormats);
+    writeFormats(stream, preeditFormats, keptFormats);
+    stream << qint32(replacementStart) << qint32(replacementLength) << qint32(cursorPos)
+           << resetEpoch;
+
+    base->string = string;
+    base->formats = preeditFormats;
+    return message;
+}
+
+QByteArray encodeKeyEvent(int type, int key, int modifiers, const QString &text,
+                          bool autoRepeat, int count, Maliit::EventRequestType requestType)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(KeyEvent) << qint32(type) << qint32(key) << qint32(modifiers) << text
+           << autoRepeat << qint32(count) << quint8(requestType);
+
+    return message;
+}
+
+QByteArray encodeProcessKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                 Qt::KeyboardModifiers modifiers, const QString &text,
+                                 bool autoRepeat, int count, quint32 nativeScanCode,
+                                 quint32 nativeModifiers, unsigned long time)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(ProcessKeyEvent) << qint32(keyType) << qint32(keyCode) << qint32(modifiers)
+           << text << autoRepeat << qint32(count) << nativeScanCode << nativeModifiers
+           << quint32(time);
+
+    return message;
+}
+
+QByteArray encodeProcessKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                                  const QString &text, int repeats, bool releases,
+                                  quint32 nativeScanCode, quint32 nativeModifiers,
+                                  unsigned long time)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(ProcessKeyRepeat) << qint32(keyCode) << qint32(modifiers) << text
+           << qint32(repeats) << releases << nativeScanCode << nativeModifiers << quint32(time);
+
+    return message;
+}
+
+QByteArray encodeBatch(const QList<QByteArray> &messages)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    initStream(stream);
+
+    stream << quint8(Batch) << quint32(messages.size());
+    Q_FOREACH (const QByteArray &batched, messages) {
+        stream << batched;
+    }
+
+    return message;
+}
+
+bool dispatch(const QByteArray &message, MImServerConnection *connection)
+{
+    QDataStream stream(message);
+    initStream(stream);
+
+    quint8 type;
+    stream >> type;
+
+    switch (type) {
+    case Batch: {
+        quint32 count;
+        stream >> count;
+
+        for (quint32 i = 0; i < count; ++i) {
+            QByteArray batched;
+            stream >> batched;
+            // batches are never nested
+            if (stream.status() != QDataStream::Ok
+                || batched.isEmpty() || quint8(batched.at(0)) == Batch
+                || !dispatch(batched, connection)) {
+                return false;
+            }
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    case CommitString: {
+        QString string;
+        qint32 replacementStart, replacementLength, cursorPos;
+        stream >> string >> replacementStart >> replacementLength >> cursorPos;
+        const quint32 resetEpoch = readResetEpoch(stream, connection);
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        if (!connection->isCurrentResetEpoch(resetEpoch))
+            return true;
+
+        Q_EMIT connection->commitString(string, replacementStart, replacementLength, cursorPos);
+        return true;
+    }
+
+    case UpdatePreedit: {
+        QString string;
+        stream >> string;
+
+        QList<Maliit::PreeditTextFormat> preeditFormats;
+        readFormats(stream, &preeditFormats);
+
+        qint32 replacementStart, replacementLength, cursorPos;
+        stream >> replacementStart >> replacementLength >> cursorPos;
+        const quint32 resetEpoch = readResetEpoch(stream, connection);
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        connection->setPreeditBase(string, preeditFormats);
+        if (!connection->isCurrentResetEpoch(resetEpoch))
+            return true;
+
+        Q_EMIT connection->updatePreedit(string, preeditFormats,
+                                         replacementStart, replacementLength, cursorPos);
+        return true;
+    }
+
+    case UpdatePreeditDelta: {
+        // Relative to a preedit which was lost, the full one asked for replaces it
+        if (!connection->hasPreeditBase())
+            return true;
+
+        qint32 start, removedLength;
+        QString inserted;
+        quint32 keptFormats;
+        stream >> start >> removedLength >> inserted >> keptFormats;
+
+        const PreeditBase &base = connection->preeditBase();
+        if (stream.status() != QDataStream::Ok
+            || start < 0 || removedLength < 0 || start > base.string.size() - removedLength
+            || keptFormats > quint32(base.formats.size())) {
+            return false;
+        }
+
+        QList<Maliit::PreeditTextFormat> preeditFormats = base.formats.mid(0, keptFormats);
+        readFormats(stream, &preeditFormats);
+
+        qint32 replacementStart, replacementLength, cursorPos;
+        stream >> replacementStart >> replacementLength >> cursorPos;
+        const quint32 resetEpoch = readResetEpoch(stream, connection);
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        const QString string = QString(base.string).replace(start, removedLength, inserted);
+        connection->setPreeditBase(string, preeditFormats);
+        if (!connection->isCurrentResetEpoch(resetEpoch))
+            return true;
+
+        Q_EMIT connection->updatePreedit(string, preeditFormats,
+                                         replacementStart, replacementLength, cursorPos);
+        return true;
+    }
+
+    case KeyEvent: {
+        qint32 keyType, key, modifiers, count;
+        QString text;
+        bool autoRepeat;
+        quint8 requestType;
+        stream >> keyType >> key >> modifiers >> text >> autoRepeat >> count >> requestType;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        Q_EMIT connection->keyEvent(keyType, key, modifiers, text, autoRepeat, count,
+                                    static_cast<Maliit::EventRequestType>(requestType));
+        return true;
+    }
+    }
+
+    return false;
+}
+
+bool dispatch(const QByteArray &message, MInputContextConnection *connection, unsigned int clientId)
+{
+    QDataStream stream(message);
+    initStream(stream);
+
+    quint8 type;
+    stream >> type;
+
+    switch (type) {
+    case ProcessKeyEvent: {
+        qint32 keyType, keyCode, modifiers, count;
+        QString text;
+        bool autoRepeat;
+        quint32 nativeScanCode, nativeModifiers, time;
+        stream >> keyType >> keyCode >> modifiers >> text >> autoRepeat >> count
+               >> nativeScanCode >> nativeModifiers >> time;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        connection->processKeyEvent(clientId, static_cast<QEvent::Type>(keyType),
+                                    static_cast<Qt::Key>(keyCode),
+                                    static_cast<Qt::KeyboardModifiers>(modifiers),
+                                    text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+        return true;
+    }
+
+    case ProcessKeyRepeat: {
+        qint32 keyCode, modifiers, repeats;
+        QString text;
+        bool releases;
+        quint32 nativeScanCode, nativeModifiers, time;
+        stream >> keyCode >> modifiers >> text >> repeats >> releases
+               >> nativeScanCode >> nativeModifiers >> time;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        connection->processKeyRepeat(clientId, static_cast<Qt::Key>(keyCode),
+                                     static_cast<Qt::KeyboardModifiers>(modifiers),
+                                     text, repeats, releases, nativeScanCode, nativeModifiers, time);
+        return true;
+    }
+    }
+
+    return false;
+}
+
+} // namespace InputContextMessage
+} // namespace Maliit
@@ -0,0 +1,115 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef INPUTCONTEXTMESSAGES_H
+#define INPUTCONTEXTMESSAGES_H
+
+#include <maliit/namespace.h>
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QEvent>
+
+class MImServerConnection;
+class MInputContextConnection;
+
+namespace Maliit {
+namespace InputContextMessage {
+
+/*! \internal
+ * \brief Compact binary encoding of the latency critical calls.
+ *
+ * Used where those calls bypass D-Bus marshalling. The encoding is private
+ * to the framework; both sides are always built from the same sources.
+ * ProcessKeyEvent and ProcessKeyRepeat go from the application to the
+ * server, the other types from the server to the application.
+ *
+ * CommitString, UpdatePreedit and UpdatePreeditDelta end with the reset
+ * epoch of the application, see MImServerConnection::startResetEpoch().
+ * Messages from the current epoch or without one are emitted, others are
+ * dropped.
+ *
+ * UpdatePreeditDelta only carries what changed since the previous
+ * UpdatePreedit or UpdatePreeditDelta message, see PreeditBase. After a
+ * message it could not handle, the application drops deltas and asks the
+ * server to send the next preedit as UpdatePreedit.
+ */
+enum Type {
+    CommitString = 1,
+    UpdatePreedit = 2,
+    KeyEvent = 3,
+    Batch = 4,
+    ProcessKeyEvent = 5,
+    ProcessKeyRepeat = 6,
+    UpdatePreeditDelta = 7
+};
+
+/*! \internal
+ * \brief Preedit an UpdatePreeditDelta message is relative to.
+ *
+ * Both sides keep one per application: the server for the preedit it sent
+ * last, the application for the preedit it received last, whether the
+ * message was emitted or dropped for its reset epoch.
+ */
+struct PreeditBase
+{
+    QString string;
+    QList<Maliit::PreeditTextFormat> formats;
+};
+
+QByteArray encodeCommitString(const QString &string, int replacementStart,
+                              int replacementLength, int cursorPos, quint32 resetEpoch = 0);
+
+QByteArray encodeUpdatePreedit(const QString &string,
+                               const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                               int replacementStart, int replacementLength, int cursorPos,
+                               quint32 resetEpoch = 0);
+
+//! Encodes the preedit as UpdatePreeditDelta to \a base where that saves enough,
+//! otherwise as UpdatePreedit. The preedit becomes the new \a base.
+QByteArray encodeUpdatePreedit(PreeditBase *base, const QString &string,
+                               const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                               int replacementStart, int replacementLength, int cursorPos,
+                               quint32 resetEpoch);
+
+QByteArray encodeKeyEvent(int type, int key, int modifiers, const QString &text,
+                          bool autoRepeat, int count, Maliit::EventRequestType requestType);
+
+//! Packs several encoded messages into one, dispatched in the same order.
+QByteArray encodeBatch(const QList<QByteArray> &messages);
+
+QByteArray encodeProcessKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                 Qt::KeyboardModifiers modifiers, const QString &text,
+                                 bool autoRepeat, int count, quint32 nativeScanCode,
+                                 quint32 nativeModifiers, unsigned long time);
+
+//! Encodes \a repeats coalesced autorepeats, see MInputContextConnection::processKeyRepeat().
+QByteArray encodeProcessKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                                  const QString &text, int repeats, bool releases,
+                                  quint32 nativeScanCode, quint32 nativeModifiers,
+                                  unsigned long time);
+
+//! Decodes \a message and emits the matching signal of \a connection, unless it
+//! belongs to an old reset epoch. Returns false if \a message could not be decoded,
+//! callers have to discard the preedit base then, see MImServerConnection::discardPreeditBase().
+bool dispatch(const QByteArray &message, MImServerConnection *connection);
+
+//! Decodes \a message sent by the application \a clientId and passes it to \a connection.
+//! Returns false if \a message could not be decoded.
+bool dispatch(const QByteArray &message, MInputContextConnection *connection, unsigned int clientId);
+
+} // namespace InputContextMessage
+} // namespace Maliit
+
+#endif // INPUTCONTEXTMESSAGES_H
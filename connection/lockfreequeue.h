@@ -0,0 +1,92 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <QAtomicPointer>
+
+/*! \internal
+ * \brief Unbounded queue handing values from one thread to another without locking.
+ *
+ * One thread enqueues and one other thread dequeues. Values are kept in a
+ * linked list: the producer links new nodes after the tail, the consumer
+ * frees the nodes it has moved past. Neither side ever waits for the other.
+ */
+template <typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue()
+        : mHead(new Node)
+        , mTail(mHead)
+    {}
+
+    ~LockFreeQueue()
+    {
+        while (mHead) {
+            Node *next = mHead->next.load();
+            delete mHead;
+            mHead = next;
+        }
+    }
+
+    //! Appends \a value. Only to be called from the producer thread.
+    void enqueue(const T &value)
+    {
+        Node *node = new Node;
+        node->value = value;
+        // Makes the value visible to the consumer together with the node
+        mTail->next.storeRelease(node);
+        mTail = node;
+    }
+
+    //! Moves the oldest value into \a value, returns false if the queue is empty.
+    //! Only to be called from the consumer thread.
+    bool dequeue(T *value)
+    {
+        Node *next = mHead->next.loadAcquire();
+        if (!next) {
+            return false;
+        }
+
+        *value = next->value;
+        // next becomes the placeholder in front of the queue, its value is not needed anymore
+        next->value = T();
+        delete mHead;
+        mHead = next;
+        return true;
+    }
+
+    //! Only to be called from the consumer thread.
+    bool isEmpty() const
+    {
+        return !mHead->next.loadAcquire();
+    }
+
+private:
+    Q_DISABLE_COPY(LockFreeQueue)
+
+    struct Node
+    {
+        Node() : value(), next(0) {}
+
+        T value;
+        QAtomicPointer<Node> next;
+    };
+
+    Node *mHead; // placeholder in front of the oldest value, used by the consumer only
+    Node *mTail; // newest node, used by the producer only
+};
+
+#endif // LOCKFREEQUEUE_H
@@ -0,0 +1,273 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "loopbackinputcontextconnection.h"
+
+#include "loopbackserverconnection.h"
+
+#include <maliit/settingdata.h>
+
+#include <QKeyEvent>
+
+LoopbackInputContextConnection::LoopbackInputContextConnection(QObject *parent)
+    : MInputContextConnection(parent)
+    , mClients()
+    , mLastClientId(0)
+    , lastLanguage()
+{
+}
+
+LoopbackInputContextConnection::~LoopbackInputContextConnection()
+{
+}
+
+unsigned int
+LoopbackInputContextConnection::attach(LoopbackServerConnection *client)
+{
+    const unsigned int clientId = ++mLastClientId; // starts at 1, 0 is the sentinel value
+    mClients.insert(clientId, client);
+
+    Q_EMIT client->setLanguage(lastLanguage);
+
+    return clientId;
+}
+
+void
+LoopbackInputContextConnection::detach(unsigned int clientId)
+{
+    if (mClients.remove(clientId)) {
+        handleDisconnection(clientId);
+    }
+}
+
+LoopbackServerConnection *
+LoopbackInputContextConnection::activeClient() const
+{
+    return mClients.value(activeConnection);
+}
+
+void
+LoopbackInputContextConnection::sendPreeditString(const QString &string,
+                                                  const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                                  int replacementStart, int replacementLength,
+                                                  int cursorPos)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        MInputContextConnection::sendPreeditString(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+        Q_EMIT client->updatePreedit(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+    }
+}
+
+void
+LoopbackInputContextConnection::sendCommitString(const QString &string, int replaceStart,
+                                                 int replaceLength, int cursorPos)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        MInputContextConnection::sendCommitString(string, replaceStart, replaceLength, cursorPos);
+        Q_EMIT client->commitString(string, replaceStart, replaceLength, cursorPos);
+    }
+}
+
+void
+LoopbackInputContextConnection::sendKeyEvent(const QKeyEvent &keyEvent,
+                                             Maliit::EventRequestType requestType)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        MInputContextConnection::sendKeyEvent(keyEvent, requestType);
+        Q_EMIT client->keyEvent(keyEvent.type(), keyEvent.key(), keyEvent.modifiers(),
+                                keyEvent.text(), keyEvent.isAutoRepeat(), keyEvent.count(),
+                                requestType);
+    }
+}
+
+void
+LoopbackInputContextConnection::notifyImInitiatedHiding()
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->imInitiatedHide();
+    }
+}
+
+void
+LoopbackInputContextConnection::setGlobalCorrectionEnabled(bool enabled)
+{
+    LoopbackServerConnection *client = activeClient();
+    if ((enabled != globalCorrectionEnabled()) && client) {
+        Q_EMIT client->setGlobalCorrectionEnabled(enabled);
+        MInputContextConnection::setGlobalCorrectionEnabled(enabled);
+    }
+}
+
+int
+LoopbackInputContextConnection::requestPreeditRectangle()
+{
+    LoopbackServerConnection *client = activeClient();
+    if (!client) {
+        return MInputContextConnection::requestPreeditRectangle();
+    }
+
+    const int requestId = nextRequestId();
+    QRect rectangle;
+    bool valid = false;
+    Q_EMIT client->getPreeditRectangle(rectangle, valid);
+
+    // the answer is still delivered later, as documented
+    QMetaObject::invokeMethod(this, "preeditRectangleReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QRect, valid ? rectangle : QRect()),
+                              Q_ARG(bool, valid));
+    return requestId;
+}
+
+void
+LoopbackInputContextConnection::setRedirectKeys(bool enabled)
+{
+    LoopbackServerConnection *client = activeClient();
+    if ((enabled != redirectKeysEnabled()) && client) {
+        Q_EMIT client->setRedirectKeys(enabled);
+        MInputContextConnection::setRedirectKeys(enabled);
+    }
+}
+
+void
+LoopbackInputContextConnection::setDetectableAutoRepeat(bool enabled)
+{
+    LoopbackServerConnection *client = activeClient();
+    if ((enabled != detectableAutoRepeat()) && client) {
+        Q_EMIT client->setDetectableAutoRepeat(enabled);
+        MInputContextConnection::setDetectableAutoRepeat(enabled);
+    }
+}
+
+void
+LoopbackInputContextConnection::invokeAction(const QString &action,
+                                             const QKeySequence &sequence)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->invokeAction(action, sequence);
+    }
+}
+
+void
+LoopbackInputContextConnection::setSelection(int start, int length)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->setSelection(start, length);
+    }
+}
+
+int
+LoopbackInputContextConnection::requestSelection()
+{
+    LoopbackServerConnection *client = activeClient();
+    if (!client) {
+        return MInputContextConnection::requestSelection();
+    }
+
+    const int requestId = nextRequestId();
+    QString selection;
+    bool valid = false;
+    Q_EMIT client->getSelection(selection, valid);
+
+    QMetaObject::invokeMethod(this, "selectionReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QString, valid ? selection : QString()),
+                              Q_ARG(bool, valid));
+    return requestId;
+}
+
+void
+LoopbackInputContextConnection::setSurroundingTextWindow(int characters)
+{
+    MInputContextConnection::setSurroundingTextWindow(characters);
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->setSurroundingTextWindow(surroundingTextWindow());
+    }
+}
+
+int
+LoopbackInputContextConnection::requestSurroundingText(int start, int length)
+{
+    LoopbackServerConnection *client = activeClient();
+    if (!client) {
+        return MInputContextConnection::requestSurroundingText(start, length);
+    }
+
+    const int requestId = nextRequestId();
+    QString text;
+    bool valid = false;
+    Q_EMIT client->getSurroundingText(start, length, text, valid);
+
+    QMetaObject::invokeMethod(this, "surroundingTextReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(int, start),
+                              Q_ARG(QString, valid ? text : QString()), Q_ARG(bool, valid));
+    return requestId;
+}
+
+void
+LoopbackInputContextConnection::setLanguage(const QString &language)
+{
+    lastLanguage = language;
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->setLanguage(language);
+    }
+}
+
+void
+LoopbackInputContextConnection::sendActivationLostEvent()
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->activationLostEvent();
+    }
+}
+
+void
+LoopbackInputContextConnection::updateInputMethodArea(const QRegion &region)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->updateInputMethodArea(region.boundingRect());
+    }
+}
+
+void
+LoopbackInputContextConnection::notifyExtendedAttributeChanged(int id,
+                                                               const QString &target,
+                                                               const QString &targetItem,
+                                                               const QString &attribute,
+                                                               const QVariant &value)
+{
+    if (LoopbackServerConnection *client = activeClient()) {
+        Q_EMIT client->extendedAttributeChanged(id, target, targetItem, attribute, value);
+    }
+}
+
+void
+LoopbackInputContextConnection::notifyExtendedAttributeChanged(const QList<int> &clientIds,
+                                                               int id,
+                                                               const QString &target,
+                                                               const QString &targetItem,
+                                                               const QString &attribute,
+                                                               const QVariant &value)
+{
+    Q_FOREACH (int clientId, clientIds) {
+        if (LoopbackServerConnection *client = mClients.value(clientId)) {
+            Q_EMIT client->extendedAttributeChanged(id, target, targetItem, attribute, value);
+        }
+    }
+}
+
+void
+LoopbackInputContextConnection::pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info)
+{
+    if (LoopbackServerConnection *client = mClients.value(clientId)) {
+        Q_EMIT client->pluginSettingsReceived(info);
+    }
+}
@@ -0,0 +1,94 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef LOOPBACKINPUTCONTEXTCONNECTION_H
+#define LOOPBACKINPUTCONTEXTCONNECTION_H
+
+#include "minputcontextconnection.h"
+
+#include <QHash>
+
+class LoopbackServerConnection;
+
+/*! \internal
+ * \brief Input context connection to applications in the same process.
+ *
+ * Used when the input method server runs inside the application. Calls in
+ * both directions are plain function calls, nothing is serialized. The
+ * application side is a LoopbackServerConnection.
+ *
+ * Calls are delivered synchronously, so a handler on either side may be
+ * entered again from within a call it made to the other side.
+ */
+class LoopbackInputContextConnection : public MInputContextConnection
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackInputContextConnection(QObject *parent = 0);
+    ~LoopbackInputContextConnection();
+
+    //! \reimp
+    virtual void sendPreeditString(const QString &string,
+                                   const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                   int replacementStart = 0, int replacementLength = 0,
+                                   int cursorPos = -1);
+    virtual void sendCommitString(const QString &string, int replaceStart = 0,
+                                  int replaceLength = 0, int cursorPos = -1);
+    virtual void sendKeyEvent(const QKeyEvent &keyEvent,
+                              Maliit::EventRequestType requestType);
+    virtual void notifyImInitiatedHiding();
+
+    virtual void setGlobalCorrectionEnabled(bool);
+    virtual int requestPreeditRectangle();
+    virtual void setRedirectKeys(bool enabled);
+    virtual void setDetectableAutoRepeat(bool enabled);
+    virtual void invokeAction(const QString &action,
+                              const QKeySequence &sequence);
+    virtual void setSelection(int start, int length);
+    virtual int requestSelection();
+    virtual void setSurroundingTextWindow(int characters);
+    virtual int requestSurroundingText(int start, int length);
+    virtual void setLanguage(const QString &language);
+    virtual void sendActivationLostEvent();
+    virtual void updateInputMethodArea(const QRegion &region);
+    virtual void notifyExtendedAttributeChanged(int id,
+                                                const QString &target,
+                                                const QString &targetItem,
+                                                const QString &attribute,
+                                                const QVariant &value);
+    virtual void notifyExtendedAttributeChanged(const QList<int> &clientIds,
+                                                int id,
+                                                const QString &target,
+                                                const QString &targetItem,
+                                                const QString &attribute,
+                                                const QVariant &value);
+    virtual void pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info);
+    //! \reimp_end
+
+    //! Registers \a client, returns its connection id. Called by LoopbackServerConnection.
+    unsigned int attach(LoopbackServerConnection *client);
+    //! Forgets the client with \a clientId. Called by LoopbackServerConnection.
+    void detach(unsigned int clientId);
+
+private:
+    LoopbackServerConnection *activeClient() const;
+
+    //! Attached clients, not owned
+    QHash<unsigned int, LoopbackServerConnection *> mClients;
+    unsigned int mLastClientId;
+
+    QString lastLanguage;
+};
+
+#endif // LOOPBACKINPUTCONTEXTCONNECTION_H
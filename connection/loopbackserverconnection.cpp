@@ -0,0 +1,172 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "loopbackserverconnection.h"
+
+#include "loopbackinputcontextconnection.h"
+
+LoopbackServerConnection::LoopbackServerConnection(LoopbackInputContextConnection *server)
+    : MImServerConnection(0)
+    , mServer(server)
+    , mClientId(0)
+{
+    // connected() has to be emitted from the mainloop
+    QTimer::singleShot(0, this, SLOT(connectToServer()));
+}
+
+LoopbackServerConnection::~LoopbackServerConnection()
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->detach(mClientId);
+    }
+}
+
+void LoopbackServerConnection::connectToServer()
+{
+    if (!mServer || mClientId) {
+        return;
+    }
+
+    connect(mServer.data(), SIGNAL(destroyed()), this, SLOT(onServerDestroyed()));
+    mClientId = mServer->attach(this);
+
+    Q_EMIT connected();
+}
+
+void LoopbackServerConnection::onServerDestroyed()
+{
+    mClientId = 0;
+    Q_EMIT disconnected();
+}
+
+LoopbackInputContextConnection *LoopbackServerConnection::server() const
+{
+    return mClientId ? mServer.data() : 0;
+}
+
+void LoopbackServerConnection::activateContext()
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->activateContext(mClientId);
+    }
+}
+
+void LoopbackServerConnection::showInputMethod()
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->showInputMethod(mClientId);
+    }
+}
+
+void LoopbackServerConnection::hideInputMethod()
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->hideInputMethod(mClientId);
+    }
+}
+
+void LoopbackServerConnection::mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->mouseClickedOnPreedit(mClientId, pos, preeditRect);
+    }
+}
+
+void LoopbackServerConnection::setPreedit(const QString &text, int cursorPos)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->setPreedit(mClientId, text, cursorPos);
+    }
+}
+
+void LoopbackServerConnection::updateWidgetInformation(const QMap<QString, QVariant> &stateInformation,
+                                                       bool focusChanged)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->updateWidgetInformation(mClientId, stateInformation, focusChanged);
+    }
+}
+
+void LoopbackServerConnection::reset(bool requireSynchronization)
+{
+    // the reset has been handled when the call returns, so there is nothing to wait for
+    Q_UNUSED(requireSynchronization);
+
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->reset(mClientId);
+    }
+}
+
+void LoopbackServerConnection::appOrientationAboutToChange(int angle)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->receivedAppOrientationAboutToChange(mClientId, angle);
+    }
+}
+
+void LoopbackServerConnection::appOrientationChanged(int angle)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->receivedAppOrientationChanged(mClientId, angle);
+    }
+}
+
+void LoopbackServerConnection::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->setCopyPasteState(mClientId, copyAvailable, pasteAvailable);
+    }
+}
+
+void LoopbackServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                               Qt::KeyboardModifiers modifiers,
+                                               const QString &text, bool autoRepeat, int count,
+                                               quint32 nativeScanCode, quint32 nativeModifiers,
+                                               unsigned long time)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->processKeyEvent(mClientId, keyType, keyCode, modifiers, text, autoRepeat,
+                                    count, nativeScanCode, nativeModifiers, time);
+    }
+}
+
+void LoopbackServerConnection::registerAttributeExtension(int id, const QString &fileName)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->registerAttributeExtension(mClientId, id, fileName);
+    }
+}
+
+void LoopbackServerConnection::unregisterAttributeExtension(int id)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->unregisterAttributeExtension(mClientId, id);
+    }
+}
+
+void LoopbackServerConnection::setExtendedAttribute(int id, const QString &target,
+                                                    const QString &targetItem,
+                                                    const QString &attribute,
+                                                    const QVariant &value)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->setExtendedAttribute(mClientId, id, target, targetItem, attribute, value);
+    }
+}
+
+void LoopbackServerConnection::loadPluginSettings(const QString &descriptionLanguage)
+{
+    if (LoopbackInputContextConnection *connection = server()) {
+        connection->loadPluginSettings(mClientId, descriptionLanguage);
+    }
+}
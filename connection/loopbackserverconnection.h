@@ -0,0 +1,73 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef LOOPBACKSERVERCONNECTION_H
+#define LOOPBACKSERVERCONNECTION_H
+
+#include "mimserverconnection.h"
+
+#include <QPointer>
+
+class LoopbackInputContextConnection;
+
+/*! \internal
+ * \brief Server connection to an input method server in the same process.
+ *
+ * Counterpart of LoopbackInputContextConnection. Every call goes straight to
+ * the server side handler, and the server emits the signals of this object
+ * directly, so nothing is serialized or queued.
+ */
+class LoopbackServerConnection : public MImServerConnection
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackServerConnection(LoopbackInputContextConnection *server);
+    ~LoopbackServerConnection();
+
+    //! reimpl
+    virtual void activateContext();
+    virtual void showInputMethod();
+    virtual void hideInputMethod();
+    virtual void mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect);
+    virtual void setPreedit(const QString &text, int cursorPos);
+    virtual void updateWidgetInformation(const QMap<QString, QVariant> &stateInformation,
+                                         bool focusChanged);
+    virtual void reset(bool requireSynchronization);
+    virtual void appOrientationAboutToChange(int angle);
+    virtual void appOrientationChanged(int angle);
+    virtual void setCopyPasteState(bool copyAvailable, bool pasteAvailable);
+    virtual void processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                 Qt::KeyboardModifiers modifiers,
+                                 const QString &text, bool autoRepeat, int count,
+                                 quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    virtual void registerAttributeExtension(int id, const QString &fileName);
+    virtual void unregisterAttributeExtension(int id);
+    virtual void setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                      const QString &attribute, const QVariant &value);
+    virtual void loadPluginSettings(const QString &descriptionLanguage);
+    //! reimpl end
+
+private Q_SLOTS:
+    void connectToServer();
+    void onServerDestroyed();
+
+private:
+    //! Returns the server if this connection is attached to it, 0 otherwise
+    LoopbackInputContextConnection *server() const;
+
+    QPointer<LoopbackInputContextConnection> mServer;
+    unsigned int mClientId;
+};
+
+#endif // LOOPBACKSERVERCONNECTION_H
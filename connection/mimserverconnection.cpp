@@ -18,10 +18,64 @@
 MImServerConnection::MImServerConnection(QObject *parent)
     : QObject(parent)
     , d(0)
+    , mResetEpoch(0)
+    , mPreeditBase()
+    , mPreeditBaseValid(true)
 {
     Q_UNUSED(parent);
 }
 
+quint32 MImServerConnection::startResetEpoch()
+{
+    return ++mResetEpoch;
+}
+
+quint32 MImServerConnection::resetEpoch() const
+{
+    return mResetEpoch;
+}
+
+bool MImServerConnection::isCurrentResetEpoch(quint32 epoch) const
+{
+    return epoch == mResetEpoch;
+}
+
+const Maliit::InputContextMessage::PreeditBase &MImServerConnection::preeditBase() const
+{
+    return mPreeditBase;
+}
+
+bool MImServerConnection::hasPreeditBase() const
+{
+    return mPreeditBaseValid;
+}
+
+void MImServerConnection::setPreeditBase(const QString &string,
+                                         const QList<Maliit::PreeditTextFormat> &formats)
+{
+    mPreeditBase.string = string;
+    mPreeditBase.formats = formats;
+    mPreeditBaseValid = true;
+}
+
+void MImServerConnection::discardPreeditBase()
+{
+    // One request is enough, the server sends the next preedit in full anyway
+    if (!mPreeditBaseValid)
+        return;
+
+    mPreeditBase = Maliit::InputContextMessage::PreeditBase();
+    mPreeditBaseValid = false;
+    requestFullPreedit();
+}
+
+void MImServerConnection::clearMessageState()
+{
+    mResetEpoch = 0;
+    mPreeditBase = Maliit::InputContextMessage::PreeditBase();
+    mPreeditBaseValid = true;
+}
+
 void MImServerConnection::activateContext()
 {}
 
@@ -117,3 +171,6 @@ void MImServerConnection::loadPluginSettings(const QString &descriptionLanguage)
 {
     Q_UNUSED(descriptionLanguage);
 }
+
+void MImServerConnection::requestFullPreedit()
+{}
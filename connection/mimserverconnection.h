@@ -15,6 +15,8 @@
 #ifndef MIMSERVERCONNECTION_H
 #define MIMSERVERCONNECTION_H
 
+#include "inputcontextmessages.h"
+
 #include <maliit/namespace.h>
 
 #include <QtCore>
@@ -32,6 +34,35 @@ public:
 
     virtual bool pendingResets();
 
+    /*!
+     * \brief Starts a new reset epoch, to be sent along with a synchronizing reset().
+     *
+     * Servers which know about epochs tag commit and preedit messages with the
+     * epoch of the last reset they handled. Messages tagged with an older epoch
+     * were sent before the server saw the reset and are dropped on arrival,
+     * so a synchronizing reset does not need to wait for an answer.
+     */
+    quint32 startResetEpoch();
+    //! Returns the epoch of the last synchronizing reset, 0 if there was none yet
+    quint32 resetEpoch() const;
+    //! Returns false for messages tagged with an epoch older than resetEpoch()
+    bool isCurrentResetEpoch(quint32 epoch) const;
+
+    //! Returns the preedit last sent by the server, which preedit deltas apply to
+    const Maliit::InputContextMessage::PreeditBase &preeditBase() const;
+    //! Returns false from discardPreeditBase() until the next full preedit arrives
+    bool hasPreeditBase() const;
+    //! To be called for every preedit from the server, including those dropped for their epoch
+    void setPreeditBase(const QString &string, const QList<Maliit::PreeditTextFormat> &formats);
+    /*!
+     * \brief Forgets the preedit base after a message from the server could not be handled.
+     *
+     * The server moved its base on to a preedit the application never got,
+     * so deltas are dropped until the full preedit asked for with
+     * requestFullPreedit() arrives.
+     */
+    void discardPreeditBase();
+
     /* Outgoing communication */
     virtual void activateContext();
     virtual void showInputMethod();
@@ -52,6 +83,8 @@ public:
     virtual void setExtendedAttribute(int id, const QString &target, const QString &targetItem,
                                       const QString &attribute, const QVariant &value);
     virtual void loadPluginSettings(const QString &descriptionLanguage);
+    //! Asks the server to send its next preedit in full, see discardPreeditBase()
+    virtual void requestFullPreedit();
 
 public:
     /*! \brief Notifies about connection to server being established.
@@ -174,6 +207,22 @@ public:
      */
     Q_SIGNAL void setLanguage(const QString &language);
 
+    /*!
+     * \brief Asks to send only \a characters of surrounding text around the cursor,
+     * 0 for the whole text.
+     */
+    Q_SIGNAL void setSurroundingTextWindow(int characters);
+
+    /*!
+     * \brief Get \a length characters of the text, starting at the absolute position \a start
+     * \param valid validity for the return value
+     * \param text the requested range
+     *
+     * Warning: If multiple slots are connected to this signal, the last slot to be
+     * called will be able to overwrite value set by previously called slots.
+     */
+    Q_SIGNAL void getSurroundingText(int start, int length, QString &text, bool &valid) const;
+
     /*!
      *\brief Informs application that input method server has changed the \a attribute of the \a targetItem
      * in the attribute extension \a target which has unique \a id to \a value.
@@ -193,10 +242,18 @@ public:
      */
     Q_SIGNAL void pluginSettingsReceived(const QList<MImPluginSettingsInfo> &info);
 
+protected:
+    //! Starts over at epoch 0 without a preedit base, to be called when connected
+    //! to a (possibly different) server
+    void clearMessageState();
+
 private:
     Q_DISABLE_COPY(MImServerConnection)
 
     MImServerConnectionPrivate *d;
+    quint32 mResetEpoch;
+    Maliit::InputContextMessage::PreeditBase mPreeditBase;
+    bool mPreeditBaseValid;
 };
 
 #endif
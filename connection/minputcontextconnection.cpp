@@ -16,22 +16,65 @@
 
 #include <QKeyEvent>
 
+#include <limits.h>
+
 namespace {
-    // attribute names for updateWidgetInformation() map
-    const char * const FocusStateAttribute = "focusState";
-    const char * const ContentTypeAttribute = "contentType";
-    const char * const CorrectionAttribute = "correctionEnabled";
-    const char * const PredictionAttribute = "predictionEnabled";
-    const char * const AutoCapitalizationAttribute = "autocapitalizationEnabled";
-    const char * const SurroundingTextAttribute = "surroundingText";
-    const char * const AnchorPositionAttribute = "anchorPosition";
-    const char * const CursorPositionAttribute = "cursorPosition";
-    const char * const HasSelectionAttribute = "hasSelection";
-    const char * const InputMethodModeAttribute = "inputMethodMode";
-    const char * const WinId = "winId";
-    const char * const CursorRectAttribute = "cursorRectangle";
-    const char * const HiddenTextAttribute = "hiddenText";
-    const char * const PreeditClickPosAttribute = "preeditClickPos";
+    //! Number of inactive clients whose widget state is kept
+    const int MaximumCachedWidgetStates(16);
+
+    //! Updates within this interval make one widgetStateChanged(), see setWidgetStateCoalescing()
+    const int WidgetStateCoalescingInterval(16); // in ms, one frame at 60 Hz
+
+    //! Token of a client quota, see setClientQuota()
+    const qint64 QuotaTokenSize(1000);
+
+    unsigned int nextWidgetStateVersion(unsigned int version)
+    {
+        // 0 is reserved for "no valid state"
+        ++version;
+        return version ? version : 1;
+    }
+
+    bool isSurroundingTextEditKey(const QString &key)
+    {
+        return key == Maliit::WidgetStateEdit::SurroundingTextEditPosition
+            || key == Maliit::WidgetStateEdit::SurroundingTextEditRemoved
+            || key == Maliit::WidgetStateEdit::SurroundingTextEditText;
+    }
+
+    //! Applies a delta to \a state, returns false if its text edit does not fit the text
+    bool applyWidgetStateDelta(Maliit::WidgetState &state,
+                               const QMap<QString, QVariant> &changedState,
+                               const QStringList &removedKeys)
+    {
+        Q_FOREACH (const QString &key, removedKeys) {
+            state.remove(key);
+        }
+
+        // The edit is relative to the text the application sent before
+        if (changedState.contains(Maliit::WidgetStateEdit::SurroundingTextEditPosition)) {
+            bool positionValid = false;
+            bool removedValid = false;
+            const int position = changedState.value(Maliit::WidgetStateEdit::SurroundingTextEditPosition).toInt(&positionValid);
+            const int removed = changedState.value(Maliit::WidgetStateEdit::SurroundingTextEditRemoved).toInt(&removedValid);
+            const QString text = changedState.value(Maliit::WidgetStateEdit::SurroundingTextEditText).toString();
+
+            if (not positionValid || not removedValid
+                || not state.editSurroundingText(position, removed, text)) {
+                return false;
+            }
+        }
+
+        for (QMap<QString, QVariant>::const_iterator iter = changedState.constBegin();
+             iter != changedState.constEnd();
+             ++iter) {
+            if (not isSurroundingTextEditKey(iter.key())) {
+                state.insert(iter.key(), iter.value());
+            }
+        }
+
+        return true;
+    }
 }
 
 class MInputContextConnectionPrivate
@@ -61,11 +104,36 @@ MInputContextConnection::MInputContextConnection(QObject *parent)
     : activeConnection(0)
     , d(new MInputContextConnectionPrivate)
     , lastOrientation(0)
+    , mWidgetStateVersion(0)
+    , mCachedWidgetStates()
+    , mCachedWidgetStateOrder()
+    , mLastRequestId(0)
     , mGlobalCorrectionEnabled(false)
     , mRedirectionEnabled(false)
     , mDetectableAutoRepeat(false)
+    , mSurroundingTextWindow(0)
+    , mWidgetStateCoalescing(false)
+    , mWidgetStateTimer()
+    , mWidgetStateChangePending(false)
+    , mPendingWidgetStateClient(0)
+    , mPendingOldWidgetState()
+    , mPendingWidgetStateThrottled(false)
+    , mQuotaRate(0)
+    , mQuotaBurst(1)
+    , mQuotaClock()
+    , mClientQuotas()
+    , mQuotaTimer()
+    , mResetEpochs()
 {
     Q_UNUSED(parent);
+
+    mWidgetStateTimer.setSingleShot(true);
+    mWidgetStateTimer.setInterval(WidgetStateCoalescingInterval);
+    connect(&mWidgetStateTimer, SIGNAL(timeout()), this, SLOT(flushWidgetStateChange()));
+
+    mQuotaClock.start();
+    mQuotaTimer.setSingleShot(true);
+    connect(&mQuotaTimer, SIGNAL(timeout()), this, SLOT(deliverDeferredAttributes()));
 }
 
 
@@ -77,61 +145,53 @@ MInputContextConnection::~MInputContextConnection()
 /* Accessors to widgetState */
 bool MInputContextConnection::focusState(bool &valid)
 {
-    QVariant focusStateVariant = mWidgetState[FocusStateAttribute];
-    valid = focusStateVariant.isValid();
-    return focusStateVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::FocusState);
+    return mWidgetState.focusState();
 }
 
 int MInputContextConnection::contentType(bool &valid)
 {
-    QVariant contentTypeVariant = mWidgetState[ContentTypeAttribute];
-    return contentTypeVariant.toInt(&valid);
+    valid = mWidgetState.contains(Maliit::WidgetState::ContentType);
+    return mWidgetState.contentType();
 }
 
 bool MInputContextConnection::correctionEnabled(bool &valid)
 {
-    QVariant correctionVariant = mWidgetState[CorrectionAttribute];
-    valid = correctionVariant.isValid();
-    return correctionVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::Correction);
+    return mWidgetState.correctionEnabled();
 }
 
 
 bool MInputContextConnection::predictionEnabled(bool &valid)
 {
-    QVariant predictionVariant = mWidgetState[PredictionAttribute];
-    valid = predictionVariant.isValid();
-    return predictionVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::Prediction);
+    return mWidgetState.predictionEnabled();
 }
 
 bool MInputContextConnection::autoCapitalizationEnabled(bool &valid)
 {
-    QVariant capitalizationVariant = mWidgetState[AutoCapitalizationAttribute];
-    valid = capitalizationVariant.isValid();
-    return capitalizationVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::AutoCapitalization);
+    return mWidgetState.autoCapitalizationEnabled();
 }
 
 QRect MInputContextConnection::cursorRectangle(bool &valid)
 {
-    QVariant cursorRectVariant = mWidgetState[CursorRectAttribute];
-    valid = cursorRectVariant.isValid();
-    return cursorRectVariant.toRect();
+    valid = mWidgetState.contains(Maliit::WidgetState::CursorRectangle);
+    return mWidgetState.cursorRectangle();
 }
 
 bool MInputContextConnection::hiddenText(bool &valid)
 {
-    QVariant hiddenTextVariant = mWidgetState[HiddenTextAttribute];
-    valid = hiddenTextVariant.isValid();
-    return hiddenTextVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::HiddenText);
+    return mWidgetState.hiddenText();
 }
 
 bool MInputContextConnection::surroundingText(QString &text, int &cursorPosition)
 {
-    QVariant textVariant = mWidgetState[SurroundingTextAttribute];
-    QVariant posVariant = mWidgetState[CursorPositionAttribute];
-
-    if (textVariant.isValid() && posVariant.isValid()) {
-        text = textVariant.toString();
-        cursorPosition = posVariant.toInt();
+    if (mWidgetState.contains(Maliit::WidgetState::SurroundingText)
+        && mWidgetState.contains(Maliit::WidgetState::CursorPosition)) {
+        text = mWidgetState.surroundingText();
+        cursorPosition = mWidgetState.cursorPosition();
         return true;
     }
 
@@ -140,21 +200,32 @@ bool MInputContextConnection::surroundingText(QString &text, int &cursorPosition
 
 bool MInputContextConnection::hasSelection(bool &valid)
 {
-    QVariant selectionVariant = mWidgetState[HasSelectionAttribute];
-    valid = selectionVariant.isValid();
-    return selectionVariant.toBool();
+    valid = mWidgetState.contains(Maliit::WidgetState::HasSelection);
+    return mWidgetState.hasSelection();
 }
 
 int MInputContextConnection::inputMethodMode(bool &valid)
 {
-    QVariant modeVariant = mWidgetState[InputMethodModeAttribute];
-    return modeVariant.toInt(&valid);
+    valid = mWidgetState.contains(Maliit::WidgetState::InputMethodMode);
+    return mWidgetState.inputMethodMode();
 }
 
 QRect MInputContextConnection::preeditRectangle(bool &valid)
 {
-    valid = false;
-    return QRect();
+    valid = mWidgetState.contains(Maliit::WidgetState::PreeditRectangle);
+    return mWidgetState.preeditRectangle();
+}
+
+int MInputContextConnection::requestPreeditRectangle()
+{
+    const int requestId = nextRequestId();
+    bool valid;
+    const QRect rectangle = preeditRectangle(valid);
+
+    // always answer asynchronously, as the D-Bus connection does
+    QMetaObject::invokeMethod(this, "preeditRectangleReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QRect, rectangle), Q_ARG(bool, valid));
+    return requestId;
 }
 
 WId MInputContextConnection::winId()
@@ -163,38 +234,25 @@ WId MInputContextConnection::winId()
     WId result = 0;
     return result;
 #else
-    QVariant winIdVariant = mWidgetState[WinId];
-    // after transfer by dbus type can change
-    switch (winIdVariant.type()) {
-    case QVariant::UInt:
-        if (sizeof(uint) >= sizeof(WId))
-            return winIdVariant.toUInt();
-        break;
-    case QVariant::ULongLong:
-        if (sizeof(qulonglong) >= sizeof(WId))
-            return winIdVariant.toULongLong();
-        break;
-    default:
-        if (winIdVariant.canConvert<WId>())
-            return winIdVariant.value<WId>();
-    }
-    return 0;
+    const qulonglong winId = mWidgetState.winId();
+    // do not truncate ids which do not fit into WId
+    if (static_cast<qulonglong>(static_cast<WId>(winId)) != winId)
+        return 0;
+    return static_cast<WId>(winId);
 #endif
 }
 
 
 int MInputContextConnection::anchorPosition(bool &valid)
 {
-    QVariant posVariant = mWidgetState[AnchorPositionAttribute];
-    valid = posVariant.isValid();
-    return posVariant.toInt();
+    valid = mWidgetState.contains(Maliit::WidgetState::AnchorPosition);
+    return mWidgetState.anchorPosition();
 }
 
 int MInputContextConnection::preeditClickPos(bool &valid) const
 {
-    QVariant selectionVariant = mWidgetState[PreeditClickPosAttribute];
-    valid = selectionVariant.isValid();
-    return selectionVariant.toInt();
+    valid = mWidgetState.contains(Maliit::WidgetState::PreeditClickPos);
+    return mWidgetState.preeditClickPos();
 }
 
 /* End accessors to widget state */
@@ -205,6 +263,8 @@ void MInputContextConnection::showInputMethod(unsigned int connectionId)
     if (activeConnection != connectionId)
         return;
 
+    flushWidgetStateChange();
+
     Q_EMIT showInputMethodRequest();
 }
 
@@ -256,17 +316,132 @@ void MInputContextConnection::reset(unsigned int connectionId)
     }
 }
 
+void MInputContextConnection::reset(unsigned int connectionId, quint32 epoch)
+{
+    // Whatever the input method sends while resetting belongs to the old epoch
+    reset(connectionId);
+    mResetEpochs.insert(connectionId, epoch);
+}
+
+quint32 MInputContextConnection::resetEpoch(unsigned int connectionId) const
+{
+    return mResetEpochs.value(connectionId);
+}
+
 void
 MInputContextConnection::updateWidgetInformation(
     unsigned int connectionId, const QMap<QString, QVariant> &stateInfo,
     bool handleFocusChange)
 {
-    if (activeConnection != connectionId)
+    updateWidgetInformation(connectionId, Maliit::WidgetState::fromVariantMap(stateInfo),
+                            handleFocusChange);
+}
+
+void
+MInputContextConnection::updateWidgetInformation(
+    unsigned int connectionId, const Maliit::WidgetState &state,
+    bool handleFocusChange)
+{
+    if (activeConnection != connectionId) {
+        cacheWidgetState(connectionId, state, 1);
         return;
+    }
 
-    QMap<QString, QVariant> oldState = mWidgetState;
+    mWidgetStateVersion = 1;
+    setWidgetState(connectionId, state, handleFocusChange);
+}
 
-    mWidgetState = stateInfo;
+bool
+MInputContextConnection::updateWidgetInformationDelta(
+    unsigned int connectionId, const QMap<QString, QVariant> &changedState,
+    const QStringList &removedKeys, unsigned int baseVersion,
+    bool handleFocusChange)
+{
+    // Updates of inactive clients go to their cached state
+    if (activeConnection != connectionId) {
+        const CachedWidgetState cached = mCachedWidgetStates.value(connectionId);
+        Maliit::WidgetState newState = cached.state;
+        if (!mCachedWidgetStates.contains(connectionId) || baseVersion != cached.version
+            || !applyWidgetStateDelta(newState, changedState, removedKeys)) {
+            // Evicted or out of sync, the client has to send its full state
+            mCachedWidgetStates.remove(connectionId);
+            mCachedWidgetStateOrder.removeOne(connectionId);
+            return false;
+        }
+
+        cacheWidgetState(connectionId, newState, nextWidgetStateVersion(cached.version));
+        return true;
+    }
+
+    if (mWidgetStateVersion == 0 || baseVersion != mWidgetStateVersion) {
+        qWarning() << __PRETTY_FUNCTION__ << "widget state version mismatch, expected"
+                   << mWidgetStateVersion << "got" << baseVersion;
+        // Refuse further deltas until the client resynchronized
+        mWidgetStateVersion = 0;
+        return false;
+    }
+
+    // Apply on top of the received state, so that local edits of the
+    // surrounding text do not survive when the application did not confirm them.
+    Maliit::WidgetState newState = mReceivedWidgetState;
+    if (!applyWidgetStateDelta(newState, changedState, removedKeys)) {
+        qWarning() << __PRETTY_FUNCTION__ << "surrounding text edit does not fit the text";
+        mWidgetStateVersion = 0;
+        return false;
+    }
+
+    mWidgetStateVersion = nextWidgetStateVersion(mWidgetStateVersion);
+    setWidgetState(connectionId, newState, handleFocusChange);
+
+    return true;
+}
+
+void MInputContextConnection::setWidgetState(unsigned int connectionId,
+                                             const Maliit::WidgetState &newState,
+                                             bool handleFocusChange)
+{
+    const Maliit::WidgetState oldState = mWidgetState;
+
+    mWidgetState = newState;
+    mReceivedWidgetState = newState;
+
+    if (!handleFocusChange && mWidgetStateChangePending
+        && (mWidgetStateCoalescing || mPendingWidgetStateThrottled)) {
+        // Plugins get this update together with the one held back
+        if (mPendingWidgetStateThrottled) {
+            ++refilledQuota(connectionId).counters.coalesced;
+        }
+        return;
+    }
+
+    if (!handleFocusChange) {
+        int throttleDelay = 0;
+        if (mQuotaRate > 0) {
+            ClientQuota &quota = refilledQuota(connectionId);
+            throttleDelay = reserveQuotaToken(quota);
+            if (throttleDelay > 0) {
+                ++quota.counters.deferred;
+            }
+        }
+
+        if (mWidgetStateCoalescing || throttleDelay > 0) {
+            mWidgetStateChangePending = true;
+            mPendingWidgetStateThrottled = throttleDelay > 0;
+            mPendingWidgetStateClient = connectionId;
+            mPendingOldWidgetState = oldState;
+            mWidgetStateTimer.start(qMax(mWidgetStateCoalescing ? WidgetStateCoalescingInterval : 0,
+                                         throttleDelay));
+            return;
+        }
+    }
+
+    // Plugins have not seen the updates held back so far
+    const Maliit::WidgetState notifiedOldState = mWidgetStateChangePending ? mPendingOldWidgetState
+                                                                           : oldState;
+    mWidgetStateTimer.stop();
+    mWidgetStateChangePending = false;
+    mPendingWidgetStateThrottled = false;
+    mPendingOldWidgetState = Maliit::WidgetState();
 
 #ifndef Q_WS_WIN
     if (handleFocusChange) {
@@ -274,7 +449,181 @@ MInputContextConnection::updateWidgetInformation(
     }
 #endif
 
-    Q_EMIT widgetStateChanged(connectionId, mWidgetState, oldState, handleFocusChange);
+    Q_EMIT widgetStateChanged(connectionId, mWidgetState, notifiedOldState, handleFocusChange);
+}
+
+void MInputContextConnection::flushWidgetStateChange()
+{
+    mWidgetStateTimer.stop();
+
+    if (!mWidgetStateChangePending)
+        return;
+
+    const Maliit::WidgetState oldState = mPendingOldWidgetState;
+    mWidgetStateChangePending = false;
+    mPendingWidgetStateThrottled = false;
+    mPendingOldWidgetState = Maliit::WidgetState();
+
+    Q_EMIT widgetStateChanged(mPendingWidgetStateClient, mWidgetState, oldState, false);
+}
+
+void MInputContextConnection::setWidgetStateCoalescing(bool enabled)
+{
+    mWidgetStateCoalescing = enabled;
+
+    if (!enabled) {
+        flushWidgetStateChange();
+    }
+}
+
+bool MInputContextConnection::widgetStateCoalescing() const
+{
+    return mWidgetStateCoalescing;
+}
+
+void MInputContextConnection::setHibernationTimeout(int timeout)
+{
+    Q_UNUSED(timeout);
+    // not supported by default
+}
+
+void MInputContextConnection::setClientQuota(int messagesPerSecond, int burst)
+{
+    mQuotaRate = qMax(0, messagesPerSecond);
+    mQuotaBurst = qMax(1, burst);
+
+    if (mQuotaRate > 0) {
+        return;
+    }
+
+    // Nothing waits for tokens anymore
+    mQuotaTimer.stop();
+    Q_FOREACH (unsigned int connectionId, mClientQuotas.keys()) {
+        flushDeferredAttributes(connectionId);
+    }
+    if (mPendingWidgetStateThrottled) {
+        flushWidgetStateChange();
+    }
+}
+
+MInputContextConnection::ThrottleCounters
+MInputContextConnection::throttleCounters(unsigned int connectionId) const
+{
+    const QHash<unsigned int, ClientQuota>::const_iterator it = mClientQuotas.find(connectionId);
+    if (it != mClientQuotas.end()) {
+        return it->counters;
+    }
+
+    const ThrottleCounters counters = { 0, 0 };
+    return counters;
+}
+
+MInputContextConnection::ClientQuota &
+MInputContextConnection::refilledQuota(unsigned int connectionId)
+{
+    const qint64 now = mQuotaClock.elapsed();
+    const qint64 capacity = mQuotaBurst * QuotaTokenSize;
+
+    QHash<unsigned int, ClientQuota>::iterator it = mClientQuotas.find(connectionId);
+    if (it == mClientQuotas.end()) {
+        // New clients start with a full bucket
+        ClientQuota quota;
+        quota.tokens = capacity;
+        quota.refilledAt = now;
+        quota.counters.deferred = 0;
+        quota.counters.coalesced = 0;
+        return *mClientQuotas.insert(connectionId, quota);
+    }
+
+    // A rate of n messages per second earns n thousandths of a message per ms
+    it->tokens = qMin(capacity, it->tokens + (now - it->refilledAt) * mQuotaRate);
+    it->refilledAt = now;
+    return *it;
+}
+
+int MInputContextConnection::reserveQuotaToken(ClientQuota &quota) const
+{
+    quota.tokens -= QuotaTokenSize;
+    return quotaDelay(quota);
+}
+
+int MInputContextConnection::quotaDelay(const ClientQuota &quota) const
+{
+    if (quota.tokens >= 0 || mQuotaRate <= 0) {
+        return 0;
+    }
+
+    return static_cast<int>((-quota.tokens + mQuotaRate - 1) / mQuotaRate);
+}
+
+void MInputContextConnection::flushDeferredAttributes(unsigned int connectionId)
+{
+    const QHash<unsigned int, ClientQuota>::iterator it = mClientQuotas.find(connectionId);
+    if (it == mClientQuotas.end() || it->deferredAttributes.isEmpty()) {
+        return;
+    }
+
+    const QList<DeferredAttribute> attributes = it->deferredAttributes;
+    it->deferredAttributes.clear();
+
+    Q_FOREACH (const DeferredAttribute &deferred, attributes) {
+        Q_EMIT extendedAttributeChanged(connectionId, deferred.id, deferred.target,
+                                        deferred.targetName, deferred.attribute, deferred.value);
+    }
+}
+
+void MInputContextConnection::deliverDeferredAttributes()
+{
+    int nextDelay = 0;
+
+    Q_FOREACH (unsigned int connectionId, mClientQuotas.keys()) {
+        Q_FOREVER {
+            // Looked up again each time, handlers may disconnect the client
+            if (!mClientQuotas.contains(connectionId)
+                || mClientQuotas.value(connectionId).deferredAttributes.isEmpty()) {
+                break;
+            }
+
+            ClientQuota &quota = refilledQuota(connectionId);
+            const int delay = quotaDelay(quota);
+            if (delay > 0) {
+                nextDelay = nextDelay > 0 ? qMin(nextDelay, delay) : delay;
+                break;
+            }
+
+            const DeferredAttribute deferred = quota.deferredAttributes.takeFirst();
+            if (!quota.deferredAttributes.isEmpty()) {
+                reserveQuotaToken(quota);
+            }
+
+            Q_EMIT extendedAttributeChanged(connectionId, deferred.id, deferred.target,
+                                            deferred.targetName, deferred.attribute, deferred.value);
+        }
+    }
+
+    if (nextDelay > 0) {
+        mQuotaTimer.start(nextDelay);
+    }
+}
+
+void MInputContextConnection::cacheWidgetState(unsigned int connectionId,
+                                               const Maliit::WidgetState &state,
+                                               unsigned int version)
+{
+    if (connectionId == 0 || version == 0)
+        return;
+
+    CachedWidgetState cached;
+    cached.state = state;
+    cached.version = version;
+    mCachedWidgetStates.insert(connectionId, cached);
+
+    mCachedWidgetStateOrder.removeOne(connectionId);
+    mCachedWidgetStateOrder.append(connectionId);
+
+    while (mCachedWidgetStateOrder.size() > MaximumCachedWidgetStates) {
+        mCachedWidgetStates.remove(mCachedWidgetStateOrder.takeFirst());
+    }
 }
 
 void
@@ -325,19 +674,40 @@ void MInputContextConnection::processKeyEvent(
     if (activeConnection != connectionId)
         return;
 
+    flushWidgetStateChange();
+
     Q_EMIT receivedKeyEvent(keyType, keyCode,
                             modifiers, text, autoRepeat, count,
                             nativeScanCode, nativeModifiers, time);
 }
 
+void MInputContextConnection::processKeyRepeat(
+    unsigned int connectionId, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+    const QString &text, int repeats, bool releases, quint32 nativeScanCode,
+    quint32 nativeModifiers, unsigned long time)
+{
+    if (activeConnection != connectionId || repeats <= 0)
+        return;
+
+    flushWidgetStateChange();
+
+    Q_EMIT receivedKeyRepeat(keyCode, modifiers, text, repeats, releases,
+                             nativeScanCode, nativeModifiers, time);
+}
+
 void MInputContextConnection::registerAttributeExtension(unsigned int connectionId, int id,
                                                          const QString &attributeExtension)
 {
+    // Attributes sent before keep their order
+    flushDeferredAttributes(connectionId);
+
     Q_EMIT attributeExtensionRegistered(connectionId, id, attributeExtension);
 }
 
 void MInputContextConnection::unregisterAttributeExtension(unsigned int connectionId, int id)
 {
+    flushDeferredAttributes(connectionId);
+
     Q_EMIT attributeExtensionUnregistered(connectionId, id);
 }
 
@@ -345,6 +715,41 @@ void MInputContextConnection::setExtendedAttribute(
     unsigned int connectionId, int id, const QString &target, const QString &targetName,
     const QString &attribute, const QVariant &value)
 {
+    if (mQuotaRate > 0) {
+        ClientQuota &quota = refilledQuota(connectionId);
+
+        // Queued behind the attributes waiting already, whatever the tokens
+        if (!quota.deferredAttributes.isEmpty()) {
+            ++quota.counters.deferred;
+
+            for (QList<DeferredAttribute>::iterator it = quota.deferredAttributes.begin();
+                 it != quota.deferredAttributes.end(); ++it) {
+                if (it->id == id && it->target == target && it->targetName == targetName
+                    && it->attribute == attribute) {
+                    it->value = value;
+                    ++quota.counters.coalesced;
+                    return;
+                }
+            }
+
+            const DeferredAttribute deferred = { id, target, targetName, attribute, value };
+            quota.deferredAttributes.append(deferred);
+            return;
+        }
+
+        const int delay = reserveQuotaToken(quota);
+        if (delay > 0) {
+            ++quota.counters.deferred;
+
+            const DeferredAttribute deferred = { id, target, targetName, attribute, value };
+            quota.deferredAttributes.append(deferred);
+            if (!mQuotaTimer.isActive() || mQuotaTimer.remainingTime() > delay) {
+                mQuotaTimer.start(delay);
+            }
+            return;
+        }
+    }
+
     Q_EMIT extendedAttributeChanged(connectionId, id, target, targetName, attribute, value);
 }
 
@@ -388,7 +793,7 @@ bool MInputContextConnection::redirectKeysEnabled()
 void MInputContextConnection::sendCommitString(const QString &string, int replaceStart,
                                           int replaceLength, int cursorPos) {
 
-    const int cursorPosition(mWidgetState[CursorPositionAttribute].toInt());
+    const int cursorPosition(mWidgetState.cursorPosition());
     bool validAnchor(false);
 
     preedit.clear();
@@ -398,11 +803,12 @@ void MInputContextConnection::sendCommitString(const QString &string, int replac
         && anchorPosition(validAnchor) == cursorPosition
         && validAnchor) {
         const int insertPosition(cursorPosition + replaceStart);
-        if (insertPosition >= 0) {
-            mWidgetState[SurroundingTextAttribute]
-                = mWidgetState[SurroundingTextAttribute].toString().insert(insertPosition, string);
-            mWidgetState[CursorPositionAttribute] = cursorPos < 0 ? (insertPosition + string.length()) : cursorPos;
-            mWidgetState[AnchorPositionAttribute] = mWidgetState[CursorPositionAttribute];
+        if (mWidgetState.editSurroundingText(insertPosition, 0, string)) {
+            mWidgetState.setCursorPosition(cursorPos < 0 ? (insertPosition + string.length()) : cursorPos);
+            mWidgetState.setAnchorPosition(mWidgetState.cursorPosition());
+            if (mWidgetState.contains(Maliit::WidgetState::SurroundingTextLength)) {
+                mWidgetState.setSurroundingTextLength(mWidgetState.surroundingTextLength() + string.length());
+            }
         }
     }
 }
@@ -414,18 +820,20 @@ void MInputContextConnection::sendKeyEvent(const QKeyEvent &keyEvent,
         && preedit.isEmpty()
         && keyEvent.key() == Qt::Key_Backspace
         && keyEvent.type() == QEvent::KeyPress) {
-        QString surrString(mWidgetState[SurroundingTextAttribute].toString());
-        const int cursorPosition(mWidgetState[CursorPositionAttribute].toInt());
+        const int cursorPosition(mWidgetState.cursorPosition());
         bool validAnchor(false);
 
-        if (!surrString.isEmpty()
+        if (!mWidgetState.surroundingTextMirror().isEmpty()
             && cursorPosition > 0
             // we don't support selections
             && anchorPosition(validAnchor) == cursorPosition
             && validAnchor) {
-            mWidgetState[SurroundingTextAttribute] = surrString.remove(cursorPosition - 1, 1);
-            mWidgetState[CursorPositionAttribute] = cursorPosition - 1;
-            mWidgetState[AnchorPositionAttribute] = cursorPosition - 1;
+            mWidgetState.editSurroundingText(cursorPosition - 1, 1, QString());
+            mWidgetState.setCursorPosition(cursorPosition - 1);
+            mWidgetState.setAnchorPosition(cursorPosition - 1);
+            if (mWidgetState.contains(Maliit::WidgetState::SurroundingTextLength)) {
+                mWidgetState.setSurroundingTextLength(mWidgetState.surroundingTextLength() - 1);
+            }
         }
     }
 }
@@ -434,12 +842,23 @@ void MInputContextConnection::sendKeyEvent(const QKeyEvent &keyEvent,
 /* */
 void MInputContextConnection::handleDisconnection(unsigned int connectionId)
 {
+    mCachedWidgetStates.remove(connectionId);
+    mCachedWidgetStateOrder.removeOne(connectionId);
+    mResetEpochs.remove(connectionId);
+    mClientQuotas.remove(connectionId);
+
     Q_EMIT clientDisconnected(connectionId);
 
     if (activeConnection != connectionId) {
         return;
     }
 
+    // Nobody is interested in the last updates of a client which is gone
+    mWidgetStateTimer.stop();
+    mWidgetStateChangePending = false;
+    mPendingWidgetStateThrottled = false;
+    mPendingOldWidgetState = Maliit::WidgetState();
+
     activeConnection = 0;
 
     Q_EMIT activeClientDisconnected();
@@ -451,11 +870,20 @@ void MInputContextConnection::activateContext(unsigned int connectionId)
         return;
     }
 
+    /* Plugins see the last state of the previous client before the switch */
+    flushWidgetStateChange();
+
     /* Notify current/previously active context that it is no longer active */
     sendActivationLostEvent();
 
+    /* Keep the state of the previous client for when it comes back */
+    cacheWidgetState(activeConnection, mReceivedWidgetState, mWidgetStateVersion);
+
     activeConnection = connectionId;
 
+    /* Unknown clients start over with a full widget state update */
+    mWidgetStateVersion = 0;
+
     /* Notify new input context about state/settings stored in the IM server */
     if (activeConnection) {
         /* Hack: Circumvent if(newValue == oldValue) return; guards */
@@ -467,6 +895,18 @@ void MInputContextConnection::activateContext(unsigned int connectionId)
 
         mDetectableAutoRepeat = !mDetectableAutoRepeat;
         setDetectableAutoRepeat(!mDetectableAutoRepeat);
+
+        setSurroundingTextWindow(mSurroundingTextWindow);
+    }
+
+    /* Known clients get their last state back right away, and can continue with deltas.
+       The focus change is left to the update the client sends after activating. */
+    if (activeConnection && mCachedWidgetStates.contains(activeConnection)) {
+        const CachedWidgetState cached = mCachedWidgetStates.take(activeConnection);
+        mCachedWidgetStateOrder.removeOne(activeConnection);
+
+        mWidgetStateVersion = cached.version;
+        setWidgetState(activeConnection, cached.state, false);
     }
 
     Q_EMIT clientActivated(connectionId);
@@ -509,8 +949,53 @@ void MInputContextConnection::invokeAction(const QString &action, const QKeySequ
 
 QString MInputContextConnection::selection(bool &valid)
 {
-    valid = false;
-    return QString();
+    valid = mWidgetState.contains(Maliit::WidgetState::Selection);
+    return mWidgetState.selection();
+}
+
+int MInputContextConnection::requestSelection()
+{
+    const int requestId = nextRequestId();
+    bool valid;
+    const QString text = selection(valid);
+
+    QMetaObject::invokeMethod(this, "selectionReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QString, text), Q_ARG(bool, valid));
+    return requestId;
+}
+
+void MInputContextConnection::setSurroundingTextWindow(int characters)
+{
+    mSurroundingTextWindow = qMax(characters, 0);
+}
+
+int MInputContextConnection::surroundingTextWindow() const
+{
+    return mSurroundingTextWindow;
+}
+
+int MInputContextConnection::surroundingTextOffset(bool &valid)
+{
+    valid = mWidgetState.contains(Maliit::WidgetState::SurroundingText);
+    return mWidgetState.surroundingTextOffset();
+}
+
+int MInputContextConnection::requestSurroundingText(int start, int length)
+{
+    const int requestId = nextRequestId();
+
+    // the range can be answered if it lies within the window
+    const int windowStart = mWidgetState.surroundingTextOffset();
+    const Maliit::TextMirror &window = mWidgetState.surroundingTextMirror();
+    const bool valid = mWidgetState.contains(Maliit::WidgetState::SurroundingText)
+                       && start >= windowStart && length >= 0
+                       && start - windowStart + length <= window.length();
+    const QString text = valid ? window.mid(start - windowStart, length) : QString();
+
+    QMetaObject::invokeMethod(this, "surroundingTextReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(int, start),
+                              Q_ARG(QString, text), Q_ARG(bool, valid));
+    return requestId;
 }
 
 void MInputContextConnection::setLanguage(const QString &language)
@@ -554,7 +1039,14 @@ void MInputContextConnection::pluginSettingsLoaded(int clientId, const QList<MIm
 }
 
 
-QVariantMap MInputContextConnection::widgetState() const
+const Maliit::WidgetState &MInputContextConnection::widgetState() const
 {
     return mWidgetState;
 }
+
+int MInputContextConnection::nextRequestId()
+{
+    // ids are only compared for equality, wrapping around is harmless
+    mLastRequestId = (mLastRequestId == INT_MAX) ? 1 : mLastRequestId + 1;
+    return mLastRequestId;
+}
@@ -16,6 +16,7 @@
 #define MINPUTCONTEXTCONNECTION_H
 
 #include <maliit/namespace.h>
+#include <maliit/widgetstate.h>
 
 #include <QtCore>
 #include <QWindow>
@@ -90,10 +91,18 @@ public:
     virtual int inputMethodMode(bool &valid);
 
     /*!
-     * \brief get preedit rectangle
+     * \brief get preedit rectangle, as last pushed by the application
      */
     virtual QRect preeditRectangle(bool &valid);
 
+    /*!
+     * \brief Asks the application for its current preedit rectangle without blocking.
+     *
+     * Returns a request id; the answer is delivered by preeditRectangleReceived().
+     * The default implementation answers from the cached widget state.
+     */
+    virtual int requestPreeditRectangle();
+
     /*!
      * \brief get cursor rectangle
      */
@@ -203,10 +212,43 @@ public:
     virtual int preeditClickPos(bool &valid) const;
 
     /*!
-     * \brief returns the selecting text
+     * \brief returns the selecting text, as last pushed by the application
      */
     virtual QString selection(bool &valid);
 
+    /*!
+     * \brief Asks the application for its current selection without blocking.
+     *
+     * Returns a request id; the answer is delivered by selectionReceived().
+     * The default implementation answers from the cached widget state.
+     */
+    virtual int requestSelection();
+
+    /*!
+     * \brief Asks applications to send only \a characters of surrounding text around the cursor.
+     *
+     * 0, the default, means the whole text. The window is sent to every application when it
+     * gets activated. Positions in the widget state stay relative to the window,
+     * see surroundingTextOffset().
+     */
+    virtual void setSurroundingTextWindow(int characters);
+
+    /*!
+     * \brief Returns the position of the surrounding text window in the whole text.
+     *
+     * 0 if the application sends its whole text.
+     */
+    int surroundingTextOffset(bool &valid);
+
+    /*!
+     * \brief Asks the application for \a length characters of its text, starting at
+     * the absolute position \a start.
+     *
+     * Returns a request id; the answer is delivered by surroundingTextReceived().
+     * The default implementation answers from the cached surrounding text window.
+     */
+    virtual int requestSurroundingText(int start, int length);
+
     /*!
      * \brief Sets current language of active input method.
      * \param language ICU format locale ID string
@@ -236,9 +278,41 @@ public: // Inbound communication handlers
                                  const QMap<QString, QVariant> &stateInformation,
                                  bool focusChanged);
 
+    //! Same as above, for connections which track the widget state themselves
+    void updateWidgetInformation(unsigned int clientId,
+                                 const Maliit::WidgetState &state,
+                                 bool focusChanged);
+
+    /*!
+     * \brief Applies a partial widget state update sent by the application.
+     *
+     * \a changedState contains the attributes which changed and \a removedKeys
+     * the attributes which are no longer set, relative to the state with version
+     * \a baseVersion. A full update always has version 1, every applied delta
+     * increments the version by one.
+     *
+     * Returns false if \a baseVersion does not match the state known to the server.
+     * The application is then expected to send its full state again.
+     */
+    bool updateWidgetInformationDelta(unsigned int clientId,
+                                      const QMap<QString, QVariant> &changedState,
+                                      const QStringList &removedKeys,
+                                      unsigned int baseVersion,
+                                      bool focusChanged);
+
     //! ipc method provided to the application, resets the input method
     void reset(unsigned int clientId);
 
+    /*!
+     * \brief Same as above, for applications which number their synchronizing resets.
+     *
+     * Commit and preedit messages sent to the application after the reset was
+     * handled carry \a epoch, see resetEpoch(). Those sent before, including
+     * any sent by the input method while handling the reset, carry the
+     * previous one and are dropped by the application.
+     */
+    void reset(unsigned int clientId, quint32 epoch);
+
     /*!
      * \brief Target application is changing orientation
      */
@@ -265,6 +339,16 @@ public: // Inbound communication handlers
                          Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat,
                          int count, quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
 
+    /*!
+     * \brief Process \a repeats autorepeats of a held hardware key, coalesced by the application.
+     *
+     * Stands for \a repeats autorepeat key presses, each preceded by an autorepeat
+     * key release if \a releases is true.
+     */
+    void processKeyRepeat(unsigned int clientId, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                          const QString &text, int repeats, bool releases, quint32 nativeScanCode,
+                          quint32 nativeModifiers, unsigned long time);
+
     /*!
      * \brief Register an input method attribute extension which is defined in \a fileName with the
      * unique identifier \a id.
@@ -339,8 +423,8 @@ Q_SIGNALS:
     void resetInputMethodRequest();
 
     void copyPasteStateChanged(bool copyAvailable, bool pasteAvailable);
-    void widgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
-                            const QMap<QString, QVariant> &oldState, bool focusChanged);
+    void widgetStateChanged(unsigned int clientId, const Maliit::WidgetState &newState,
+                            const Maliit::WidgetState &oldState, bool focusChanged);
 
     void attributeExtensionRegistered(unsigned int connectionId, int id, const QString &attributeExtension);
     void attributeExtensionUnregistered(unsigned int connectionId, int id);
@@ -351,6 +435,9 @@ Q_SIGNALS:
 
     void clientActivated(unsigned int connectionId);
     void clientDisconnected(unsigned int connectionId);
+    //! Emitted when an idle client released its resources and when it got them back, see setHibernationTimeout()
+    void clientHibernated(unsigned int connectionId);
+    void clientResumed(unsigned int connectionId);
     void activeClientDisconnected();
 
     void preeditChanged(const QString &text, int cursorPos);
@@ -360,35 +447,171 @@ Q_SIGNALS:
                          Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat,
                          int count, quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
 
+    //! Autorepeats coalesced by the application, see processKeyRepeat()
+    void receivedKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers, const QString &text,
+                           int repeats, bool releases, quint32 nativeScanCode,
+                           quint32 nativeModifiers, unsigned long time);
+
+    //! Answers to requestPreeditRectangle() and requestSelection()
+    void preeditRectangleReceived(int requestId, const QRect &rectangle, bool valid);
+    void selectionReceived(int requestId, const QString &selection, bool valid);
+    //! Answer to requestSurroundingText(), \a start is the absolute position of \a text
+    void surroundingTextReceived(int requestId, int start, const QString &text, bool valid);
+
 protected:
     unsigned int activeConnection; // 0 means no active connection
 
     bool detectableAutoRepeat();
     bool globalCorrectionEnabled();
     bool redirectKeysEnabled();
+    int surroundingTextWindow() const;
 
     void handleActivation(unsigned int connectionId);
 
-    QVariantMap widgetState() const;
+    const Maliit::WidgetState &widgetState() const;
+
+    //! Returns a new id for requestPreeditRectangle() and requestSelection()
+    int nextRequestId();
+
+    //! Reset epoch to tag commit and preedit messages to \a connectionId with, 0 before the first reset
+    quint32 resetEpoch(unsigned int connectionId) const;
 
 public:
     void handleDisconnection(unsigned int connectionId);
 
+    /*!
+     * \brief Merges widget state updates arriving within one frame into one widgetStateChanged().
+     *
+     * Applications changing their text programmatically may send many updates
+     * in a row, each of which makes plugins update. With coalescing enabled,
+     * updates are applied right away but widgetStateChanged() is only emitted
+     * once per frame, with the state before the first of them as old state.
+     * Focus changes, key events, show requests and client switches deliver a
+     * pending notification immediately. Disabled by default.
+     */
+    void setWidgetStateCoalescing(bool enabled);
+    bool widgetStateCoalescing() const;
+
+    /*!
+     * \brief Releases the resources of clients which were not active for \a timeout ms.
+     *
+     * Hibernated clients stay connected and get their resources back as soon
+     * as they are activated or the server has to send them something. 0, the
+     * default, keeps all clients resident. Not all connections support it.
+     */
+    virtual void setHibernationTimeout(int timeout);
+
+    //! Messages of one client held back by its quota, see setClientQuota()
+    struct ThrottleCounters {
+        //! Widget state notifications and extended attributes which had to wait for the quota
+        quint64 deferred;
+        //! Deferred messages replaced by a newer one before they were handled
+        quint64 coalesced;
+    };
+
+    /*!
+     * \brief Limits the rate of bulk messages handled for each client.
+     *
+     * Every client gets a bucket of \a burst tokens, refilled with
+     * \a messagesPerSecond tokens per second. Widget state notifications and
+     * extended attributes take one token each. Once a client runs out of
+     * tokens, its widget state is still applied right away, but the
+     * widgetStateChanged() waits for the next token and covers all updates
+     * received meanwhile. Its extended attributes are queued, keeping only the
+     * latest value of each attribute, and handled in order as tokens come
+     * back. Focus changes are never held back. 0, the default, disables the
+     * quota.
+     */
+    void setClientQuota(int messagesPerSecond, int burst);
+    ThrottleCounters throttleCounters(unsigned int connectionId) const;
+
+private Q_SLOTS:
+    //! Emits the widgetStateChanged() held back by coalescing, if any
+    void flushWidgetStateChange();
+    //! Emits the extendedAttributeChanged() held back by quotas whose tokens came back
+    void deliverDeferredAttributes();
+
 private:
     /*!
      * \brief get the X window id of the active app window. Warning: Undefined on non-X11 platforms
      */
     WId winId();
 
+    void setWidgetState(unsigned int connectionId,
+                        const Maliit::WidgetState &newState,
+                        bool focusChanged);
+
+    //! Keeps the widget state of the inactive client \a connectionId, see mCachedWidgetStates
+    void cacheWidgetState(unsigned int connectionId,
+                          const Maliit::WidgetState &state,
+                          unsigned int version);
+
+    struct ClientQuota;
+
+    //! Returns the quota of \a connectionId with the tokens earned since its last use added
+    ClientQuota &refilledQuota(unsigned int connectionId);
+    //! Takes one token from \a quota, returns in how many ms it is paid off, 0 if right away
+    int reserveQuotaToken(ClientQuota &quota) const;
+    int quotaDelay(const ClientQuota &quota) const;
+    //! Emits the extended attributes deferred for \a connectionId regardless of its quota
+    void flushDeferredAttributes(unsigned int connectionId);
+
 private:
+    struct CachedWidgetState {
+        Maliit::WidgetState state;
+        unsigned int version;
+    };
+
+    struct DeferredAttribute {
+        int id;
+        QString target;
+        QString targetName;
+        QString attribute;
+        QVariant value;
+    };
+
+    struct ClientQuota {
+        //! In thousandths of a message, negative while the next message waits for tokens
+        qint64 tokens;
+        qint64 refilledAt; // in ms of mQuotaClock
+        ThrottleCounters counters;
+        //! Extended attributes waiting for tokens, oldest first. The first one has its token reserved.
+        QList<DeferredAttribute> deferredAttributes;
+    };
+
     MInputContextConnectionPrivate *d;
     int lastOrientation;
 
     /* FIXME: rename with m prefix, and provide protected accessors for derived classes */
-    QMap<QString, QVariant> mWidgetState;
+    Maliit::WidgetState mWidgetState;
+    //! Widget state as last received, without the local edits done by sendCommitString() and sendKeyEvent()
+    Maliit::WidgetState mReceivedWidgetState;
+    unsigned int mWidgetStateVersion; // 0 means no valid base for deltas
+    //! Widget states of inactive clients, restored when they get activated again
+    QHash<unsigned int, CachedWidgetState> mCachedWidgetStates;
+    //! Clients in mCachedWidgetStates, least recently used first
+    QList<unsigned int> mCachedWidgetStateOrder;
+    int mLastRequestId;
     bool mGlobalCorrectionEnabled;
     bool mRedirectionEnabled;
     bool mDetectableAutoRepeat;
+    int mSurroundingTextWindow; // in characters, 0 means the whole text
+    bool mWidgetStateCoalescing;
+    QTimer mWidgetStateTimer;
+    //! Client and old state of the widgetStateChanged() held back, see setWidgetStateCoalescing()
+    bool mWidgetStateChangePending;
+    unsigned int mPendingWidgetStateClient;
+    Maliit::WidgetState mPendingOldWidgetState;
+    //! Whether the pending widgetStateChanged() waits for the quota of its client
+    bool mPendingWidgetStateThrottled;
+    int mQuotaRate; // in messages per second, 0 means no quota
+    int mQuotaBurst;
+    QElapsedTimer mQuotaClock;
+    QHash<unsigned int, ClientQuota> mClientQuotas;
+    //! Runs while extended attributes are deferred, until the next token of their client
+    QTimer mQuotaTimer;
+    //! Epoch of the last reset of each client, see reset()
+    QHash<unsigned int, quint32> mResetEpochs;
     QString preedit;
 };
 //! \internal_end
@@ -16,6 +16,8 @@
 
 #include <QDebug>
 #include <QDBusConnection>
+#include <QFile>
+#include <QSaveFile>
 
 #include <QDBusServer>
 
@@ -24,6 +26,10 @@
 namespace {
     const char * const MaliitServerName = "org.maliit.server";
     const char * const MaliitServerObjectPath = "/org/maliit/server/address";
+
+    // In $XDG_RUNTIME_DIR, see Maliit::InputContext::DBus::DynamicAddress.
+    // Not maliit-server, which is where the README puts the Unix socket.
+    const char * const AddressFileName = "maliit-server-dbus-address";
 }
 
 namespace Maliit {
@@ -39,13 +45,61 @@ AddressPublisher::AddressPublisher(const QString &address)
         qWarning("maliit-server is already running");
         std::exit(0);
     }
+
+    // Only written once the name is ours, a second server must not replace it
+    writeAddressFile(mAddress);
 }
 
 AddressPublisher::~AddressPublisher()
 {
+    removeAddressFile(mAddress);
     QDBusConnection::sessionBus().unregisterObject(MaliitServerObjectPath);
 }
 
+QString AddressPublisher::addressFilePath()
+{
+    const QByteArray runtimeDirectory = qgetenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory.isEmpty()) {
+        return QString();
+    }
+    return QString::fromLocal8Bit(runtimeDirectory) + QLatin1Char('/') + QLatin1String(AddressFileName);
+}
+
+bool AddressPublisher::writeAddressFile(const QString &address)
+{
+    const QString path = addressFilePath();
+    if (path.isEmpty()) {
+        return false;
+    }
+
+    // Replaced in one go, applications never read half an address
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(address.toUtf8()) < 0
+        || !file.commit()) {
+        qWarning() << __PRETTY_FUNCTION__ << "cannot write" << path << file.errorString();
+        return false;
+    }
+
+    // $XDG_RUNTIME_DIR is private to the user already, the file is too
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+    return true;
+}
+
+void AddressPublisher::removeAddressFile(const QString &address)
+{
+    const QString path = addressFilePath();
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly) && QString::fromUtf8(file.readAll()) == address) {
+        file.close();
+        file.remove();
+    }
+}
+
 QString AddressPublisher::address() const
 {
     return mAddress;
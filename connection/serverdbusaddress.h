@@ -24,6 +24,13 @@ namespace Maliit {
 namespace Server {
 namespace DBus {
 
+/*!
+ * \brief Publishes the address of the server on the session bus.
+ *
+ * The address is also written to maliit-server-dbus-address in
+ * $XDG_RUNTIME_DIR, so applications can connect without asking the
+ * session bus first.
+ */
 class AddressPublisher : public QObject
 {
     Q_OBJECT
@@ -36,7 +43,15 @@ public:
     ~AddressPublisher();
     QString address() const;
 
+    //! Path of the address file, empty without $XDG_RUNTIME_DIR
+    static QString addressFilePath();
+    //! Replaces the address file with one holding \a address
+    static bool writeAddressFile(const QString &address);
+    //! Removes the address file if it still holds \a address, another server may have replaced it
+    static void removeAddressFile(const QString &address);
+
 private:
+
     const QString mAddress;
 };
 
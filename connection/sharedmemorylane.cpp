@@ -0,0 +1,289 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "sharedmemorylane.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+struct SharedMemoryLaneHeader
+{
+    // Positions grow monotonically and wrap at 2^32, the capacity is a
+    // power of two so the difference is always the number of used bytes.
+    // Each position lives on its own cache line to avoid false sharing.
+    QBasicAtomicInteger<quint32> writePosition;
+    char writePadding[64 - sizeof(quint32)];
+    QBasicAtomicInteger<quint32> readPosition;
+    char readPadding[64 - sizeof(quint32)];
+};
+
+namespace {
+    struct MessageHeader
+    {
+        quint32 size;
+        quint32 controlSerial;
+    };
+
+    bool isPowerOfTwo(quint32 value)
+    {
+        return value && !(value & (value - 1));
+    }
+}
+
+SharedMemoryLane *SharedMemoryLane::create(quint32 capacity)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+    if (!isPowerOfTwo(capacity)) {
+        qWarning() << __PRETTY_FUNCTION__ << "capacity has to be a power of two:" << capacity;
+        return 0;
+    }
+
+    const size_t length = sizeof(SharedMemoryLaneHeader) + capacity;
+
+    const int memoryFd = syscall(SYS_memfd_create, "maliit-shared-memory-lane", 1 /* MFD_CLOEXEC */);
+    if (memoryFd < 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "memfd_create failed:" << strerror(errno);
+        return 0;
+    }
+
+    if (ftruncate(memoryFd, length) != 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "ftruncate failed:" << strerror(errno);
+        close(memoryFd);
+        return 0;
+    }
+
+    void *memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    if (memory == MAP_FAILED) {
+        qWarning() << __PRETTY_FUNCTION__ << "mmap failed:" << strerror(errno);
+        close(memoryFd);
+        return 0;
+    }
+
+    const int eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (eventFd < 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "eventfd failed:" << strerror(errno);
+        munmap(memory, length);
+        close(memoryFd);
+        return 0;
+    }
+
+    // memory of a fresh memfd is zero filled, so both positions start at 0
+    return new SharedMemoryLane(memoryFd, eventFd, capacity, memory);
+#else
+    Q_UNUSED(capacity);
+    return 0;
+#endif
+}
+
+SharedMemoryLane *SharedMemoryLane::attach(int memoryFd, int eventFd, quint32 capacity)
+{
+#ifdef Q_OS_LINUX
+    if (!isPowerOfTwo(capacity)) {
+        qWarning() << __PRETTY_FUNCTION__ << "capacity has to be a power of two:" << capacity;
+        return 0;
+    }
+
+    const size_t length = sizeof(SharedMemoryLaneHeader) + capacity;
+
+    struct stat info;
+    if (fstat(memoryFd, &info) != 0 || static_cast<size_t>(info.st_size) < length) {
+        qWarning() << __PRETTY_FUNCTION__ << "shared memory is too small";
+        return 0;
+    }
+
+    const int ownMemoryFd = fcntl(memoryFd, F_DUPFD_CLOEXEC, 0);
+    const int ownEventFd = fcntl(eventFd, F_DUPFD_CLOEXEC, 0);
+    if (ownMemoryFd < 0 || ownEventFd < 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "could not duplicate file descriptors:" << strerror(errno);
+        if (ownMemoryFd >= 0)
+            close(ownMemoryFd);
+        if (ownEventFd >= 0)
+            close(ownEventFd);
+        return 0;
+    }
+
+    fcntl(ownEventFd, F_SETFL, fcntl(ownEventFd, F_GETFL) | O_NONBLOCK);
+
+    void *memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, ownMemoryFd, 0);
+    if (memory == MAP_FAILED) {
+        qWarning() << __PRETTY_FUNCTION__ << "mmap failed:" << strerror(errno);
+        close(ownMemoryFd);
+        close(ownEventFd);
+        return 0;
+    }
+
+    return new SharedMemoryLane(ownMemoryFd, ownEventFd, capacity, memory);
+#else
+    Q_UNUSED(memoryFd);
+    Q_UNUSED(eventFd);
+    Q_UNUSED(capacity);
+    return 0;
+#endif
+}
+
+SharedMemoryLane::SharedMemoryLane(int memoryFd, int eventFd, quint32 capacity, void *memory)
+    : mMemoryFd(memoryFd)
+    , mEventFd(eventFd)
+    , mCapacity(capacity)
+    , mHeader(static_cast<SharedMemoryLaneHeader *>(memory))
+    , mData(static_cast<char *>(memory) + sizeof(SharedMemoryLaneHeader))
+    , mBroken(false)
+{}
+
+SharedMemoryLane::~SharedMemoryLane()
+{
+#ifdef Q_OS_LINUX
+    munmap(mHeader, sizeof(SharedMemoryLaneHeader) + mCapacity);
+    close(mMemoryFd);
+    close(mEventFd);
+#endif
+}
+
+int SharedMemoryLane::memoryFd() const
+{
+    return mMemoryFd;
+}
+
+int SharedMemoryLane::eventFd() const
+{
+    return mEventFd;
+}
+
+quint32 SharedMemoryLane::capacity() const
+{
+    return mCapacity;
+}
+
+bool SharedMemoryLane::write(const QByteArray &message, quint32 controlSerial)
+{
+    const quint32 size = sizeof(MessageHeader) + message.size();
+    const quint32 writePosition = mHeader->writePosition.load();
+    const quint32 used = writePosition - mHeader->readPosition.loadAcquire();
+
+    if (mBroken) {
+        return false;
+    }
+
+    // The reader controls its position, never trust it to be behind ours
+    if (used > mCapacity) {
+        qWarning() << __PRETTY_FUNCTION__ << "corrupted shared memory lane, ignoring it";
+        mBroken = true;
+        return false;
+    }
+
+    if (size > mCapacity - used) {
+        return false;
+    }
+
+    MessageHeader header;
+    header.size = message.size();
+    header.controlSerial = controlSerial;
+
+    copyIn(writePosition, reinterpret_cast<const char *>(&header), sizeof(header));
+    copyIn(writePosition + sizeof(header), message.constData(), message.size());
+
+    mHeader->writePosition.storeRelease(writePosition + size);
+
+#ifdef Q_OS_LINUX
+    const quint64 doorbell = 1;
+    if (::write(mEventFd, &doorbell, sizeof(doorbell)) != sizeof(doorbell)) {
+        // Counter overflow can only happen when the reader is gone, it
+        // still finds the message on the next wake up.
+    }
+#endif
+
+    return true;
+}
+
+bool SharedMemoryLane::read(QByteArray *message, quint32 controlSerial)
+{
+    const quint32 readPosition = mHeader->readPosition.load();
+    const quint32 available = mHeader->writePosition.loadAcquire() - readPosition;
+
+    if (mBroken || available == 0) {
+        return false;
+    }
+
+    MessageHeader header;
+    if (available > mCapacity || available < sizeof(header)) {
+        mBroken = true;
+    } else {
+        copyOut(readPosition, reinterpret_cast<char *>(&header), sizeof(header));
+        if (header.size > available - sizeof(header)) {
+            mBroken = true;
+        }
+    }
+
+    if (mBroken) {
+        qWarning() << __PRETTY_FUNCTION__ << "corrupted shared memory lane, ignoring it";
+        return false;
+    }
+
+    // Wait until the D-Bus messages sent before this one were handled
+    if (static_cast<qint32>(header.controlSerial - controlSerial) > 0) {
+        return false;
+    }
+
+    message->resize(header.size);
+    copyOut(readPosition + sizeof(header), message->data(), header.size);
+
+    mHeader->readPosition.storeRelease(readPosition + sizeof(header) + header.size);
+
+    return true;
+}
+
+bool SharedMemoryLane::hasPending() const
+{
+    return !mBroken
+        && mHeader->writePosition.loadAcquire() != mHeader->readPosition.load();
+}
+
+void SharedMemoryLane::clearDoorbell()
+{
+#ifdef Q_OS_LINUX
+    quint64 value;
+    if (::read(mEventFd, &value, sizeof(value)) != sizeof(value)) {
+        // EAGAIN, nothing was pending
+    }
+#endif
+}
+
+void SharedMemoryLane::copyIn(quint32 position, const char *data, quint32 size)
+{
+    const quint32 offset = position & (mCapacity - 1);
+    const quint32 first = qMin(size, mCapacity - offset);
+
+    memcpy(mData + offset, data, first);
+    memcpy(mData, data + first, size - first);
+}
+
+void SharedMemoryLane::copyOut(quint32 position, char *data, quint32 size) const
+{
+    const quint32 offset = position & (mCapacity - 1);
+    const quint32 first = qMin(size, mCapacity - offset);
+
+    memcpy(data, mData + offset, first);
+    memcpy(data + first, mData, size - first);
+}
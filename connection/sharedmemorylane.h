@@ -0,0 +1,75 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef SHAREDMEMORYLANE_H
+#define SHAREDMEMORYLANE_H
+
+#include <QByteArray>
+
+struct SharedMemoryLaneHeader;
+
+/*! \internal
+ * \brief Single producer, single consumer message ring in shared memory.
+ *
+ * The input method server creates the lane and passes memoryFd() and eventFd()
+ * to the application, which attaches to the same memory. Writing a message
+ * signals the event fd, so the reader can wait for it in its main loop.
+ *
+ * Every message is tagged with the number of D-Bus messages the writer sent
+ * before it. The reader only hands out a message once it has seen that many
+ * D-Bus messages, which keeps the order between both transports.
+ *
+ * Only available on Linux; create() returns 0 elsewhere.
+ */
+class SharedMemoryLane
+{
+public:
+    //! Creates a new lane with room for \a capacity bytes, which must be a power of two.
+    static SharedMemoryLane *create(quint32 capacity);
+    //! Attaches to a lane created by the other side. The file descriptors are duplicated.
+    static SharedMemoryLane *attach(int memoryFd, int eventFd, quint32 capacity);
+
+    ~SharedMemoryLane();
+
+    int memoryFd() const;
+    int eventFd() const;
+    quint32 capacity() const;
+
+    //! Appends \a message, returns false if there is not enough room.
+    bool write(const QByteArray &message, quint32 controlSerial);
+
+    //! Takes the next message if its control serial is not greater than \a controlSerial.
+    bool read(QByteArray *message, quint32 controlSerial);
+
+    //! Returns true if there are unread messages.
+    bool hasPending() const;
+
+    //! Resets the event fd after it signalled readability.
+    void clearDoorbell();
+
+private:
+    SharedMemoryLane(int memoryFd, int eventFd, quint32 capacity, void *memory);
+    Q_DISABLE_COPY(SharedMemoryLane)
+
+    void copyIn(quint32 position, const char *data, quint32 size);
+    void copyOut(quint32 position, char *data, quint32 size) const;
+
+    int mMemoryFd;
+    int mEventFd;
+    quint32 mCapacity;
+    SharedMemoryLaneHeader *mHeader;
+    char *mData;
+    bool mBroken;
+};
+
+#endif // SHAREDMEMORYLANE_H
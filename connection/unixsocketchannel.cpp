@@ -0,0 +1,170 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "unixsocketchannel.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QPointer>
+#include <QSocketNotifier>
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+UnixSocketChannel::UnixSocketChannel(int fd, QObject *parent)
+    : QObject(parent)
+    , mFd(fd)
+    , mReadNotifier(new QSocketNotifier(fd, QSocketNotifier::Read, this))
+    , mWriteNotifier(new QSocketNotifier(fd, QSocketNotifier::Write, this))
+    , mPendingFrames()
+{
+    mWriteNotifier->setEnabled(false);
+
+    connect(mReadNotifier, SIGNAL(activated(int)), this, SLOT(readFrames()));
+    connect(mWriteNotifier, SIGNAL(activated(int)), this, SLOT(writePendingFrames()));
+}
+
+UnixSocketChannel::~UnixSocketChannel()
+{
+    close();
+}
+
+UnixSocketChannel *UnixSocketChannel::connectTo(const QString &path, QObject *parent)
+{
+    const QByteArray encodedPath = QFile::encodeName(path);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (encodedPath.size() >= int(sizeof(address.sun_path))) {
+        qWarning() << __PRETTY_FUNCTION__ << "socket path is too long:" << path;
+        return 0;
+    }
+    memcpy(address.sun_path, encodedPath.constData(), encodedPath.size());
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "socket failed:" << strerror(errno);
+        return 0;
+    }
+
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        // the server is not running (yet), not worth a warning
+        ::close(fd);
+        return 0;
+    }
+
+    return new UnixSocketChannel(fd, parent);
+}
+
+bool UnixSocketChannel::isOpen() const
+{
+    return mFd >= 0;
+}
+
+int UnixSocketChannel::peerUid() const
+{
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (mFd < 0 || getsockopt(mFd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return -1;
+    }
+    return credentials.uid;
+}
+
+void UnixSocketChannel::send(const QByteArray &frame)
+{
+    if (mFd < 0)
+        return;
+
+    // keep the order if earlier frames are still waiting
+    if (mPendingFrames.isEmpty() && sendNow(frame))
+        return;
+
+    if (mFd >= 0) {
+        mPendingFrames.append(frame);
+        mWriteNotifier->setEnabled(true);
+    }
+}
+
+bool UnixSocketChannel::sendNow(const QByteArray &frame)
+{
+    const ssize_t sent = ::send(mFd, frame.constData(), frame.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == frame.size())
+        return true;
+
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return false;
+
+    if (sent < 0 && errno != EPIPE && errno != ECONNRESET) {
+        qWarning() << __PRETTY_FUNCTION__ << "send failed:" << strerror(errno);
+    }
+    close();
+    Q_EMIT closed();
+    return false;
+}
+
+void UnixSocketChannel::writePendingFrames()
+{
+    while (!mPendingFrames.isEmpty() && sendNow(mPendingFrames.first())) {
+        mPendingFrames.removeFirst();
+    }
+
+    if (mFd >= 0 && mPendingFrames.isEmpty()) {
+        mWriteNotifier->setEnabled(false);
+    }
+}
+
+void UnixSocketChannel::readFrames()
+{
+    // the handlers of frameReceived() might close the channel
+    QPointer<UnixSocketChannel> guard(this);
+
+    while (guard && mFd >= 0) {
+        const ssize_t size = recv(mFd, 0, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+
+        if (size <= 0) {
+            // zero means the other end closed the socket, frames are never empty
+            close();
+            Q_EMIT closed();
+            return;
+        }
+
+        QByteArray frame(size, Qt::Uninitialized);
+        if (recv(mFd, frame.data(), size, MSG_DONTWAIT) != size) {
+            qWarning() << __PRETTY_FUNCTION__ << "recv failed:" << strerror(errno);
+            close();
+            Q_EMIT closed();
+            return;
+        }
+
+        Q_EMIT frameReceived(frame);
+    }
+}
+
+void UnixSocketChannel::close()
+{
+    if (mFd < 0)
+        return;
+
+    mReadNotifier->setEnabled(false);
+    mWriteNotifier->setEnabled(false);
+    mPendingFrames.clear();
+    ::close(mFd);
+    mFd = -1;
+}
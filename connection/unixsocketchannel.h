@@ -0,0 +1,73 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UNIXSOCKETCHANNEL_H
+#define UNIXSOCKETCHANNEL_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+
+class QSocketNotifier;
+
+/*! \internal
+ * \brief One end of a SOCK_SEQPACKET Unix socket, carrying one frame per packet.
+ *
+ * The socket keeps the packet boundaries, so frames never need to be
+ * reassembled. Frames which can not be sent right away are queued until the
+ * socket is writable again, the event loop is never blocked by a slow peer.
+ */
+class UnixSocketChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Takes ownership of the connected socket \a fd
+    explicit UnixSocketChannel(int fd, QObject *parent = 0);
+    ~UnixSocketChannel();
+
+    //! Connects to the listening socket at \a path, returns 0 on failure
+    static UnixSocketChannel *connectTo(const QString &path, QObject *parent = 0);
+
+    bool isOpen() const;
+
+    //! Returns the user id of the process on the other end, or -1 if unknown
+    int peerUid() const;
+
+    void send(const QByteArray &frame);
+
+    void close();
+
+Q_SIGNALS:
+    void frameReceived(const QByteArray &frame);
+
+    //! Emitted once the other end went away; delete the channel with deleteLater()
+    void closed();
+
+private Q_SLOTS:
+    void readFrames();
+    void writePendingFrames();
+
+private:
+    Q_DISABLE_COPY(UnixSocketChannel)
+
+    //! Sends \a frame without blocking, returns false if it has to be retried later
+    bool sendNow(const QByteArray &frame);
+
+    int mFd;
+    QSocketNotifier *mReadNotifier;
+    QSocketNotifier *mWriteNotifier;
+    QList<QByteArray> mPendingFrames;
+};
+
+#endif // UNIXSOCKETCHANNEL_H
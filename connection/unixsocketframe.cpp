@@ -0,0 +1,109 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "unixsocketframe.h"
+
+#include <maliit/settingdata.h>
+
+#include <QtEndian>
+
+namespace {
+    const QDataStream::Version StreamVersion = QDataStream::Qt_5_0;
+
+    void initStream(QDataStream &stream)
+    {
+        stream.setVersion(StreamVersion);
+        stream.setByteOrder(QDataStream::LittleEndian);
+    }
+}
+
+namespace Maliit {
+namespace UnixSocket {
+
+FrameWriter::FrameWriter(Method method)
+    : mFrame()
+    , mStream(&mFrame, QIODevice::WriteOnly)
+{
+    initStream(mStream);
+    // the payload size is filled in by frame()
+    mStream << quint16(method) << quint16(0) << quint32(0);
+}
+
+QByteArray FrameWriter::frame()
+{
+    qToLittleEndian<quint32>(mFrame.size() - FrameHeaderSize,
+                             reinterpret_cast<uchar *>(mFrame.data()) + 4);
+    return mFrame;
+}
+
+FrameReader::FrameReader(const QByteArray &frame)
+    : mFrame(frame)
+    , mStream(mFrame)
+    , mMethod(Method(0))
+    , mHeaderValid(false)
+{
+    initStream(mStream);
+
+    quint16 method, reserved;
+    quint32 size;
+    mStream >> method >> reserved >> size;
+
+    mMethod = static_cast<Method>(method);
+    mHeaderValid = mStream.status() == QDataStream::Ok
+                   && size == quint32(mFrame.size() - FrameHeaderSize);
+}
+
+bool FrameReader::isValid() const
+{
+    return mHeaderValid && mStream.status() == QDataStream::Ok;
+}
+
+Method FrameReader::method() const
+{
+    return mMethod;
+}
+
+} // namespace UnixSocket
+} // namespace Maliit
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsEntry &entry)
+{
+    stream << entry.description << entry.extension_key << qint32(entry.type)
+           << entry.value << entry.attributes;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsEntry &entry)
+{
+    qint32 type;
+    stream >> entry.description >> entry.extension_key >> type
+           >> entry.value >> entry.attributes;
+    entry.type = static_cast<Maliit::SettingEntryType>(type);
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsInfo &info)
+{
+    stream << info.description_language << info.plugin_name << info.plugin_description
+           << qint32(info.extension_id) << info.entries;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsInfo &info)
+{
+    qint32 extensionId;
+    stream >> info.description_language >> info.plugin_name >> info.plugin_description
+           >> extensionId >> info.entries;
+    info.extension_id = extensionId;
+    return stream;
+}
@@ -0,0 +1,137 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UNIXSOCKETFRAME_H
+#define UNIXSOCKETFRAME_H
+
+#include <QByteArray>
+#include <QDataStream>
+
+struct MImPluginSettingsEntry;
+struct MImPluginSettingsInfo;
+
+namespace Maliit {
+namespace UnixSocket {
+
+/*! \internal
+ * \brief Methods of the Unix socket connection, one frame each.
+ *
+ * Every frame starts with a fixed 8 byte header: the method as 16 bit
+ * integer, 16 reserved bits and the size of the payload as 32 bit integer,
+ * all in little endian. The payload holds the method arguments in a fixed
+ * order. Both sides are always built from the same sources.
+ */
+enum Method {
+    // application to server
+    ActivateContext = 1,
+    ShowInputMethod,
+    HideInputMethod,
+    MouseClickedOnPreedit,
+    SetPreedit,
+    UpdateWidgetInformation,
+    Reset,
+    AppOrientationAboutToChange,
+    AppOrientationChanged,
+    SetCopyPasteState,
+    ProcessKeyEvent,
+    RegisterAttributeExtension,
+    UnregisterAttributeExtension,
+    SetExtendedAttribute,
+    LoadPluginSettings,
+    PreeditRectangleReply,
+    SelectionReply,
+    SurroundingTextReply,
+    //! The application could not apply a preedit delta, see MImServerConnection::discardPreeditBase()
+    ResyncPreedit,
+
+    // server to application
+    ActivationLostEvent = 64,
+    ImInitiatedHide,
+    //! Commit, preedit and key events, encoded as in Maliit::InputContextMessage
+    EncodedMessage,
+    UpdateInputMethodArea,
+    SetGlobalCorrectionEnabled,
+    SetRedirectKeys,
+    SetDetectableAutoRepeat,
+    SetSelection,
+    SetLanguage,
+    ExtendedAttributeChanged,
+    PluginSettingsLoaded,
+    InvokeAction,
+    PreeditRectangleRequest,
+    SelectionRequest,
+    SetSurroundingTextWindow,
+    SurroundingTextRequest
+};
+
+//! Size of the fixed frame header, in bytes
+const int FrameHeaderSize = 8;
+
+//! Builds a single frame for \a method, arguments are appended with operator<<
+class FrameWriter
+{
+public:
+    explicit FrameWriter(Method method);
+
+    template <typename T>
+    FrameWriter &operator<<(const T &value)
+    {
+        mStream << value;
+        return *this;
+    }
+
+    //! Returns the complete frame, including the header
+    QByteArray frame();
+
+private:
+    Q_DISABLE_COPY(FrameWriter)
+
+    QByteArray mFrame;
+    QDataStream mStream;
+};
+
+//! Reads the arguments of a frame built by FrameWriter
+class FrameReader
+{
+public:
+    explicit FrameReader(const QByteArray &frame);
+
+    //! Returns false if the header is malformed or an argument could not be read
+    bool isValid() const;
+    Method method() const;
+
+    template <typename T>
+    FrameReader &operator>>(T &value)
+    {
+        mStream >> value;
+        return *this;
+    }
+
+private:
+    Q_DISABLE_COPY(FrameReader)
+
+    const QByteArray mFrame;
+    QDataStream mStream;
+    Method mMethod;
+    bool mHeaderValid;
+};
+
+} // namespace UnixSocket
+} // namespace Maliit
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsEntry &entry);
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsEntry &entry);
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsInfo &info);
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsInfo &info);
+
+#endif // UNIXSOCKETFRAME_H
@@ -0,0 +1,567 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "unixsocketinputcontextconnection.h"
+
+#include "unixsocketchannel.h"
+#include "unixsocketframe.h"
+#include "inputcontextmessages.h"
+
+#include <maliit/settingdata.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QKeyEvent>
+#include <QSocketNotifier>
+
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace Maliit::UnixSocket;
+
+namespace
+{
+
+const int ListenBacklog = 16;
+
+}
+
+UnixSocketInputContextConnection::UnixSocketInputContextConnection(const QString &socketPath)
+    : MInputContextConnection(0)
+    , mSocketPath(socketPath)
+    , mListenFd(-1)
+    , mListenNotifier(0)
+    , mChannels()
+    , mConnectionNumbers()
+    , mPreeditRectangleRequests()
+    , mSelectionRequests()
+    , mSurroundingTextRequests()
+    , mPreeditBases()
+    , lastLanguage()
+{
+    listen();
+}
+
+UnixSocketInputContextConnection::~UnixSocketInputContextConnection()
+{
+    if (mListenFd >= 0) {
+        delete mListenNotifier;
+        ::close(mListenFd);
+        unlink(QFile::encodeName(mSocketPath).constData());
+    }
+    qDeleteAll(mChannels);
+}
+
+void
+UnixSocketInputContextConnection::listen()
+{
+    const QByteArray encodedPath = QFile::encodeName(mSocketPath);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (encodedPath.size() >= int(sizeof(address.sun_path))) {
+        qWarning() << __PRETTY_FUNCTION__ << "socket path is too long:" << mSocketPath;
+        return;
+    }
+    memcpy(address.sun_path, encodedPath.constData(), encodedPath.size());
+
+    // A socket left behind by a crashed server is replaced, a running server is not
+    UnixSocketChannel *running = UnixSocketChannel::connectTo(mSocketPath);
+    if (running) {
+        delete running;
+        qWarning() << __PRETTY_FUNCTION__ << "another server is listening on" << mSocketPath;
+        return;
+    }
+    unlink(encodedPath.constData());
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "socket failed:" << strerror(errno);
+        return;
+    }
+
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(fd, ListenBacklog) != 0) {
+        qWarning() << __PRETTY_FUNCTION__ << "could not listen on" << mSocketPath << ":" << strerror(errno);
+        ::close(fd);
+        return;
+    }
+
+    mListenFd = fd;
+    mListenNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(mListenNotifier, SIGNAL(activated(int)), this, SLOT(acceptConnections()));
+}
+
+void
+UnixSocketInputContextConnection::acceptConnections()
+{
+    Q_FOREVER {
+        const int fd = accept4(mListenFd, 0, 0, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                qWarning() << __PRETTY_FUNCTION__ << "accept failed:" << strerror(errno);
+            }
+            return;
+        }
+
+        UnixSocketChannel *channel = new UnixSocketChannel(fd, this);
+
+        // Same policy as the D-Bus peer-to-peer server: only the same user may connect
+        if (channel->peerUid() != int(getuid())) {
+            qWarning() << __PRETTY_FUNCTION__ << "rejecting connection from user" << channel->peerUid();
+            delete channel;
+            continue;
+        }
+
+        static unsigned int connectionCounter = 1; // Start at 1 so 0 can be used as a sentinel value
+        const unsigned int connectionNumber = connectionCounter++;
+
+        mChannels.insert(connectionNumber, channel);
+        mConnectionNumbers.insert(channel, connectionNumber);
+
+        connect(channel, SIGNAL(frameReceived(QByteArray)), this, SLOT(handleFrame(QByteArray)));
+        connect(channel, SIGNAL(closed()), this, SLOT(onDisconnection()));
+
+        send(connectionNumber, (FrameWriter(SetLanguage) << lastLanguage).frame());
+    }
+}
+
+void
+UnixSocketInputContextConnection::onDisconnection()
+{
+    UnixSocketChannel *channel = qobject_cast<UnixSocketChannel *>(sender());
+    const unsigned int connectionNumber = mConnectionNumbers.take(channel);
+    if (!connectionNumber)
+        return;
+
+    mChannels.remove(connectionNumber);
+    mPreeditBases.remove(connectionNumber);
+    channel->deleteLater();
+
+    // unanswered requests fail, as they would over D-Bus
+    Q_FOREACH (int requestId, mPreeditRectangleRequests.keys(connectionNumber)) {
+        mPreeditRectangleRequests.remove(requestId);
+        Q_EMIT preeditRectangleReceived(requestId, QRect(), false);
+    }
+    Q_FOREACH (int requestId, mSelectionRequests.keys(connectionNumber)) {
+        mSelectionRequests.remove(requestId);
+        Q_EMIT selectionReceived(requestId, QString(), false);
+    }
+    Q_FOREACH (int requestId, mSurroundingTextRequests.keys()) {
+        if (mSurroundingTextRequests.value(requestId).first == connectionNumber) {
+            const int start = mSurroundingTextRequests.take(requestId).second;
+            Q_EMIT surroundingTextReceived(requestId, start, QString(), false);
+        }
+    }
+
+    handleDisconnection(connectionNumber);
+}
+
+void
+UnixSocketInputContextConnection::handleFrame(const QByteArray &frame)
+{
+    UnixSocketChannel *channel = qobject_cast<UnixSocketChannel *>(sender());
+    const unsigned int connectionNumber = mConnectionNumbers.value(channel);
+    if (connectionNumber) {
+        dispatch(connectionNumber, frame);
+    }
+}
+
+void
+UnixSocketInputContextConnection::send(unsigned int clientId, const QByteArray &frame)
+{
+    UnixSocketChannel *channel = mChannels.value(clientId);
+    if (channel) {
+        channel->send(frame);
+    }
+}
+
+void
+UnixSocketInputContextConnection::dispatch(unsigned int clientId, const QByteArray &frame)
+{
+    FrameReader reader(frame);
+    if (!reader.isValid()) {
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed frame";
+        return;
+    }
+
+    switch (reader.method()) {
+    case ActivateContext:
+        activateContext(clientId);
+        break;
+
+    case ShowInputMethod:
+        showInputMethod(clientId);
+        break;
+
+    case HideInputMethod:
+        hideInputMethod(clientId);
+        break;
+
+    case MouseClickedOnPreedit: {
+        QPoint pos;
+        QRect preeditRect;
+        reader >> pos >> preeditRect;
+        if (reader.isValid())
+            mouseClickedOnPreedit(clientId, pos, preeditRect);
+        break;
+    }
+
+    case SetPreedit: {
+        QString text;
+        qint32 cursorPos;
+        reader >> text >> cursorPos;
+        if (reader.isValid())
+            setPreedit(clientId, text, cursorPos);
+        break;
+    }
+
+    case UpdateWidgetInformation: {
+        QVariantMap stateInformation;
+        bool focusChanged;
+        reader >> stateInformation >> focusChanged;
+        if (reader.isValid())
+            updateWidgetInformation(clientId, stateInformation, focusChanged);
+        break;
+    }
+
+    case Reset: {
+        quint32 epoch;
+        reader >> epoch;
+        if (reader.isValid())
+            reset(clientId, epoch);
+        break;
+    }
+
+    case AppOrientationAboutToChange: {
+        qint32 angle;
+        reader >> angle;
+        if (reader.isValid())
+            receivedAppOrientationAboutToChange(clientId, angle);
+        break;
+    }
+
+    case AppOrientationChanged: {
+        qint32 angle;
+        reader >> angle;
+        if (reader.isValid())
+            receivedAppOrientationChanged(clientId, angle);
+        break;
+    }
+
+    case SetCopyPasteState: {
+        bool copyAvailable, pasteAvailable;
+        reader >> copyAvailable >> pasteAvailable;
+        if (reader.isValid())
+            setCopyPasteState(clientId, copyAvailable, pasteAvailable);
+        break;
+    }
+
+    case ProcessKeyEvent: {
+        qint32 keyType, keyCode, modifiers, count;
+        QString text;
+        bool autoRepeat;
+        quint32 nativeScanCode, nativeModifiers;
+        quint64 time;
+        reader >> keyType >> keyCode >> modifiers >> text >> autoRepeat >> count
+               >> nativeScanCode >> nativeModifiers >> time;
+        if (reader.isValid())
+            processKeyEvent(clientId, static_cast<QEvent::Type>(keyType), static_cast<Qt::Key>(keyCode),
+                            static_cast<Qt::KeyboardModifier>(modifiers), text, autoRepeat, count,
+                            nativeScanCode, nativeModifiers, time);
+        break;
+    }
+
+    case RegisterAttributeExtension: {
+        qint32 id;
+        QString fileName;
+        reader >> id >> fileName;
+        if (reader.isValid())
+            registerAttributeExtension(clientId, id, fileName);
+        break;
+    }
+
+    case UnregisterAttributeExtension: {
+        qint32 id;
+        reader >> id;
+        if (reader.isValid())
+            unregisterAttributeExtension(clientId, id);
+        break;
+    }
+
+    case SetExtendedAttribute: {
+        qint32 id;
+        QString target, targetItem, attribute;
+        QVariant value;
+        reader >> id >> target >> targetItem >> attribute >> value;
+        if (reader.isValid())
+            setExtendedAttribute(clientId, id, target, targetItem, attribute, value);
+        break;
+    }
+
+    case LoadPluginSettings: {
+        QString descriptionLanguage;
+        reader >> descriptionLanguage;
+        if (reader.isValid())
+            loadPluginSettings(clientId, descriptionLanguage);
+        break;
+    }
+
+    case PreeditRectangleReply: {
+        qint32 requestId;
+        bool valid;
+        QRect rectangle;
+        reader >> requestId >> valid >> rectangle;
+        if (reader.isValid() && mPreeditRectangleRequests.value(requestId) == clientId) {
+            mPreeditRectangleRequests.remove(requestId);
+            Q_EMIT preeditRectangleReceived(requestId, valid ? rectangle : QRect(), valid);
+        }
+        break;
+    }
+
+    case SelectionReply: {
+        qint32 requestId;
+        bool valid;
+        QString selection;
+        reader >> requestId >> valid >> selection;
+        if (reader.isValid() && mSelectionRequests.value(requestId) == clientId) {
+            mSelectionRequests.remove(requestId);
+            Q_EMIT selectionReceived(requestId, valid ? selection : QString(), valid);
+        }
+        break;
+    }
+
+    case SurroundingTextReply: {
+        qint32 requestId;
+        bool valid;
+        QString text;
+        reader >> requestId >> valid >> text;
+        if (reader.isValid() && mSurroundingTextRequests.value(requestId).first == clientId) {
+            const int start = mSurroundingTextRequests.take(requestId).second;
+            Q_EMIT surroundingTextReceived(requestId, start, valid ? text : QString(), valid);
+        }
+        break;
+    }
+
+    case ResyncPreedit:
+        // The next preedit is sent in full, see sendPreeditString()
+        mPreeditBases.remove(clientId);
+        break;
+
+    default:
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring unknown method" << reader.method();
+        return;
+    }
+
+    if (!reader.isValid()) {
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed frame for method" << reader.method();
+    }
+}
+
+void
+UnixSocketInputContextConnection::sendPreeditString(const QString &string,
+                                                    const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                                    int replacementStart, int replacementLength,
+                                                    int cursorPos)
+{
+    if (activeConnection) {
+        MInputContextConnection::sendPreeditString(string, preeditFormats, replacementStart, replacementLength, cursorPos);
+        send(activeConnection,
+             (FrameWriter(EncodedMessage)
+              << Maliit::InputContextMessage::encodeUpdatePreedit(&mPreeditBases[activeConnection],
+                                                                   string, preeditFormats,
+                                                                   replacementStart, replacementLength,
+                                                                   cursorPos, resetEpoch(activeConnection))).frame());
+    }
+}
+
+void
+UnixSocketInputContextConnection::sendCommitString(const QString &string, int replaceStart,
+                                                   int replaceLength, int cursorPos)
+{
+    if (activeConnection) {
+        MInputContextConnection::sendCommitString(string, replaceStart, replaceLength, cursorPos);
+        send(activeConnection,
+             (FrameWriter(EncodedMessage)
+              << Maliit::InputContextMessage::encodeCommitString(string, replaceStart,
+                                                                  replaceLength, cursorPos,
+                                                                  resetEpoch(activeConnection))).frame());
+    }
+}
+
+void
+UnixSocketInputContextConnection::sendKeyEvent(const QKeyEvent &keyEvent,
+                                               Maliit::EventRequestType requestType)
+{
+    if (activeConnection) {
+        MInputContextConnection::sendKeyEvent(keyEvent, requestType);
+        send(activeConnection,
+             (FrameWriter(EncodedMessage)
+              << Maliit::InputContextMessage::encodeKeyEvent(keyEvent.type(), keyEvent.key(),
+                                                              keyEvent.modifiers(), keyEvent.text(),
+                                                              keyEvent.isAutoRepeat(), keyEvent.count(),
+                                                              requestType)).frame());
+    }
+}
+
+void
+UnixSocketInputContextConnection::notifyImInitiatedHiding()
+{
+    send(activeConnection, FrameWriter(ImInitiatedHide).frame());
+}
+
+void
+UnixSocketInputContextConnection::setGlobalCorrectionEnabled(bool enabled)
+{
+    if ((enabled != globalCorrectionEnabled()) && mChannels.contains(activeConnection)) {
+        send(activeConnection, (FrameWriter(SetGlobalCorrectionEnabled) << enabled).frame());
+        MInputContextConnection::setGlobalCorrectionEnabled(enabled);
+    }
+}
+
+int
+UnixSocketInputContextConnection::requestPreeditRectangle()
+{
+    if (!mChannels.contains(activeConnection)) {
+        return MInputContextConnection::requestPreeditRectangle();
+    }
+
+    const int requestId = nextRequestId();
+    mPreeditRectangleRequests.insert(requestId, activeConnection);
+    send(activeConnection, (FrameWriter(PreeditRectangleRequest) << qint32(requestId)).frame());
+
+    return requestId;
+}
+
+void
+UnixSocketInputContextConnection::setRedirectKeys(bool enabled)
+{
+    if ((enabled != redirectKeysEnabled()) && mChannels.contains(activeConnection)) {
+        send(activeConnection, (FrameWriter(SetRedirectKeys) << enabled).frame());
+        MInputContextConnection::setRedirectKeys(enabled);
+    }
+}
+
+void
+UnixSocketInputContextConnection::setDetectableAutoRepeat(bool enabled)
+{
+    if ((enabled != detectableAutoRepeat()) && mChannels.contains(activeConnection)) {
+        send(activeConnection, (FrameWriter(SetDetectableAutoRepeat) << enabled).frame());
+        MInputContextConnection::setDetectableAutoRepeat(enabled);
+    }
+}
+
+void
+UnixSocketInputContextConnection::invokeAction(const QString &action,
+                                               const QKeySequence &sequence)
+{
+    send(activeConnection, (FrameWriter(InvokeAction) << action << sequence.toString()).frame());
+}
+
+void
+UnixSocketInputContextConnection::setSelection(int start, int length)
+{
+    send(activeConnection, (FrameWriter(SetSelection) << qint32(start) << qint32(length)).frame());
+}
+
+int
+UnixSocketInputContextConnection::requestSelection()
+{
+    if (!mChannels.contains(activeConnection)) {
+        return MInputContextConnection::requestSelection();
+    }
+
+    const int requestId = nextRequestId();
+    mSelectionRequests.insert(requestId, activeConnection);
+    send(activeConnection, (FrameWriter(SelectionRequest) << qint32(requestId)).frame());
+
+    return requestId;
+}
+
+void
+UnixSocketInputContextConnection::setSurroundingTextWindow(int characters)
+{
+    MInputContextConnection::setSurroundingTextWindow(characters);
+    send(activeConnection, (FrameWriter(SetSurroundingTextWindow) << qint32(surroundingTextWindow())).frame());
+}
+
+int
+UnixSocketInputContextConnection::requestSurroundingText(int start, int length)
+{
+    if (!mChannels.contains(activeConnection)) {
+        return MInputContextConnection::requestSurroundingText(start, length);
+    }
+
+    const int requestId = nextRequestId();
+    mSurroundingTextRequests.insert(requestId, qMakePair(activeConnection, start));
+    send(activeConnection, (FrameWriter(SurroundingTextRequest) << qint32(requestId)
+                            << qint32(start) << qint32(length)).frame());
+
+    return requestId;
+}
+
+void
+UnixSocketInputContextConnection::setLanguage(const QString &language)
+{
+    lastLanguage = language;
+    send(activeConnection, (FrameWriter(SetLanguage) << language).frame());
+}
+
+void
+UnixSocketInputContextConnection::sendActivationLostEvent()
+{
+    send(activeConnection, FrameWriter(ActivationLostEvent).frame());
+}
+
+void
+UnixSocketInputContextConnection::updateInputMethodArea(const QRegion &region)
+{
+    send(activeConnection, (FrameWriter(UpdateInputMethodArea) << region.boundingRect()).frame());
+}
+
+void
+UnixSocketInputContextConnection::notifyExtendedAttributeChanged(int id,
+                                                                 const QString &target,
+                                                                 const QString &targetItem,
+                                                                 const QString &attribute,
+                                                                 const QVariant &value)
+{
+    send(activeConnection,
+         (FrameWriter(ExtendedAttributeChanged)
+          << qint32(id) << target << targetItem << attribute << value).frame());
+}
+
+void
+UnixSocketInputContextConnection::notifyExtendedAttributeChanged(const QList<int> &clientIds,
+                                                                 int id,
+                                                                 const QString &target,
+                                                                 const QString &targetItem,
+                                                                 const QString &attribute,
+                                                                 const QVariant &value)
+{
+    const QByteArray frame = (FrameWriter(ExtendedAttributeChanged)
+                              << qint32(id) << target << targetItem << attribute << value).frame();
+    Q_FOREACH (int clientId, clientIds) {
+        send(clientId, frame);
+    }
+}
+
+void
+UnixSocketInputContextConnection::pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info)
+{
+    send(clientId, (FrameWriter(PluginSettingsLoaded) << info).frame());
+}
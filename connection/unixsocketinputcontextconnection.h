@@ -0,0 +1,104 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UNIXSOCKETINPUTCONTEXTCONNECTION_H
+#define UNIXSOCKETINPUTCONTEXTCONNECTION_H
+
+#include "minputcontextconnection.h"
+#include "inputcontextmessages.h"
+
+#include <QHash>
+
+class QSocketNotifier;
+class UnixSocketChannel;
+
+/*! \internal
+ * \brief Input context connection over a SOCK_SEQPACKET Unix socket.
+ *
+ * Applications connect to the socket at the given path and exchange one
+ * fixed binary frame per method, see Maliit::UnixSocket::Method. Needs
+ * neither a session bus nor libdbus on the application side. Only
+ * processes of the same user are accepted.
+ */
+class UnixSocketInputContextConnection : public MInputContextConnection
+{
+    Q_OBJECT
+
+public:
+    explicit UnixSocketInputContextConnection(const QString &socketPath);
+    ~UnixSocketInputContextConnection();
+
+    //! \reimp
+    virtual void sendPreeditString(const QString &string,
+                                   const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                   int replacementStart = 0, int replacementLength = 0,
+                                   int cursorPos = -1);
+    virtual void sendCommitString(const QString &string, int replaceStart = 0,
+                                  int replaceLength = 0, int cursorPos = -1);
+    virtual void sendKeyEvent(const QKeyEvent &keyEvent,
+                              Maliit::EventRequestType requestType);
+    virtual void notifyImInitiatedHiding();
+
+    virtual void setGlobalCorrectionEnabled(bool);
+    virtual int requestPreeditRectangle();
+    virtual void setRedirectKeys(bool enabled);
+    virtual void setDetectableAutoRepeat(bool enabled);
+    virtual void invokeAction(const QString &action,
+                              const QKeySequence &sequence);
+    virtual void setSelection(int start, int length);
+    virtual int requestSelection();
+    virtual void setSurroundingTextWindow(int characters);
+    virtual int requestSurroundingText(int start, int length);
+    virtual void setLanguage(const QString &language);
+    virtual void sendActivationLostEvent();
+    virtual void updateInputMethodArea(const QRegion &region);
+    virtual void notifyExtendedAttributeChanged(int id,
+                                                const QString &target,
+                                                const QString &targetItem,
+                                                const QString &attribute,
+                                                const QVariant &value);
+    virtual void notifyExtendedAttributeChanged(const QList<int> &clientIds,
+                                                int id,
+                                                const QString &target,
+                                                const QString &targetItem,
+                                                const QString &attribute,
+                                                const QVariant &value);
+    virtual void pluginSettingsLoaded(int clientId, const QList<MImPluginSettingsInfo> &info);
+    //! \reimp_end
+
+private Q_SLOTS:
+    void acceptConnections();
+    void handleFrame(const QByteArray &frame);
+    void onDisconnection();
+
+private:
+    void listen();
+    void send(unsigned int clientId, const QByteArray &frame);
+    void dispatch(unsigned int clientId, const QByteArray &frame);
+
+    const QString mSocketPath;
+    int mListenFd;
+    QSocketNotifier *mListenNotifier;
+    QHash<unsigned int, UnixSocketChannel *> mChannels;
+    QHash<UnixSocketChannel *, unsigned int> mConnectionNumbers;
+    //! Pending requestPreeditRectangle(), requestSelection() and requestSurroundingText() calls, by request id
+    QHash<int, unsigned int> mPreeditRectangleRequests;
+    QHash<int, unsigned int> mSelectionRequests;
+    QHash<int, QPair<unsigned int, int> > mSurroundingTextRequests; // client and start
+    //! Preedit last sent to each application, see sendPreeditString()
+    QHash<unsigned int, Maliit::InputContextMessage::PreeditBase> mPreeditBases;
+
+    QString lastLanguage;
+};
+
+#endif // UNIXSOCKETINPUTCONTEXTCONNECTION_H
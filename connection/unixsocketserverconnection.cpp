@@ -0,0 +1,335 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "unixsocketserverconnection.h"
+
+#include "unixsocketchannel.h"
+#include "unixsocketframe.h"
+#include "inputcontextmessages.h"
+
+#include <maliit/settingdata.h>
+
+#include <QKeySequence>
+#include <QDebug>
+
+using namespace Maliit::UnixSocket;
+
+namespace
+{
+    const int ConnectionRetryInterval(6*1000); // in ms
+}
+
+UnixSocketServerConnection::UnixSocketServerConnection(const QString &socketPath) :
+    MImServerConnection(0)
+  , mSocketPath(socketPath)
+  , mChannel(0)
+  , mActive(true)
+{
+    QTimer::singleShot(0, this, SLOT(connectToServer()));
+}
+
+UnixSocketServerConnection::~UnixSocketServerConnection()
+{
+    mActive = false;
+    delete mChannel;
+}
+
+void UnixSocketServerConnection::connectToServer()
+{
+    if (mChannel || !mActive)
+        return;
+
+    mChannel = UnixSocketChannel::connectTo(mSocketPath, this);
+    if (!mChannel) {
+        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToServer()));
+        return;
+    }
+
+    // The server starts every new application at epoch 0, without a preedit base
+    clearMessageState();
+
+    connect(mChannel, SIGNAL(frameReceived(QByteArray)), this, SLOT(handleFrame(QByteArray)));
+    connect(mChannel, SIGNAL(closed()), this, SLOT(onDisconnection()));
+
+    Q_EMIT connected();
+}
+
+void UnixSocketServerConnection::onDisconnection()
+{
+    mChannel->deleteLater();
+    mChannel = 0;
+    Q_EMIT disconnected();
+
+    if (mActive)
+        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToServer()));
+}
+
+void UnixSocketServerConnection::send(const QByteArray &frame)
+{
+    if (mChannel) {
+        mChannel->send(frame);
+    }
+}
+
+void UnixSocketServerConnection::handleFrame(const QByteArray &frame)
+{
+    dispatch(frame);
+}
+
+void UnixSocketServerConnection::dispatch(const QByteArray &frame)
+{
+    FrameReader reader(frame);
+    if (!reader.isValid()) {
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed frame";
+        return;
+    }
+
+    switch (reader.method()) {
+    case ActivationLostEvent:
+        Q_EMIT activationLostEvent();
+        break;
+
+    case ImInitiatedHide:
+        Q_EMIT imInitiatedHide();
+        break;
+
+    case EncodedMessage: {
+        QByteArray message;
+        reader >> message;
+        if (!reader.isValid() || !Maliit::InputContextMessage::dispatch(message, this)) {
+            qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed message";
+            discardPreeditBase();
+        }
+        break;
+    }
+
+    case UpdateInputMethodArea: {
+        QRect rect;
+        reader >> rect;
+        if (reader.isValid())
+            Q_EMIT updateInputMethodArea(rect);
+        break;
+    }
+
+    case SetGlobalCorrectionEnabled: {
+        bool enabled;
+        reader >> enabled;
+        if (reader.isValid())
+            Q_EMIT setGlobalCorrectionEnabled(enabled);
+        break;
+    }
+
+    case SetRedirectKeys: {
+        bool enabled;
+        reader >> enabled;
+        if (reader.isValid())
+            Q_EMIT setRedirectKeys(enabled);
+        break;
+    }
+
+    case SetDetectableAutoRepeat: {
+        bool enabled;
+        reader >> enabled;
+        if (reader.isValid())
+            Q_EMIT setDetectableAutoRepeat(enabled);
+        break;
+    }
+
+    case SetSelection: {
+        qint32 start, length;
+        reader >> start >> length;
+        if (reader.isValid())
+            Q_EMIT setSelection(start, length);
+        break;
+    }
+
+    case SetLanguage: {
+        QString language;
+        reader >> language;
+        if (reader.isValid())
+            Q_EMIT setLanguage(language);
+        break;
+    }
+
+    case ExtendedAttributeChanged: {
+        qint32 id;
+        QString target, targetItem, attribute;
+        QVariant value;
+        reader >> id >> target >> targetItem >> attribute >> value;
+        if (reader.isValid())
+            Q_EMIT extendedAttributeChanged(id, target, targetItem, attribute, value);
+        break;
+    }
+
+    case PluginSettingsLoaded: {
+        QList<MImPluginSettingsInfo> info;
+        reader >> info;
+        if (reader.isValid())
+            Q_EMIT pluginSettingsReceived(info);
+        break;
+    }
+
+    case InvokeAction: {
+        QString action, sequence;
+        reader >> action >> sequence;
+        if (reader.isValid())
+            Q_EMIT invokeAction(action, QKeySequence(sequence));
+        break;
+    }
+
+    case PreeditRectangleRequest: {
+        qint32 requestId;
+        reader >> requestId;
+        if (reader.isValid()) {
+            QRect rectangle;
+            bool valid = false;
+            Q_EMIT getPreeditRectangle(rectangle, valid);
+            send((FrameWriter(PreeditRectangleReply) << requestId << valid << rectangle).frame());
+        }
+        break;
+    }
+
+    case SelectionRequest: {
+        qint32 requestId;
+        reader >> requestId;
+        if (reader.isValid()) {
+            QString selection;
+            bool valid = false;
+            Q_EMIT getSelection(selection, valid);
+            send((FrameWriter(SelectionReply) << requestId << valid << selection).frame());
+        }
+        break;
+    }
+
+    case SetSurroundingTextWindow: {
+        qint32 characters;
+        reader >> characters;
+        if (reader.isValid())
+            Q_EMIT setSurroundingTextWindow(characters);
+        break;
+    }
+
+    case SurroundingTextRequest: {
+        qint32 requestId, start, length;
+        reader >> requestId >> start >> length;
+        if (reader.isValid()) {
+            QString text;
+            bool valid = false;
+            Q_EMIT getSurroundingText(start, length, text, valid);
+            send((FrameWriter(SurroundingTextReply) << requestId << valid << text).frame());
+        }
+        break;
+    }
+
+    default:
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring unknown method" << reader.method();
+        return;
+    }
+
+    if (!reader.isValid()) {
+        qWarning() << __PRETTY_FUNCTION__ << "ignoring malformed frame for method" << reader.method();
+    }
+}
+
+void UnixSocketServerConnection::activateContext()
+{
+    send(FrameWriter(ActivateContext).frame());
+}
+
+void UnixSocketServerConnection::showInputMethod()
+{
+    send(FrameWriter(ShowInputMethod).frame());
+}
+
+void UnixSocketServerConnection::hideInputMethod()
+{
+    send(FrameWriter(HideInputMethod).frame());
+}
+
+void UnixSocketServerConnection::mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect)
+{
+    send((FrameWriter(MouseClickedOnPreedit) << pos << preeditRect).frame());
+}
+
+void UnixSocketServerConnection::setPreedit(const QString &text, int cursorPos)
+{
+    send((FrameWriter(SetPreedit) << text << qint32(cursorPos)).frame());
+}
+
+void UnixSocketServerConnection::updateWidgetInformation(const QMap<QString, QVariant> &stateInformation,
+                                                         bool focusChanged)
+{
+    send((FrameWriter(UpdateWidgetInformation) << stateInformation << focusChanged).frame());
+}
+
+void UnixSocketServerConnection::reset(bool requireSynchronization)
+{
+    if (!mChannel)
+        return;
+
+    // Commits and preedits of the input method carry the epoch of the reset they follow,
+    // older ones are dropped on arrival instead of waiting for an acknowledgement
+    const quint32 epoch = requireSynchronization ? startResetEpoch() : resetEpoch();
+    send((FrameWriter(Reset) << epoch).frame());
+}
+
+void UnixSocketServerConnection::appOrientationAboutToChange(int angle)
+{
+    send((FrameWriter(AppOrientationAboutToChange) << qint32(angle)).frame());
+}
+
+void UnixSocketServerConnection::appOrientationChanged(int angle)
+{
+    send((FrameWriter(AppOrientationChanged) << qint32(angle)).frame());
+}
+
+void UnixSocketServerConnection::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
+{
+    send((FrameWriter(SetCopyPasteState) << copyAvailable << pasteAvailable).frame());
+}
+
+void UnixSocketServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                                 Qt::KeyboardModifiers modifiers,
+                                                 const QString &text, bool autoRepeat, int count,
+                                                 quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time)
+{
+    send((FrameWriter(ProcessKeyEvent)
+          << qint32(keyType) << qint32(keyCode) << qint32(modifiers) << text << autoRepeat << qint32(count)
+          << nativeScanCode << nativeModifiers << quint64(time)).frame());
+}
+
+void UnixSocketServerConnection::registerAttributeExtension(int id, const QString &fileName)
+{
+    send((FrameWriter(RegisterAttributeExtension) << qint32(id) << fileName).frame());
+}
+
+void UnixSocketServerConnection::unregisterAttributeExtension(int id)
+{
+    send((FrameWriter(UnregisterAttributeExtension) << qint32(id)).frame());
+}
+
+void UnixSocketServerConnection::setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                                      const QString &attribute, const QVariant &value)
+{
+    send((FrameWriter(SetExtendedAttribute) << qint32(id) << target << targetItem << attribute << value).frame());
+}
+
+void UnixSocketServerConnection::loadPluginSettings(const QString &descriptionLanguage)
+{
+    send((FrameWriter(LoadPluginSettings) << descriptionLanguage).frame());
+}
+
+void UnixSocketServerConnection::requestFullPreedit()
+{
+    send(FrameWriter(ResyncPreedit).frame());
+}
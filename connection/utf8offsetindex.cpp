@@ -0,0 +1,198 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "utf8offsetindex.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+    //! UTF-16 units in one SSE2 register
+    const int ChunkSize = 8;
+    //! Chunks summed per lane before the 16 bit lanes could overflow
+    const int ChunksPerSum = 4096;
+
+    //! Bytes of unit \a i of \a units in UTF-8. Low surrogates count as part of their pair.
+    inline int unitUtf8Length(const ushort *units, int length, int i)
+    {
+        const ushort unit = units[i];
+
+        if (unit < 0x80) {
+            return 1;
+        }
+        if (unit < 0x800) {
+            return 2;
+        }
+        if (QChar::isHighSurrogate(unit)) {
+            return (i + 1 < length && QChar::isLowSurrogate(units[i + 1])) ? 4 : 1;
+        }
+        if (QChar::isLowSurrogate(unit)) {
+            return (i > 0 && QChar::isHighSurrogate(units[i - 1])) ? 0 : 1;
+        }
+        return 3;
+    }
+
+    //! Bytes of units \a begin to \a end of \a units in UTF-8, pairs across the bounds included
+    int countUtf8(const ushort *units, int length, int begin, int end)
+    {
+        int bytes = 0;
+        int i = begin;
+
+#ifdef __SSE2__
+        const __m128i asciiBits = _mm_set1_epi16(static_cast<short>(0xff80));
+        const __m128i twoByteBits = _mm_set1_epi16(static_cast<short>(0xf800));
+        const __m128i surrogateBits = _mm_set1_epi16(static_cast<short>(0xd800));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+
+        while (end - i >= ChunkSize) {
+            // Every unit takes 3 bytes, less one if below 0x800 and one more if below 0x80.
+            // Lanes are -1 for each of these, so they count what to take off.
+            __m128i shorter = zero;
+
+            for (int chunks = 0; end - i >= ChunkSize && chunks < ChunksPerSum; i += ChunkSize) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(units + i));
+                const __m128i top = _mm_and_si128(chunk, twoByteBits);
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(top, surrogateBits))) {
+                    // Surrogates depend on their neighbours
+                    for (int j = i; j < i + ChunkSize; ++j) {
+                        bytes += unitUtf8Length(units, length, j);
+                    }
+                    continue;
+                }
+
+                shorter = _mm_add_epi16(shorter, _mm_cmpeq_epi16(top, zero));
+                shorter = _mm_add_epi16(shorter, _mm_cmpeq_epi16(_mm_and_si128(chunk, asciiBits), zero));
+                bytes += 3 * ChunkSize;
+                ++chunks;
+            }
+
+            __m128i sum = _mm_madd_epi16(shorter, ones);
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            bytes += _mm_cvtsi128_si32(sum);
+        }
+#endif
+
+        for (; i < end; ++i) {
+            bytes += unitUtf8Length(units, length, i);
+        }
+
+        return bytes;
+    }
+}
+
+const int Utf8OffsetIndex::BlockSize;
+
+Utf8OffsetIndex::Utf8OffsetIndex()
+    : mText()
+    , mUtf8Size(0)
+    , mBlockOffsets()
+{
+}
+
+Utf8OffsetIndex::Utf8OffsetIndex(const QString &text)
+    : mText()
+    , mUtf8Size(0)
+    , mBlockOffsets()
+{
+    setText(text);
+}
+
+void Utf8OffsetIndex::setText(const QString &text)
+{
+    // Copies of the indexed text share its data, nothing to do for them
+    if (text.constData() == mText.constData() && text.size() == mText.size()) {
+        return;
+    }
+
+    mText = text;
+    mBlockOffsets.resize(text.size() / BlockSize);
+
+    const ushort *units = mText.utf16();
+    const int length = mText.size();
+    int bytes = 0;
+
+    for (int block = 0; block < mBlockOffsets.size(); ++block) {
+        bytes += countUtf8(units, length, block * BlockSize, (block + 1) * BlockSize);
+        mBlockOffsets[block] = bytes;
+    }
+
+    mUtf8Size = bytes + countUtf8(units, length, mBlockOffsets.size() * BlockSize, length);
+}
+
+const QString &Utf8OffsetIndex::text() const
+{
+    return mText;
+}
+
+int Utf8OffsetIndex::utf8Size() const
+{
+    return mUtf8Size;
+}
+
+int Utf8OffsetIndex::utf8Offset(int position) const
+{
+    const int length = mText.size();
+    position = qBound(0, position, length);
+
+    const int block = position / BlockSize;
+    const int base = block > 0 ? mBlockOffsets.at(block - 1) : 0;
+
+    return base + countUtf8(mText.utf16(), length, block * BlockSize, position);
+}
+
+int Utf8OffsetIndex::utf16Offset(int offset) const
+{
+    if (offset <= 0) {
+        return 0;
+    }
+    if (offset >= mUtf8Size) {
+        return mText.size();
+    }
+
+    // Blocks starting at or before offset
+    const int block = std::upper_bound(mBlockOffsets.constBegin(), mBlockOffsets.constEnd(), offset)
+                      - mBlockOffsets.constBegin();
+
+    const ushort *units = mText.utf16();
+    const int length = mText.size();
+    int position = block * BlockSize;
+    int bytes = block > 0 ? mBlockOffsets.at(block - 1) : 0;
+
+    while (position < length && bytes < offset) {
+        bytes += unitUtf8Length(units, length, position);
+        ++position;
+    }
+
+    // Blocks may start between the halves of a pair, which belong to the pair
+    if (position < length && unitUtf8Length(units, length, position) == 0) {
+        ++position;
+    }
+
+    return position;
+}
+
+int Utf8OffsetIndex::utf8Length(const QChar *text, int length)
+{
+    return countUtf8(reinterpret_cast<const ushort *>(text), length, 0, length);
+}
+
+int Utf8OffsetIndex::utf8Length(const QStringRef &text)
+{
+    return utf8Length(text.unicode(), text.size());
+}
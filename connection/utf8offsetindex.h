@@ -0,0 +1,64 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UTF8OFFSETINDEX_H
+#define UTF8OFFSETINDEX_H
+
+#include <QString>
+#include <QVector>
+
+/*! \internal
+ * \brief Maps positions in a text between UTF-16 units and UTF-8 bytes.
+ *
+ * Wayland counts positions in UTF-8 bytes, QString in UTF-16 units. The
+ * index scans the text once and remembers the UTF-8 offset of every
+ * BlockSize units, so conversions only look at one block instead of
+ * encoding the text again. Byte counts match QString::toUtf8(), unpaired
+ * surrogates count as one byte for the replacement character.
+ *
+ * Positions between the halves of a surrogate pair map to the end of the
+ * pair, and so do offsets inside the UTF-8 sequence of a character.
+ */
+class Utf8OffsetIndex
+{
+public:
+    //! UTF-16 units between two remembered offsets
+    static const int BlockSize = 64;
+
+    Utf8OffsetIndex();
+    explicit Utf8OffsetIndex(const QString &text);
+
+    //! Indexes \a text, unless it shares its data with the text indexed already
+    void setText(const QString &text);
+    const QString &text() const;
+
+    //! Size of the text in UTF-8
+    int utf8Size() const;
+
+    //! UTF-8 offset of UTF-16 position \a position, clamped to the text
+    int utf8Offset(int position) const;
+    //! UTF-16 position of UTF-8 offset \a offset, clamped to the text
+    int utf16Offset(int offset) const;
+
+    //! Same as QString(text, length).toUtf8().size(), without encoding anything
+    static int utf8Length(const QChar *text, int length);
+    static int utf8Length(const QStringRef &text);
+
+private:
+    QString mText;
+    int mUtf8Size;
+    //! UTF-8 offsets of the UTF-16 positions BlockSize, 2 * BlockSize, ...
+    QVector<int> mBlockOffsets;
+};
+
+#endif // UTF8OFFSETINDEX_H
@@ -24,23 +24,10 @@
 #include <xkbcommon/xkbcommon.h>
 
 #include "waylandinputmethodconnection.h"
+#include "utf8offsetindex.h"
 
 namespace {
 
-// TODO: Deduplicate it. Those values are used in
-// minputcontextconnection, mimpluginmanager,
-// mattributeextensionmanager and in input context implementations.
-const char * const FocusStateAttribute = "focusState";
-const char * const ContentTypeAttribute = "contentType";
-const char * const CorrectionAttribute = "correctionEnabled";
-const char * const PredictionAttribute = "predictionEnabled";
-const char * const AutoCapitalizationAttribute = "autocapitalizationEnabled";
-const char * const SurroundingTextAttribute = "surroundingText";
-const char * const AnchorPositionAttribute = "anchorPosition";
-const char * const CursorPositionAttribute = "cursorPosition";
-const char * const HasSelectionAttribute = "hasSelection";
-const char * const HiddenTextAttribute = "hiddenText";
-
 typedef QPair<Qt::KeyboardModifiers, const char *> Modifier;
 const Modifier modifiers[] = {
     Modifier(Qt::ShiftModifier, XKB_MOD_NAME_SHIFT),
@@ -172,6 +159,8 @@ public:
 
     QString selection() const;
     uint32_t serial() const;
+    //! Index over \a text, reused as long as it is the surrounding text last received
+    const Utf8OffsetIndex &surroundingTextIndex(const QString &text);
 
 protected:
     void input_method_context_commit_state(uint32_t serial) Q_DECL_OVERRIDE;
@@ -183,9 +172,10 @@ protected:
 
 private:
     MInputContextConnection *m_connection;
-    QVariantMap m_stateInfo;
+    Maliit::WidgetState m_stateInfo;
     uint32_t m_serial;
     QString m_selection;
+    Utf8OffsetIndex m_surroundingIndex;
 };
 
 }
@@ -321,16 +311,19 @@ void WaylandInputMethodConnection::sendPreeditString(const QString &string,
                                                cursor_pos);
 
     if (replace_length > 0) {
-        int cursor = widgetState().value(CursorPositionAttribute).toInt();
-        uint32_t index = string.midRef(qMin(cursor + replace_start, cursor), qAbs(replace_start)).toUtf8().size();
-        uint32_t length = string.midRef(cursor + replace_start, replace_length).toUtf8().size();
+        int cursor = widgetState().cursorPosition();
+        uint32_t index = Utf8OffsetIndex::utf8Length(string.midRef(qMin(cursor + replace_start, cursor), qAbs(replace_start)));
+        uint32_t length = Utf8OffsetIndex::utf8Length(string.midRef(cursor + replace_start, replace_length));
         d->context()->delete_surrounding_text(index, length);
     }
 
+    // Formats and cursor are looked up in one pass over the preedit
+    const Utf8OffsetIndex preedit_index(string);
+
     Q_FOREACH (const Maliit::PreeditTextFormat& format, preedit_formats) {
         QtWayland::wl_text_input::preedit_style style = preeditStyleFromMaliit(format.preeditFace);
-        uint32_t index = string.leftRef(format.start).toUtf8().size();
-        uint32_t length = string.leftRef(format.start + format.length).toUtf8().size() - index;
+        uint32_t index = preedit_index.utf8Offset(format.start);
+        uint32_t length = preedit_index.utf8Offset(format.start + format.length) - index;
         qDebug() << Q_FUNC_INFO << "preedit_styling" << index << length;
         d->context()->preedit_styling(index, length, style);
     }
@@ -340,8 +333,9 @@ void WaylandInputMethodConnection::sendPreeditString(const QString &string,
         cursor_pos = string.size() + 1 - cursor_pos;
     }
 
-    qDebug() << Q_FUNC_INFO << "preedit_cursor" << string.leftRef(cursor_pos).toUtf8().size();
-    d->context()->preedit_cursor(string.leftRef(cursor_pos).toUtf8().size());
+    const uint32_t preedit_cursor = preedit_index.utf8Offset(cursor_pos);
+    qDebug() << Q_FUNC_INFO << "preedit_cursor" << preedit_cursor;
+    d->context()->preedit_cursor(preedit_cursor);
     qDebug() << Q_FUNC_INFO << "preedit_string" << string;
     d->context()->preedit_string(d->context()->serial(), string, string);
 }
@@ -367,13 +361,13 @@ void WaylandInputMethodConnection::sendCommitString(const QString &string,
     }
 
     if (replace_length > 0) {
-        int cursor = widgetState().value(CursorPositionAttribute).toInt();
-        uint32_t index = string.midRef(qMin(cursor + replace_start, cursor), qAbs(replace_start)).toUtf8().size();
-        uint32_t length = string.midRef(cursor + replace_start, replace_length).toUtf8().size();
+        int cursor = widgetState().cursorPosition();
+        uint32_t index = Utf8OffsetIndex::utf8Length(string.midRef(qMin(cursor + replace_start, cursor), qAbs(replace_start)));
+        uint32_t length = Utf8OffsetIndex::utf8Length(string.midRef(cursor + replace_start, replace_length));
         d->context()->delete_surrounding_text(index, length);
     }
 
-    cursor_pos = string.leftRef(cursor_pos).toUtf8().size();
+    cursor_pos = Utf8OffsetIndex::utf8Length(string.leftRef(cursor_pos));
     d->context()->cursor_position(cursor_pos, cursor_pos);
     d->context()->commit_string(d->context()->serial(), string);
 }
@@ -453,9 +447,9 @@ void WaylandInputMethodConnection::setSelection(int start, int length)
     if (!d->context())
         return;
 
-    QString surrounding = widgetState().value(SurroundingTextAttribute).toString();
-    uint32_t index(surrounding.leftRef(start + length).toUtf8().size());
-    uint32_t anchor(surrounding.leftRef(start).toUtf8().size());
+    const Utf8OffsetIndex &surrounding = d->context()->surroundingTextIndex(widgetState().surroundingText());
+    uint32_t index(surrounding.utf8Offset(start + length));
+    uint32_t anchor(surrounding.utf8Offset(start));
 
     d->context()->cursor_position(index, anchor);
     d->context()->commit_string(d->context()->serial(), QString());
@@ -505,10 +499,11 @@ InputMethodContext::InputMethodContext(MInputContextConnection *connection, stru
     , m_stateInfo()
     , m_serial(0)
     , m_selection()
+    , m_surroundingIndex()
 {
     qDebug() << Q_FUNC_INFO;
 
-    m_stateInfo[FocusStateAttribute] = true;
+    m_stateInfo.setFocusState(true);
     m_connection->activateContext(wayland_connection_id);
     m_connection->showInputMethod(wayland_connection_id);
 }
@@ -518,7 +513,7 @@ InputMethodContext::~InputMethodContext()
     qDebug() << Q_FUNC_INFO;
 
     m_stateInfo.clear();
-    m_stateInfo[FocusStateAttribute] = false;
+    m_stateInfo.setFocusState(false);
     m_connection->updateWidgetInformation(wayland_connection_id, m_stateInfo, true);
     m_connection->hideInputMethod(wayland_connection_id);
 }
@@ -533,6 +528,12 @@ uint32_t InputMethodContext::serial() const
     return m_serial;
 }
 
+const Utf8OffsetIndex &InputMethodContext::surroundingTextIndex(const QString &text)
+{
+    m_surroundingIndex.setText(text);
+    return m_surroundingIndex;
+}
+
 void InputMethodContext::input_method_context_commit_state(uint32_t serial)
 {
     qDebug() << Q_FUNC_INFO;
@@ -545,11 +546,11 @@ void InputMethodContext::input_method_context_content_type(uint32_t hint, uint32
 {
     qDebug() << Q_FUNC_INFO;
 
-    m_stateInfo[ContentTypeAttribute] = contentTypeFromWayland(purpose);
-    m_stateInfo[AutoCapitalizationAttribute] = matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_capitalization);
-    m_stateInfo[CorrectionAttribute] = matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_correction);
-    m_stateInfo[PredictionAttribute] = matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_completion);
-    m_stateInfo[HiddenTextAttribute] = matchesFlag(hint, QtWayland::wl_text_input::content_hint_hidden_text);
+    m_stateInfo.setContentType(contentTypeFromWayland(purpose));
+    m_stateInfo.setAutoCapitalizationEnabled(matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_capitalization));
+    m_stateInfo.setCorrectionEnabled(matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_correction));
+    m_stateInfo.setPredictionEnabled(matchesFlag(hint, QtWayland::wl_text_input::content_hint_auto_completion));
+    m_stateInfo.setHiddenText(matchesFlag(hint, QtWayland::wl_text_input::content_hint_hidden_text));
 }
 
 void InputMethodContext::input_method_context_invoke_action(uint32_t button, uint32_t index)
@@ -573,19 +574,21 @@ void InputMethodContext::input_method_context_surrounding_text(const QString &te
 {
     qDebug() << Q_FUNC_INFO;
 
-    const QByteArray &utf8_text(text.toUtf8());
+    m_surroundingIndex.setText(text);
+    const int cursor_position = m_surroundingIndex.utf16Offset(cursor);
+    const int anchor_position = m_surroundingIndex.utf16Offset(anchor);
 
-    m_stateInfo[SurroundingTextAttribute] = text;
-    m_stateInfo[CursorPositionAttribute] = QString::fromUtf8(utf8_text.constData(), cursor).size();
-    m_stateInfo[AnchorPositionAttribute] = QString::fromUtf8(utf8_text.constData(), anchor).size();
+    m_stateInfo.setSurroundingText(text);
+    m_stateInfo.setCursorPosition(cursor_position);
+    m_stateInfo.setAnchorPosition(anchor_position);
     if (cursor == anchor) {
-        m_stateInfo[HasSelectionAttribute] = false;
+        m_stateInfo.setHasSelection(false);
         m_selection.clear();
     } else {
-        m_stateInfo[HasSelectionAttribute] = true;
-        uint32_t begin = qMin(anchor, cursor);
-        uint32_t end = qMax(anchor, cursor);
-        m_selection = QString::fromUtf8(utf8_text.constData() + begin, end - begin);
+        m_stateInfo.setHasSelection(true);
+        int begin = qMin(anchor_position, cursor_position);
+        int end = qMax(anchor_position, cursor_position);
+        m_selection = text.mid(begin, end - begin);
     }
 }
 
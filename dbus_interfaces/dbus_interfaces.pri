@@ -2,3 +2,7 @@ DBUS_XML_DIR = $$PWD
 
 DBUS_CONTEXT_XML = $$DBUS_XML_DIR/minputmethodcontext1interface.xml
 DBUS_SERVER_XML = $$DBUS_XML_DIR/minputmethodserver1interface.xml
+
+# Sequenced no-reply variants of the calls which return nothing
+DBUS_CONTEXT2_XML = $$DBUS_XML_DIR/minputmethodcontext2interface.xml
+DBUS_SERVER2_XML = $$DBUS_XML_DIR/minputmethodserver2interface.xml
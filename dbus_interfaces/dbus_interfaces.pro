@@ -8,4 +8,6 @@ TARGET = dummy
 
 OTHER_FILES += \
     minputmethodcontext1interface.xml \
-    minputmethodserver1interface.xml
+    minputmethodserver1interface.xml \
+    minputmethodcontext2interface.xml \
+    minputmethodserver2interface.xml
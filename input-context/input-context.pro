@@ -14,6 +14,11 @@ INSTALLS += target
 include($$TOP_DIR/common/libmaliit-common.pri)
 include($$TOP_DIR/connection/libmaliit-connection.pri)
 
+embedded-server {
+    DEFINES += MALIIT_EMBEDDED_SERVER
+    include($$TOP_DIR/src/libmaliit-plugins.pri)
+}
+
 SOURCES += $$PWD/main.cpp \
            $$PWD/minputcontext.cpp \
 
@@ -22,14 +22,26 @@
 #include <QScreen>
 #include <QKeyEvent>
 #include <QTextFormat>
+#include <QHash>
 #include <QDebug>
 #include <QByteArray>
+#include <QFile>
 #include <QRectF>
 #include <QLocale>
 #include <QWindow>
 #include <QSharedDataPointer>
 #include <QQuickItem>
 
+#ifdef MALIIT_EMBEDDED_SERVER
+#include "connectionfactory.h"
+#include "loopbackinputcontextconnection.h"
+#include "mimserver.h"
+#ifndef NOXCB
+#include "xcbplatform.h"
+#endif
+#include "unknownplatform.h"
+#endif
+
 namespace
 {
     const int SoftwareInputPanelHideTimer = 100;
@@ -54,6 +66,62 @@ namespace
         }
         return MInputContext::Angle0;
     }
+
+    // Start of the surrounding text window of \a window characters, keeps the
+    // selection inside the window when it fits and the cursor otherwise
+    int surroundingTextWindowStart(int textLength, int cursor, int anchor, int window)
+    {
+        if (window <= 0 || textLength <= window) {
+            return 0;
+        }
+
+        const int selectionStart = qMin(cursor, anchor);
+        const int selectionLength = qAbs(cursor - anchor);
+        const int start = selectionLength <= window
+                          ? selectionStart - (window - selectionLength) / 2
+                          : cursor - window / 2;
+        return qBound(0, start, textLength - window);
+    }
+
+    QTextCharFormat buildFaceFormat(Maliit::PreeditFace face)
+    {
+        QTextCharFormat format;
+
+        // update style mode
+        switch (face) {
+        case Maliit::PreeditNoCandidates:
+            format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
+            format.setUnderlineColor(Qt::red);
+            break;
+        case Maliit::PreeditUnconvertible:
+            format.setForeground(QBrush(QColor(128, 128, 128)));
+            break;
+        case Maliit::PreeditActive:
+            format.setForeground(QBrush(QColor(153, 50, 204)));
+            format.setFontWeight(QFont::Bold);
+            break;
+        case Maliit::PreeditKeyPress:
+        case Maliit::PreeditDefault:
+            format.setUnderlineStyle(QTextCharFormat::SingleUnderline);
+            format.setUnderlineColor(QColor(0, 0, 0));
+            break;
+        }
+
+        return format;
+    }
+
+    // Formats are implicitly shared, so long compositions with many format
+    // spans do not build the same format over and over again
+    QTextCharFormat faceFormat(Maliit::PreeditFace face)
+    {
+        static QHash<int, QTextCharFormat> formats;
+
+        QHash<int, QTextCharFormat>::const_iterator it = formats.constFind(face);
+        if (it == formats.constEnd()) {
+            it = formats.insert(face, buildFaceFormat(face));
+        }
+        return it.value();
+    }
 }
 
 bool MInputContext::debug = false;
@@ -61,11 +129,15 @@ bool MInputContext::debug = false;
 
 MInputContext::MInputContext()
     : imServer(0),
+#ifdef MALIIT_EMBEDDED_SERVER
+      embeddedServer(0),
+#endif
       active(false),
       inputPanelState(InputPanelHidden),
       preeditCursorPos(-1),
       redirectKeys(false),
-      currentFocusAcceptsInput(false)
+      currentFocusAcceptsInput(false),
+      surroundingTextWindow(0)
 {
     QByteArray debugEnvVar = qgetenv("MALIIT_DEBUG");
     if (!debugEnvVar.isEmpty() && debugEnvVar != "0") {
@@ -73,8 +145,19 @@ MInputContext::MInputContext()
         debug = true;
     }
 
-    QSharedPointer<Maliit::InputContext::DBus::Address> address(new Maliit::InputContext::DBus::DynamicAddress);
-    imServer = new DBusServerConnection(address);
+#ifdef MALIIT_EMBEDDED_SERVER
+    // The server and its plugins run in this process, see createEmbeddedServer()
+    imServer = createEmbeddedServer();
+#else
+    // Applications without a session bus can talk to a server started with -unix-socket
+    const QByteArray socketPath = qgetenv("MALIIT_SERVER_SOCKET");
+    if (!socketPath.isEmpty()) {
+        imServer = new UnixSocketServerConnection(QFile::decodeName(socketPath));
+    } else {
+        QSharedPointer<Maliit::InputContext::DBus::Address> address(new Maliit::InputContext::DBus::DynamicAddress);
+        imServer = new DBusServerConnection(address);
+    }
+#endif
 
     sipHideTimer.setSingleShot(true);
     sipHideTimer.setInterval(SoftwareInputPanelHideTimer);
@@ -86,7 +169,33 @@ MInputContext::MInputContext()
 MInputContext::~MInputContext()
 {
     delete imServer;
+#ifdef MALIIT_EMBEDDED_SERVER
+    // after imServer, which detaches from the connection owned by the server
+    delete embeddedServer;
+#endif
+}
+
+#ifdef MALIIT_EMBEDDED_SERVER
+MImServerConnection *MInputContext::createEmbeddedServer()
+{
+    LoopbackInputContextConnection *connection = Maliit::Loopback::createInputContextConnection();
+
+    QSharedPointer<Maliit::AbstractPlatform> platform;
+#ifndef NOXCB
+    if (QGuiApplication::platformName() == "xcb") {
+        platform = QSharedPointer<Maliit::AbstractPlatform>(new Maliit::XCBPlatform);
+    } else
+#endif
+    {
+        platform = QSharedPointer<Maliit::AbstractPlatform>(new Maliit::UnknownPlatform);
+    }
+
+    MImServer::configureSettings(MImServer::PersistentSettings);
+    embeddedServer = new MImServer(QSharedPointer<MInputContextConnection>(connection), platform);
+
+    return Maliit::Loopback::createServerConnection(connection);
 }
+#endif
 
 void MInputContext::connectInputMethodServer()
 {
@@ -131,6 +240,12 @@ void MInputContext::connectInputMethodServer()
 
     connect(imServer, SIGNAL(setLanguage(QString)),
             this, SLOT(setLanguage(QString)));
+
+    connect(imServer, SIGNAL(setSurroundingTextWindow(int)),
+            this, SLOT(setSurroundingTextWindow(int)));
+
+    connect(imServer, SIGNAL(getSurroundingText(int,int,QString&,bool&)),
+            this, SLOT(getSurroundingText(int,int,QString&,bool&)));
 }
 
 
@@ -477,32 +592,10 @@ void MInputContext::updatePreeditInternally(const QString &string,
 
     QList<QInputMethodEvent::Attribute> attributes;
     Q_FOREACH (const Maliit::PreeditTextFormat &preeditFormat, preeditFormats) {
-
-        QTextCharFormat format;
-
-        // update style mode
-        switch (preeditFormat.preeditFace) {
-        case Maliit::PreeditNoCandidates:
-            format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
-            format.setUnderlineColor(Qt::red);
-            break;
-        case Maliit::PreeditUnconvertible:
-            format.setForeground(QBrush(QColor(128, 128, 128)));
-            break;
-        case Maliit::PreeditActive:
-            format.setForeground(QBrush(QColor(153, 50, 204)));
-            format.setFontWeight(QFont::Bold);
-            break;
-        case Maliit::PreeditKeyPress:
-        case Maliit::PreeditDefault:
-            format.setUnderlineStyle(QTextCharFormat::SingleUnderline);
-            format.setUnderlineColor(QColor(0, 0, 0));
-            break;
-        }
-
         attributes << QInputMethodEvent::Attribute(QInputMethodEvent::TextFormat,
                                                    preeditFormat.start,
-                                                   preeditFormat.length, format);
+                                                   preeditFormat.length,
+                                                   faceFormat(preeditFormat.preeditFace));
     }
 
     if (cursorPos >= 0) {
@@ -603,6 +696,11 @@ void MInputContext::onDBusConnection()
 {
     if (debug) qDebug() << __PRETTY_FUNCTION__;
 
+    // Also called when the connection comes back after the server restarted.
+    // Everything below is sent without waiting for replies: the attribute
+    // extension, then through setFocusObject() the extended attributes,
+    // activation, orientation and widget state, and finally the shown state.
+
     // using one attribute extension for everything
     imServer->registerAttributeExtension(0, QString());
 
@@ -677,23 +775,36 @@ QMap<QString, QVariant> MInputContext::getStateInformation() const
     QInputMethodQueryEvent query(Qt::ImQueryAll);
     QGuiApplication::sendEvent(qGuiApp->focusObject(), &query);
 
-    QVariant queryResult;
+    const QVariant surroundingText = query.value(Qt::ImSurroundingText);
+    const QVariant cursorPosition = query.value(Qt::ImCursorPosition);
+    const QVariant anchorPosition = query.value(Qt::ImAnchorPosition);
 
-    queryResult = query.value(Qt::ImSurroundingText);
-    if (queryResult.isValid()) {
-        stateInformation["surroundingText"] = queryResult.toString();
+    // Long texts are cut to the window asked for by the server, positions are
+    // then relative to the window
+    int windowStart = 0;
+    if (surroundingText.isValid() && surroundingTextWindow > 0) {
+        const QString text = surroundingText.toString();
+        windowStart = surroundingTextWindowStart(text.length(), cursorPosition.toInt(),
+                                                 anchorPosition.isValid() ? anchorPosition.toInt()
+                                                                          : cursorPosition.toInt(),
+                                                 surroundingTextWindow);
+        stateInformation["surroundingText"] = text.mid(windowStart, surroundingTextWindow);
+        stateInformation["surroundingTextOffset"] = windowStart;
+        stateInformation["surroundingTextLength"] = text.length();
+    } else if (surroundingText.isValid()) {
+        stateInformation["surroundingText"] = surroundingText.toString();
     }
 
-    queryResult = query.value(Qt::ImCursorPosition);
-    if (queryResult.isValid()) {
-        stateInformation["cursorPosition"] = queryResult.toInt();
+    if (cursorPosition.isValid()) {
+        stateInformation["cursorPosition"] = cursorPosition.toInt() - windowStart;
     }
 
-    queryResult = query.value(Qt::ImAnchorPosition);
-    if (queryResult.isValid()) {
-        stateInformation["anchorPosition"] = queryResult.toInt();
+    if (anchorPosition.isValid()) {
+        stateInformation["anchorPosition"] = anchorPosition.toInt() - windowStart;
     }
 
+    QVariant queryResult;
+
     queryResult = query.value(Qt::ImHints);
     Qt::InputMethodHints hints = static_cast<Qt::InputMethodHints>(queryResult.toUInt());
 
@@ -712,6 +823,8 @@ QMap<QString, QVariant> MInputContext::getStateInformation() const
     queryResult = query.value(Qt::ImCurrentSelection);
     if (queryResult.isValid()) {
         stateInformation["hasSelection"] = !(queryResult.toString().isEmpty());
+        // pushed along so the server never has to ask for it synchronously
+        stateInformation["selection"] = queryResult.toString();
     }
 
     QWindow *window = qGuiApp->focusWindow();
@@ -728,6 +841,13 @@ QMap<QString, QVariant> MInputContext::getStateInformation() const
         }
     }
 
+    bool preeditRectangleValid = false;
+    QRect preeditRectangle;
+    getPreeditRectangle(preeditRectangle, preeditRectangleValid);
+    if (preeditRectangleValid) {
+        stateInformation["preeditRectangle"] = preeditRectangle;
+    }
+
     stateInformation["toolbarId"] = 0; // Global extension id. And bad state parameter name for it.
 
     return stateInformation;
@@ -738,6 +858,18 @@ void MInputContext::setSelection(int start, int length)
     if (!inputMethodAccepted())
         return;
 
+    if (surroundingTextWindow > 0) {
+        // the server only knows positions relative to the window it got
+        QInputMethodQueryEvent query(Qt::ImSurroundingText | Qt::ImCursorPosition | Qt::ImAnchorPosition);
+        QGuiApplication::sendEvent(qGuiApp->focusObject(), &query);
+
+        const int cursor = query.value(Qt::ImCursorPosition).toInt();
+        const QVariant anchor = query.value(Qt::ImAnchorPosition);
+        start += surroundingTextWindowStart(query.value(Qt::ImSurroundingText).toString().length(),
+                                            cursor, anchor.isValid() ? anchor.toInt() : cursor,
+                                            surroundingTextWindow);
+    }
+
     QList<QInputMethodEvent::Attribute> attributes;
     attributes << QInputMethodEvent::Attribute(QInputMethodEvent::Selection, start,
                                                 length, QVariant());
@@ -766,6 +898,41 @@ void MInputContext::getSelection(QString &selection, bool &valid) const
     selection = selectionText;
 }
 
+void MInputContext::setSurroundingTextWindow(int characters)
+{
+    if (characters == surroundingTextWindow) {
+        return;
+    }
+
+    surroundingTextWindow = characters;
+    if (active) {
+        imServer->updateWidgetInformation(getStateInformation(), false);
+    }
+}
+
+void MInputContext::getSurroundingText(int start, int length, QString &text, bool &valid) const
+{
+    text.clear();
+    valid = false;
+
+    if (!inputMethodAccepted()) {
+        return;
+    }
+
+    QInputMethodQueryEvent query(Qt::ImSurroundingText);
+    QGuiApplication::sendEvent(qGuiApp->focusObject(), &query);
+
+    const QVariant queryResult = query.value(Qt::ImSurroundingText);
+    const QString surroundingText = queryResult.toString();
+    if (!queryResult.isValid() || start < 0 || length < 0
+        || start + length > surroundingText.length()) {
+        return;
+    }
+
+    text = surroundingText.mid(start, length);
+    valid = true;
+}
+
 int MInputContext::cursorStartPosition(bool *valid)
 {
     int start = -1;
@@ -17,6 +17,7 @@
 
 #include <maliit/namespace.h>
 #include "dbusserverconnection.h"
+#include "unixsocketserverconnection.h"
 
 #include <QObject>
 #include <QTimer>
@@ -26,6 +27,7 @@
 #include <qpa/qplatforminputcontext.h>
 
 class MImServerConnection;
+class MImServer;
 
 class MInputContext : public QPlatformInputContext
 {
@@ -81,6 +83,8 @@ public Q_SLOTS:
     void setSelection(int start, int length);
     void getSelection(QString &selection, bool &valid) const;
     void setLanguage(const QString &language);
+    void setSurroundingTextWindow(int characters);
+    void getSurroundingText(int start, int length, QString &text, bool &valid) const;
     // End input method server connection slots.
 
 private Q_SLOTS:
@@ -125,7 +129,15 @@ private:
 
     static bool debug;
 
-    DBusServerConnection *imServer;
+#ifdef MALIIT_EMBEDDED_SERVER
+    //! Creates the input method server in this process, returns the connection to it
+    MImServerConnection *createEmbeddedServer();
+#endif
+
+    MImServerConnection *imServer;
+#ifdef MALIIT_EMBEDDED_SERVER
+    MImServer *embeddedServer; // owns the server side of imServer
+#endif
     bool active; // is connection active
     QPointer<QWindow> window;
     QRect keyboardRectangle;
@@ -139,6 +151,7 @@ private:
     bool redirectKeys; // redirect all hw key events to the input method or not
     QLocale inputLocale;
     bool currentFocusAcceptsInput;
+    int surroundingTextWindow; // characters of surrounding text sent to the server, 0 for all
 };
 
 #endif
@@ -86,7 +86,9 @@ QSharedPointer<MInputContextConnection> createConnection(const MImServerConnecti
         return QSharedPointer<MInputContextConnection>(Maliit::createWestonIMProtocolConnection());
     } else
 #endif
-    if (options.overriddenAddress.isEmpty()) {
+    if (!options.unixSocketPath.isEmpty()) {
+        return QSharedPointer<MInputContextConnection>(Maliit::UnixSocket::createInputContextConnection(options.unixSocketPath));
+    } else if (options.overriddenAddress.isEmpty()) {
         return QSharedPointer<MInputContextConnection>(Maliit::DBus::createInputContextConnectionWithDynamicAddress());
     } else {
         return QSharedPointer<MInputContextConnection>(Maliit::DBus::createInputContextConnectionWithFixedAddress(options.overriddenAddress,
@@ -138,6 +140,10 @@ int main(int argc, char **argv)
 
     // Input Context Connection
     QSharedPointer<MInputContextConnection> icConnection(createConnection(connectionOptions));
+    icConnection->setWidgetStateCoalescing(connectionOptions.coalesceWidgetState);
+    icConnection->setHibernationTimeout(connectionOptions.hibernationTimeout * 1000);
+    // Bursts of one second worth of messages pass unthrottled
+    icConnection->setClientQuota(connectionOptions.clientQuota, connectionOptions.clientQuota);
 
     QSharedPointer<Maliit::AbstractPlatform> platform(createPlatform());
 
@@ -20,10 +20,13 @@ class MAbstractInputMethodHostPrivate
 public:
     MAbstractInputMethodHostPrivate();
     ~MAbstractInputMethodHostPrivate();
+
+    int lastRequestId;
 };
 
 
 MAbstractInputMethodHostPrivate::MAbstractInputMethodHostPrivate()
+    : lastRequestId(0)
 {
 }
 
@@ -50,6 +53,59 @@ bool MAbstractInputMethodHost::hiddenText(bool &valid)
     return false;
 }
 
+int MAbstractInputMethodHost::requestPreeditRectangle()
+{
+    const int requestId = ++d->lastRequestId;
+    bool valid = false;
+    const QRect rectangle = preeditRectangle(valid);
+
+    QMetaObject::invokeMethod(this, "preeditRectangleReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QRect, rectangle), Q_ARG(bool, valid));
+    return requestId;
+}
+
+int MAbstractInputMethodHost::requestSelection()
+{
+    const int requestId = ++d->lastRequestId;
+    bool valid = false;
+    const QString text = selection(valid);
+
+    QMetaObject::invokeMethod(this, "selectionReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(QString, text), Q_ARG(bool, valid));
+    return requestId;
+}
+
+void MAbstractInputMethodHost::setSurroundingTextWindow(int characters)
+{
+    Q_UNUSED(characters);
+}
+
+int MAbstractInputMethodHost::surroundingTextOffset(bool &valid)
+{
+    valid = false;
+    return 0;
+}
+
+int MAbstractInputMethodHost::requestSurroundingText(int start, int length)
+{
+    const int requestId = ++d->lastRequestId;
+    QString text;
+    int cursorPosition;
+    const bool valid = surroundingText(text, cursorPosition)
+                       && start >= 0 && length >= 0 && start + length <= text.length();
+
+    QMetaObject::invokeMethod(this, "surroundingTextReceived", Qt::QueuedConnection,
+                              Q_ARG(int, requestId), Q_ARG(int, start),
+                              Q_ARG(QString, valid ? text.mid(start, length) : QString()),
+                              Q_ARG(bool, valid));
+    return requestId;
+}
+
+void MAbstractInputMethodHost::setKeyRepeatCoalescing(bool enabled)
+{
+    Q_UNUSED(enabled);
+}
+
 QPixmap MAbstractInputMethodHost::background() const
 {
     return QPixmap();
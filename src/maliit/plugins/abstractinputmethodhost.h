@@ -93,6 +93,9 @@ public:
 
     /*!
      * \brief get preedit rectangle
+     *
+     * Returns the value last pushed by the application, use
+     * requestPreeditRectangle() if a fresh value is really required.
      */
     virtual QRect preeditRectangle(bool &valid) = 0;
 
@@ -116,6 +119,9 @@ public:
 
     /*!
      * \brief returns the selecting text
+     *
+     * Returns the value last pushed by the application, use
+     * requestSelection() if a fresh value is really required.
      */
     virtual QString selection(bool &valid) = 0;
 
@@ -139,6 +145,15 @@ Q_SIGNALS:
     //! This signal is emitted when input method plugins are loaded or unloaded
     void pluginsChanged();
 
+    //! Answer to requestPreeditRectangle(), \a valid is false if the application did not provide it
+    void preeditRectangleReceived(int requestId, const QRect &rectangle, bool valid);
+
+    //! Answer to requestSelection(), \a valid is false if the application did not provide it
+    void selectionReceived(int requestId, const QString &selection, bool valid);
+
+    //! Answer to requestSurroundingText(), \a valid is false if the application did not provide it
+    void surroundingTextReceived(int requestId, int start, const QString &text, bool valid);
+
 public Q_SLOTS:
     /*!
      * \brief Updates pre-edit string in the application widget
@@ -314,6 +329,59 @@ public:
                                                                           Maliit::SettingEntryType type,
                                                                           const QVariantMap &attributes) = 0;
 
+    // Virtual functions added after the first release go below, in order,
+    // so plugins built against older headers keep their vtable layout.
+
+    /*!
+     * \brief Asks the application for its current preedit rectangle.
+     *
+     * Does not block; the answer is delivered by preeditRectangleReceived()
+     * with the returned request id.
+     */
+    virtual int requestPreeditRectangle();
+
+    /*!
+     * \brief Asks the application for its current selection.
+     *
+     * Does not block; the answer is delivered by selectionReceived()
+     * with the returned request id.
+     */
+    virtual int requestSelection();
+
+    /*!
+     * \brief Limits the surrounding text sent by the application.
+     *
+     * With a window of \a characters the application only sends that many
+     * characters around the cursor; surroundingText() then returns the window
+     * and positions are relative to it. 0, the default, means the whole text.
+     * Use requestSurroundingText() to fetch text outside of the window.
+     */
+    virtual void setSurroundingTextWindow(int characters);
+
+    /*!
+     * \brief returns the position of the surrounding text window in the whole text
+     */
+    virtual int surroundingTextOffset(bool &valid);
+
+    /*!
+     * \brief Asks the application for \a length characters of its text starting at \a start.
+     *
+     * \a start is an absolute position, not relative to the window. Does not
+     * block; the answer is delivered by surroundingTextReceived() with the
+     * returned request id.
+     */
+    virtual int requestSurroundingText(int start, int length);
+
+    /*!
+     * \brief Set if the input method accepts coalesced hardware key autorepeats.
+     *
+     * Applications may coalesce the autorepeats of a held key. When enabled, they
+     * reach MAbstractInputMethod::processKeyEvent() as a single key press with
+     * autoRepeat set and the number of repeats as count. Otherwise each repeat is
+     * delivered on its own, as sent by the keyboard. Disabled by default.
+     */
+    virtual void setKeyRepeatCoalescing(bool enabled);
+
 private:
     Q_DISABLE_COPY(MAbstractInputMethodHost)
     Q_DECLARE_PRIVATE(MAbstractInputMethodHost)
@@ -24,7 +24,7 @@ MImUpdateEventPrivate::MImUpdateEventPrivate()
     , lastHints(Qt::ImhNone)
 {}
 
-MImUpdateEventPrivate::MImUpdateEventPrivate(const QMap<QString, QVariant> &newUpdate,
+MImUpdateEventPrivate::MImUpdateEventPrivate(const Maliit::WidgetState &newUpdate,
                                              const QStringList &newChangedProperties,
                                              const Qt::InputMethodHints &newLastHints)
     : update(newUpdate)
@@ -37,9 +37,8 @@ bool MImUpdateEventPrivate::isFlagSet(Qt::InputMethodHint hint,
 {
     bool result = false;
 
-    if (update.contains(Maliit::Internal::inputMethodHints)) {
-        const Qt::InputMethodHints hints(static_cast<Qt::InputMethodHints>(
-                                             update.value(Maliit::Internal::inputMethodHints).toLongLong()));
+    if (update.contains(Maliit::WidgetState::InputMethodHints)) {
+        const Qt::InputMethodHints hints(static_cast<Qt::InputMethodHints>(update.inputMethodHints()));
 
         result = (hints & hint);
     }
@@ -63,13 +62,22 @@ QVariant MImUpdateEventPrivate::extractProperty(const QString &key,
 
 MImUpdateEvent::MImUpdateEvent(const QMap<QString, QVariant> &update,
                                const QStringList &changedProperties)
-    : MImExtensionEvent(new MImUpdateEventPrivate(update, changedProperties, Qt::InputMethodHints()),
+    : MImExtensionEvent(new MImUpdateEventPrivate(Maliit::WidgetState::fromVariantMap(update),
+                                                  changedProperties, Qt::InputMethodHints()),
                         MImExtensionEvent::Update)
 {}
 
 MImUpdateEvent::MImUpdateEvent(const QMap<QString, QVariant> &update,
                                const QStringList &changedProperties,
                                const Qt::InputMethodHints &lastHints)
+    : MImExtensionEvent(new MImUpdateEventPrivate(Maliit::WidgetState::fromVariantMap(update),
+                                                  changedProperties, lastHints),
+                        MImExtensionEvent::Update)
+{}
+
+MImUpdateEvent::MImUpdateEvent(const Maliit::WidgetState &update,
+                               const QStringList &changedProperties,
+                               const Qt::InputMethodHints &lastHints)
     : MImExtensionEvent(new MImUpdateEventPrivate(update, changedProperties, lastHints),
                         MImExtensionEvent::Update)
 {}
@@ -89,8 +97,11 @@ QStringList MImUpdateEvent::propertiesChanged() const
 Qt::InputMethodHints MImUpdateEvent::hints(bool *changed) const
 {
     Q_D(const MImUpdateEvent);
-    return static_cast<Qt::InputMethodHints>(
-        d->extractProperty(Maliit::Internal::inputMethodHints, changed).toLongLong());
+    if (changed) {
+        *changed = d->changedProperties.contains(Maliit::Internal::inputMethodHints);
+    }
+
+    return static_cast<Qt::InputMethodHints>(d->update.inputMethodHints());
 }
 
 bool MImUpdateEvent::westernNumericInputEnforced(bool *changed) const
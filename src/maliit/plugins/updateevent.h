@@ -22,6 +22,10 @@
 class MImUpdateEventPrivate;
 class MImUpdateReceiver;
 
+namespace Maliit {
+    class WidgetState;
+}
+
 /*! \ingroup pluginapi
  * \brief Monitor the input method properties sent by the application.
  */
@@ -45,6 +49,14 @@ public:
                             const QStringList &propertiesChanged,
                             const Qt::InputMethodHints &lastHints);
 
+    //! \internal
+    //! C'tor used by the input method server, avoids converting the
+    //! widget state back into a map.
+    explicit MImUpdateEvent(const Maliit::WidgetState &update,
+                            const QStringList &propertiesChanged,
+                            const Qt::InputMethodHints &lastHints);
+    //! \internal_end
+
     //! Returns invalid QVariant if key is invalid.
     QVariant value(const QString &key) const;
 
@@ -16,6 +16,7 @@
 #define MIMUPDATEEVENT_P_H
 
 #include <maliit/plugins/extensionevent_p.h>
+#include <maliit/widgetstate.h>
 
 #include <QtCore>
 
@@ -23,13 +24,13 @@ class MImUpdateEventPrivate
     : public MImExtensionEventPrivate
 {
 public:
-    QMap<QString, QVariant> update;
+    Maliit::WidgetState update;
     QStringList changedProperties;
     Qt::InputMethodHints lastHints;
 
     explicit MImUpdateEventPrivate();
 
-    explicit MImUpdateEventPrivate(const QMap<QString, QVariant> &newUpdate,
+    explicit MImUpdateEventPrivate(const Maliit::WidgetState &newUpdate,
                                    const QStringList &newChangedProperties,
                                    const Qt::InputMethodHints &newLastHints);
 
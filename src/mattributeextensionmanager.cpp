@@ -29,10 +29,6 @@ namespace {
     const char * const KeysExtensionString("/keys");
     const char * const ToolbarExtensionString("/toolbar");
     const char * const GlobalExtensionString("/");
-
-    const char * const ToolbarIdAttribute = "toolbarId";
-    const char * const ToolbarAttribute = "toolbar";
-    const char * const FocusStateAttribute = "focusState";
 }
 
 MAttributeExtensionManager::MAttributeExtensionManager()
@@ -111,6 +107,8 @@ void MAttributeExtensionManager::registerAttributeExtension(const MAttributeExte
 
 void MAttributeExtensionManager::unregisterAttributeExtension(const MAttributeExtensionId &id)
 {
+    hibernatedAttributeExtensions.remove(id);
+
     AttributeExtensionContainer::iterator iterator(attributeExtensions.find(id));
 
     if (iterator == attributeExtensions.end()) {
@@ -209,12 +207,78 @@ void MAttributeExtensionManager::handleClientDisconnect(unsigned int clientId)
     }
 }
 
+void MAttributeExtensionManager::handleClientHibernated(unsigned int clientId)
+{
+    const QString service(QString::number(clientId));
+
+    Q_FOREACH (const MAttributeExtensionId &id, attributeExtensionIds) {
+        // The current extension may be in use by plugins
+        if (id.service() != service || id == attributeExtensionId) {
+            continue;
+        }
+
+        const QSharedPointer<MAttributeExtension> extension = attributeExtensions.take(id);
+        if (!extension) {
+            continue;
+        }
+
+        KeyOverrideStates states;
+        Q_FOREACH (const QSharedPointer<MKeyOverride> &keyOverride, extension->keyOverrideData()->keyOverrides()) {
+            QVariantMap properties;
+            const QMetaObject *metaObject = keyOverride->metaObject();
+            for (int i = QObject::staticMetaObject.propertyCount(); i < metaObject->propertyCount(); ++i) {
+                const QMetaProperty property = metaObject->property(i);
+                properties.insert(QString::fromLatin1(property.name()), property.read(keyOverride.data()));
+            }
+            Q_FOREACH (const QByteArray &name, keyOverride->dynamicPropertyNames()) {
+                properties.insert(QString::fromLatin1(name), keyOverride->property(name.constData()));
+            }
+            states.insert(keyOverride->keyId(), properties);
+        }
+        hibernatedAttributeExtensions.insert(id, states);
+    }
+}
+
+void MAttributeExtensionManager::handleClientResumed(unsigned int clientId)
+{
+    const QString service(QString::number(clientId));
+
+    Q_FOREACH (const MAttributeExtensionId &id, hibernatedAttributeExtensions.keys()) {
+        if (id.service() == service) {
+            resumeAttributeExtension(id);
+        }
+    }
+}
+
+void MAttributeExtensionManager::resumeAttributeExtension(const MAttributeExtensionId &id)
+{
+    if (!hibernatedAttributeExtensions.contains(id)) {
+        return;
+    }
+
+    const KeyOverrideStates states = hibernatedAttributeExtensions.take(id);
+    // MAttributeExtension does not use the file name, it was checked on registration
+    QSharedPointer<MAttributeExtension> extension(new MAttributeExtension(id, QString()));
+
+    for (KeyOverrideStates::const_iterator it = states.constBegin(); it != states.constEnd(); ++it) {
+        extension->keyOverrideData()->createKeyOverride(it.key());
+        const QSharedPointer<MKeyOverride> keyOverride = extension->keyOverrideData()->keyOverride(it.key());
+        for (QVariantMap::const_iterator property = it.value().constBegin();
+             property != it.value().constEnd(); ++property) {
+            keyOverride->setProperty(property.key().toLatin1().constData(), property.value());
+        }
+    }
+
+    attributeExtensions.insert(id, extension);
+}
+
 void MAttributeExtensionManager::handleExtendedAttributeUpdate(unsigned int clientId, int id,
                                    const QString &target, const QString &targetName,
                                    const QString &attribute, const QVariant &value)
 {
     MAttributeExtensionId globalId(id, QString::number(clientId));
     if (globalId.isValid() && attributeExtensionIds.contains(globalId)) {
+        resumeAttributeExtension(globalId);
         setExtendedAttribute(globalId, target, targetName, attribute, value);
     }
 }
@@ -239,8 +303,8 @@ void MAttributeExtensionManager::handleAttributeExtensionUnregistered(unsigned i
 }
 
 void MAttributeExtensionManager::handleWidgetStateChanged(unsigned int clientId,
-                                                          const QMap<QString, QVariant> &newState,
-                                                          const QMap<QString, QVariant> &oldState,
+                                                          const Maliit::WidgetState &newState,
+                                                          const Maliit::WidgetState &oldState,
                                                           bool focusChanged)
 
 {
@@ -250,24 +314,23 @@ void MAttributeExtensionManager::handleWidgetStateChanged(unsigned int clientId,
     MAttributeExtensionId newAttributeExtensionId;
     oldAttributeExtensionId = attributeExtensionId;
 
-    QVariant variant = newState[ToolbarIdAttribute];
-    if (variant.isValid()) {
+    if (newState.contains(Maliit::WidgetState::ToolbarId)) {
         // map toolbar id from local to global
-        newAttributeExtensionId = MAttributeExtensionId(variant.toInt(), QString::number(clientId));
+        newAttributeExtensionId = MAttributeExtensionId(newState.toolbarId(), QString::number(clientId));
     }
     if (!newAttributeExtensionId.isValid()) {
         newAttributeExtensionId = MAttributeExtensionId::standardAttributeExtensionId();
     }
+    resumeAttributeExtension(newAttributeExtensionId);
 
-    variant = newState[FocusStateAttribute];
-    if (not variant.isValid()) {
+    if (not newState.contains(Maliit::WidgetState::FocusState)) {
         qCritical() << __PRETTY_FUNCTION__ << "Invalid focus state";
     }
-    bool widgetFocusState = variant.toBool();
+    bool widgetFocusState = newState.focusState();
 
     // compare the toolbar id (global)
     if (oldAttributeExtensionId != newAttributeExtensionId) {
-        QString toolbarFile = newState[ToolbarAttribute].toString();
+        QString toolbarFile = newState.toolbar();
         if (!contains(newAttributeExtensionId) && !toolbarFile.isEmpty()) {
             // register toolbar if toolbar manager does not contain it but
             // toolbar file is not empty. This can reload the toolbar data
@@ -276,9 +339,8 @@ void MAttributeExtensionManager::handleWidgetStateChanged(unsigned int clientId,
             // and resending the toolbar information on server reconnect
             qWarning() << "Unregistered toolbar found in widget information";
 
-            variant = newState[ToolbarIdAttribute];
-            if (variant.isValid()) {
-                const int toolbarLocalId = variant.toInt();
+            if (newState.contains(Maliit::WidgetState::ToolbarId)) {
+                const int toolbarLocalId = newState.toolbarId();
                 // FIXME: brittle to call the signal handler directly like this
                 handleAttributeExtensionRegistered(clientId, toolbarLocalId, toolbarFile);
             }
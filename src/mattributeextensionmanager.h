@@ -23,6 +23,7 @@
 #include <QSharedPointer>
 
 #include <maliit/namespace.h>
+#include <maliit/widgetstate.h>
 
 #include <maliit/plugins/keyoverridedata.h>
 #include <maliit/plugins/attributeextension.h>
@@ -103,13 +104,19 @@ public Q_SLOTS:
     void setCopyPasteState(bool copyAvailable, bool pasteAvailable);
 
     void handleClientDisconnect(unsigned int clientId);
+    /*!
+     * \brief Releases the attribute extensions of \a clientId, keeping only their key overrides' values.
+     * They are restored by handleClientResumed(), or when the client changes one of their attributes.
+     */
+    void handleClientHibernated(unsigned int clientId);
+    void handleClientResumed(unsigned int clientId);
     void handleAttributeExtensionRegistered(unsigned int clientId, int id, const QString &attributeExtension);
     void handleAttributeExtensionUnregistered(unsigned int clientId, int id);
     void handleExtendedAttributeUpdate(unsigned int clientId, int id,
                                        const QString &target, const QString &targetName,
                                        const QString &attribute, const QVariant &value);
-    void handleWidgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
-                                  const QMap<QString, QVariant> &oldState, bool focusChanged);
+    void handleWidgetStateChanged(unsigned int clientId, const Maliit::WidgetState &newState,
+                                  const Maliit::WidgetState &oldState, bool focusChanged);
 
 Q_SIGNALS:
     //! This signal is emited when a new key override is created.
@@ -152,12 +159,20 @@ private:
      */
     QList<MAttributeExtensionId> attributeExtensionIdList() const;
 
+    //! Restores the attribute extension \a id released by handleClientHibernated()
+    void resumeAttributeExtension(const MAttributeExtensionId &id);
+
+    //! Property values of each key override, by key id
+    typedef QMap<QString, QVariantMap> KeyOverrideStates;
+
     typedef QHash<MAttributeExtensionId, QSharedPointer<MAttributeExtension> > AttributeExtensionContainer;
     //! all registered attribute extensions
     AttributeExtensionContainer attributeExtensions;
 
     MAttributeExtensionId attributeExtensionId; //current attribute extension id
     QSet<MAttributeExtensionId> attributeExtensionIds; //all attribute extension ids
+    //! attribute extensions of hibernated clients
+    QHash<MAttributeExtensionId, KeyOverrideStates> hibernatedAttributeExtensions;
 
     //! Copy/paste button status
     Maliit::CopyPasteState copyPasteStatus;
@@ -24,7 +24,6 @@
 #include "mimhwkeyboardtracker.h"
 #include <maliit/plugins/updateevent.h>
 #include "mimsubviewoverride.h"
-#include "maliit/namespaceinternal.h"
 #include <maliit/settingdata.h>
 #include "windowgroup.h"
 
@@ -42,8 +41,6 @@ namespace
 {
     const QString DefaultPluginLocation(MALIIT_PLUGINS_DIR);
 
-    const char * const VisualizationAttribute = "visualizationPriority";
-    const char * const FocusStateAttribute = "focusState";
 
     const QString ConfigRoot           = MALIIT_CONFIG_ROOT;
     const QString MImPluginPaths       = ConfigRoot + "paths";
@@ -1128,15 +1125,18 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
     connect(d->mICConnection.data(), SIGNAL(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)),
             this, SLOT(processKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)));
 
-    connect(d->mICConnection.data(), SIGNAL(widgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)),
-            this, SLOT(handleWidgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)));
+    connect(d->mICConnection.data(), SIGNAL(receivedKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)),
+            this, SLOT(processKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)));
+
+    connect(d->mICConnection.data(), SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)),
+            this, SLOT(handleWidgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
 
     // Connect connection and MAttributeExtensionManager
     connect(d->mICConnection.data(), SIGNAL(copyPasteStateChanged(bool,bool)),
             d->attributeExtensionManager.data(), SLOT(setCopyPasteState(bool, bool)));
 
-    connect(d->mICConnection.data(), SIGNAL(widgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)),
-            d->attributeExtensionManager.data(), SLOT(handleWidgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)));
+    connect(d->mICConnection.data(), SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)),
+            d->attributeExtensionManager.data(), SLOT(handleWidgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
 
     connect(d->mICConnection.data(), SIGNAL(attributeExtensionRegistered(uint, int, QString)),
             d->attributeExtensionManager.data(), SLOT(handleAttributeExtensionRegistered(uint, int, QString)));
@@ -1153,6 +1153,12 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
     connect(d->mICConnection.data(), SIGNAL(clientDisconnected(uint)),
             d->attributeExtensionManager.data(), SLOT(handleClientDisconnect(uint)));
 
+    connect(d->mICConnection.data(), SIGNAL(clientHibernated(uint)),
+            d->attributeExtensionManager.data(), SLOT(handleClientHibernated(uint)));
+
+    connect(d->mICConnection.data(), SIGNAL(clientResumed(uint)),
+            d->attributeExtensionManager.data(), SLOT(handleClientResumed(uint)));
+
     connect(d->mICConnection.data(), SIGNAL(attributeExtensionRegistered(uint, int, QString)),
             d->sharedAttributeExtensionManager.data(), SLOT(handleAttributeExtensionRegistered(uint, int, QString)));
 
@@ -1444,41 +1450,20 @@ void MIMPluginManager::handleClientChange()
 }
 
 void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
-                                                const QMap<QString, QVariant> &newState,
-                                                const QMap<QString, QVariant> &oldState,
+                                                const Maliit::WidgetState &newState,
+                                                const Maliit::WidgetState &oldState,
                                                 bool focusChanged)
 {
     Q_UNUSED(clientId);
 
     // check visualization change
-    bool oldVisualization = false;
-    bool newVisualization = false;
-
-    QVariant variant = oldState[VisualizationAttribute];
-
-    if (variant.isValid()) {
-        oldVisualization = variant.toBool();
-    }
-
-    variant = newState[VisualizationAttribute];
-    if (variant.isValid()) {
-        newVisualization = variant.toBool();
-    }
+    const bool oldVisualization = oldState.visualizationPriority();
+    const bool newVisualization = newState.visualizationPriority();
 
     // update state
-    QStringList changedProperties;
-    for (QMap<QString, QVariant>::const_iterator iter = newState.constBegin();
-         iter != newState.constEnd();
-         ++iter)
-    {
-        if (oldState.value(iter.key()) != iter.value()) {
-            changedProperties.append(iter.key());
-        }
+    const QStringList changedProperties = newState.changedKeys(oldState);
 
-    }
-
-    variant = newState[FocusStateAttribute];
-    const bool widgetFocusState = variant.toBool();
+    const bool widgetFocusState = newState.focusState();
 
     if (focusChanged) {
         Q_FOREACH (MAbstractInputMethod *target, targets()) {
@@ -1493,7 +1478,7 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
         }
     }
 
-    const Qt::InputMethodHints lastHints = static_cast<Qt::InputMethodHints>(newState.value(Maliit::Internal::inputMethodHints).toLongLong());
+    const Qt::InputMethodHints lastHints = static_cast<Qt::InputMethodHints>(newState.inputMethodHints());
     MImUpdateEvent ev(newState, changedProperties, lastHints);
 
     // general notification last
@@ -1542,6 +1527,38 @@ void MIMPluginManager::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
     }
 }
 
+void MIMPluginManager::processKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                                        const QString &text, int repeats, bool releases,
+                                        quint32 nativeScanCode, quint32 nativeModifiers,
+                                        unsigned long time)
+{
+    Q_D(MIMPluginManager);
+    const QSet<MAbstractInputMethod *> currentTargets = targets();
+
+    Q_FOREACH (const MIMPluginManagerPrivate::PluginDescription &description, d->plugins) {
+        MAbstractInputMethod *target = description.inputMethod;
+        if (!currentTargets.contains(target)) {
+            continue;
+        }
+
+        if (description.imHost->keyRepeatCoalescing()) {
+            target->processKeyEvent(QEvent::KeyPress, keyCode, modifiers, text, true, repeats,
+                                    nativeScanCode, nativeModifiers, time);
+            continue;
+        }
+
+        // Plugins which did not opt in get the events the application coalesced
+        for (int i = 0; i < repeats; ++i) {
+            if (releases) {
+                target->processKeyEvent(QEvent::KeyRelease, keyCode, modifiers, text, true, 1,
+                                        nativeScanCode, nativeModifiers, time);
+            }
+            target->processKeyEvent(QEvent::KeyPress, keyCode, modifiers, text, true, 1,
+                                    nativeScanCode, nativeModifiers, time);
+        }
+    }
+}
+
 QSet<MAbstractInputMethod *> MIMPluginManager::targets()
 {
     Q_D(MIMPluginManager);
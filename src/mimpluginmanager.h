@@ -145,8 +145,8 @@ private Q_SLOTS:
 
     void handleClientChange();
 
-    void handleWidgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
-                                  const QMap<QString, QVariant> &oldState, bool focusChanged);
+    void handleWidgetStateChanged(unsigned int clientId, const Maliit::WidgetState &newState,
+                                  const Maliit::WidgetState &oldState, bool focusChanged);
     void handleMouseClickOnPreedit(const QPoint &pos, const QRect &preeditRect);
     void handlePreeditChanged(const QString &text, int cursorPos);
 
@@ -154,6 +154,10 @@ private Q_SLOTS:
                          Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat,
                          int count, quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
 
+    void processKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers, const QString &text,
+                          int repeats, bool releases, quint32 nativeScanCode,
+                          quint32 nativeModifiers, unsigned long time);
+
     void pluginSettingsRequested(int clientId, const QString &descriptionLanguage);
 
     /*!
@@ -14,6 +14,7 @@
 
 #include "mimserveroptions.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -31,7 +32,11 @@ namespace {
 
     CommandLineParameter AvailableConnectionParameters[] = {
         { "-allow-anonymous",   "Allow anonymous/unauthenticated use of DBus interface"},
-        { "-override-address",  "Override the DBus peer-to-peer address for input-context"}
+        { "-override-address",  "Override the DBus peer-to-peer address for input-context"},
+        { "-unix-socket",       "Listen on the given Unix socket path instead of using DBus"},
+        { "-coalesce-widget-state", "Notify plugins of widget state updates at most once per frame"},
+        { "-hibernate-after",   "Release the resources of applications inactive for the given number of seconds"},
+        { "-client-quota",      "Handle at most the given number of widget state and attribute updates per second for each application"}
     };
 
     struct IgnoredParameter {
@@ -354,6 +359,39 @@ MImServerConnectionOptionsParser::parseParameter(const char *parameter,
                     fprintf(stderr, "ERROR: No argument passed to -override-address\n");
                     *argumentCount = 0;
                 }
+            } else if (!strcmp(parameter, "-unix-socket")) {
+                if (next) {
+                    storage->unixSocketPath = QString::fromUtf8(next);
+                    *argumentCount = 1;
+                } else {
+                    fprintf(stderr, "ERROR: No argument passed to -unix-socket\n");
+                    *argumentCount = 0;
+                }
+            } else if (!strcmp(parameter, "-coalesce-widget-state")) {
+                storage->coalesceWidgetState = true;
+                *argumentCount = 0;
+            } else if (!strcmp(parameter, "-hibernate-after")) {
+                bool valid = false;
+                const int seconds = next ? QString::fromUtf8(next).toInt(&valid) : 0;
+                // The timeout is applied in ms, which must fit into an int
+                if (valid && seconds >= 0 && seconds <= INT_MAX / 1000) {
+                    storage->hibernationTimeout = seconds;
+                    *argumentCount = 1;
+                } else {
+                    fprintf(stderr, "ERROR: No number of seconds up to %d passed to -hibernate-after\n",
+                            INT_MAX / 1000);
+                    *argumentCount = 0;
+                }
+            } else if (!strcmp(parameter, "-client-quota")) {
+                bool valid = false;
+                const int messages = next ? QString::fromUtf8(next).toInt(&valid) : 0;
+                if (valid && messages >= 0) {
+                    storage->clientQuota = messages;
+                    *argumentCount = 1;
+                } else {
+                    fprintf(stderr, "ERROR: No number of messages passed to -client-quota\n");
+                    *argumentCount = 0;
+                }
             } else {
                 fprintf(stderr, "ERROR: connection option %s declared but unhandled\n", parameter);
             }
@@ -378,6 +416,9 @@ void MImServerConnectionOptionsParser::printAvailableOptions(const char *format)
 }
 MImServerConnectionOptions::MImServerConnectionOptions()
     : allowAnonymous(false)
+    , coalesceWidgetState(false)
+    , hibernationTimeout(0)
+    , clientQuota(0)
 {
     const ParserBasePtr p(new MImServerConnectionOptionsParser(this));
     parsers.append(p);
@@ -40,6 +40,14 @@ public:
     //! Contains true if user asks for help or provided incorrect parameter
     bool allowAnonymous;
     QString overriddenAddress;
+    //! Path of the Unix socket to listen on instead of D-Bus, empty to use D-Bus
+    QString unixSocketPath;
+    //! Merge widget state updates within one frame, see MInputContextConnection::setWidgetStateCoalescing()
+    bool coalesceWidgetState;
+    //! Seconds after which inactive clients are hibernated, 0 to never hibernate them
+    int hibernationTimeout;
+    //! Bulk messages per second handled for each application, 0 for no limit, see MInputContextConnection::setClientQuota()
+    int clientQuota;
 };
 
 
@@ -30,11 +30,17 @@ MInputMethodHost::MInputMethodHost(const QSharedPointer<MInputContextConnection>
       pluginManager(pluginManager),
       inputMethod(0),
       enabled(false),
+      mKeyRepeatCoalescing(false),
       pluginId(plugin),
       pluginDescription(description),
       mWindowGroup(windowGroup)
 {
-    // nothing
+    connect(connection.data(), SIGNAL(preeditRectangleReceived(int,QRect,bool)),
+            this, SLOT(handlePreeditRectangleReceived(int,QRect,bool)));
+    connect(connection.data(), SIGNAL(selectionReceived(int,QString,bool)),
+            this, SLOT(handleSelectionReceived(int,QString,bool)));
+    connect(connection.data(), SIGNAL(surroundingTextReceived(int,int,QString,bool)),
+            this, SLOT(handleSurroundingTextReceived(int,int,QString,bool)));
 }
 
 
@@ -89,6 +95,57 @@ QString MInputMethodHost::selection(bool &valid)
     return connection->selection(valid);
 }
 
+int MInputMethodHost::requestSelection()
+{
+    const int requestId = connection->requestSelection();
+    mPendingRequests.insert(requestId);
+    return requestId;
+}
+
+void MInputMethodHost::handleSelectionReceived(int requestId, const QString &selection, bool valid)
+{
+    if (mPendingRequests.remove(requestId)) {
+        Q_EMIT selectionReceived(requestId, selection, valid);
+    }
+}
+
+void MInputMethodHost::setSurroundingTextWindow(int characters)
+{
+    if (enabled) {
+        connection->setSurroundingTextWindow(characters);
+    }
+}
+
+int MInputMethodHost::surroundingTextOffset(bool &valid)
+{
+    return connection->surroundingTextOffset(valid);
+}
+
+int MInputMethodHost::requestSurroundingText(int start, int length)
+{
+    const int requestId = connection->requestSurroundingText(start, length);
+    mPendingRequests.insert(requestId);
+    return requestId;
+}
+
+void MInputMethodHost::handleSurroundingTextReceived(int requestId, int start,
+                                                     const QString &text, bool valid)
+{
+    if (mPendingRequests.remove(requestId)) {
+        Q_EMIT surroundingTextReceived(requestId, start, text, valid);
+    }
+}
+
+void MInputMethodHost::setKeyRepeatCoalescing(bool enabled)
+{
+    mKeyRepeatCoalescing = enabled;
+}
+
+bool MInputMethodHost::keyRepeatCoalescing() const
+{
+    return mKeyRepeatCoalescing;
+}
+
 void MInputMethodHost::registerWindow (QWindow *window,
                                        Maliit::Position position)
 {
@@ -110,6 +167,20 @@ QRect MInputMethodHost::preeditRectangle(bool &valid)
     return connection->preeditRectangle(valid);
 }
 
+int MInputMethodHost::requestPreeditRectangle()
+{
+    const int requestId = connection->requestPreeditRectangle();
+    mPendingRequests.insert(requestId);
+    return requestId;
+}
+
+void MInputMethodHost::handlePreeditRectangleReceived(int requestId, const QRect &rectangle, bool valid)
+{
+    if (mPendingRequests.remove(requestId)) {
+        Q_EMIT preeditRectangleReceived(requestId, rectangle, valid);
+    }
+}
+
 QRect MInputMethodHost::cursorRectangle(bool &valid)
 {
     return connection->cursorRectangle(valid);
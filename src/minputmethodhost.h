@@ -17,6 +17,8 @@
 
 #include <maliit/plugins/abstractinputmethodhost.h>
 
+#include <QSet>
+
 class MInputContextConnection;
 class MIMPluginManager;
 class MAbstractInputMethod;
@@ -54,6 +56,9 @@ public:
     //! Multiple calls is (currently) undefined behavior.
     void setInputMethod(MAbstractInputMethod *inputMethod);
 
+    //! true if the input method accepts coalesced autorepeats, see setKeyRepeatCoalescing()
+    bool keyRepeatCoalescing() const;
+
     // \reimp
     virtual int contentType(bool &valid);
     virtual bool correctionEnabled(bool &valid);
@@ -63,10 +68,16 @@ public:
     virtual bool hasSelection(bool &valid);
     virtual int inputMethodMode(bool &valid);
     virtual QRect preeditRectangle(bool &valid);
+    virtual int requestPreeditRectangle();
     virtual QRect cursorRectangle(bool &valid);
     virtual int anchorPosition(bool &valid);
     virtual bool hiddenText(bool &valid);
     virtual QString selection(bool &valid);
+    virtual int requestSelection();
+    virtual void setSurroundingTextWindow(int characters);
+    virtual int surroundingTextOffset(bool &valid);
+    virtual int requestSurroundingText(int start, int length);
+    virtual void setKeyRepeatCoalescing(bool enabled);
     virtual void registerWindow (QWindow *window,
                                  Maliit::Position position);
     virtual void sendPreeditString(const QString &string,
@@ -103,6 +114,11 @@ public:
                                                          const QVariantMap &attributes);
     // \reimp_end
 
+private Q_SLOTS:
+    void handlePreeditRectangleReceived(int requestId, const QRect &rectangle, bool valid);
+    void handleSelectionReceived(int requestId, const QString &selection, bool valid);
+    void handleSurroundingTextReceived(int requestId, int start, const QString &text, bool valid);
+
 private:
     Q_DISABLE_COPY(MInputMethodHost)
 
@@ -110,9 +126,12 @@ private:
     MIMPluginManager *pluginManager;
     MAbstractInputMethod *inputMethod;
     bool enabled;
+    bool mKeyRepeatCoalescing;
     QString pluginId;
     QString pluginDescription;
     QSharedPointer<Maliit::WindowGroup> mWindowGroup;
+    //! Requests made through this host, the connection is shared by all plugins
+    QSet<int> mPendingRequests;
 };
 
 //! \internal_end
@@ -17,6 +17,16 @@ SUBDIRS += \
           ut_mimonscreenplugins \
           ut_minputmethodquickplugin \
           ut_mimserveroptions \
+          ut_widgetstate \
+          ut_textmirror \
+          ut_sharedmemorylane \
+          ut_dbusaddress \
+          ut_lockfreequeue \
+          ut_utf8offsetindex \
+          ut_inputcontextmessages \
+          ut_unixsocketconnection \
+          ut_loopbackconnection \
+          ut_minputcontextconnection \
 
 SUBDIRS += \
           ut_mimpluginmanager \
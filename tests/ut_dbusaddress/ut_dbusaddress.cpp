@@ -0,0 +1,113 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_dbusaddress.h"
+
+#include <inputcontextdbusaddress.h>
+#include <serverdbusaddress.h>
+
+#include <QTemporaryDir>
+
+using Maliit::Server::DBus::AddressPublisher;
+using Maliit::InputContext::DBus::DynamicAddress;
+
+namespace {
+    const char * const FirstAddress = "unix:abstract=/tmp/dbus-first,guid=0123";
+    const char * const SecondAddress = "unix:abstract=/tmp/dbus-second,guid=4567";
+}
+
+void Ut_DBusAddress::init()
+{
+    savedRuntimeDirectory = qgetenv("XDG_RUNTIME_DIR");
+    runtimeDirectory = new QTemporaryDir;
+    QVERIFY(runtimeDirectory->isValid());
+    qputenv("XDG_RUNTIME_DIR", QFile::encodeName(runtimeDirectory->path()));
+}
+
+void Ut_DBusAddress::cleanup()
+{
+    qputenv("XDG_RUNTIME_DIR", savedRuntimeDirectory);
+    delete runtimeDirectory;
+    runtimeDirectory = 0;
+}
+
+void Ut_DBusAddress::testAddressFileRoundTrip()
+{
+    const QString path = AddressPublisher::addressFilePath();
+    QCOMPARE(QFileInfo(path).path(), runtimeDirectory->path());
+
+    QVERIFY(AddressPublisher::writeAddressFile(QString::fromLatin1(FirstAddress)));
+    QCOMPARE(QFile::permissions(path) & (QFile::ReadGroup | QFile::ReadOther), QFile::Permissions());
+
+    DynamicAddress address;
+    QSignalSpy spy(&address, SIGNAL(addressReceived(QString)));
+    address.get();
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().first().toString(), QString::fromLatin1(FirstAddress));
+
+    // a server only removes the file while it holds its own address
+    AddressPublisher::removeAddressFile(QString::fromLatin1(SecondAddress));
+    QVERIFY(QFile::exists(path));
+    AddressPublisher::removeAddressFile(QString::fromLatin1(FirstAddress));
+    QVERIFY(!QFile::exists(path));
+}
+
+void Ut_DBusAddress::testAddressFileNextToSocket()
+{
+    // where the README tells to put the Unix socket
+    QVERIFY(QDir(runtimeDirectory->path()).mkdir(QString::fromLatin1("maliit-server")));
+
+    QVERIFY(AddressPublisher::writeAddressFile(QString::fromLatin1(FirstAddress)));
+    AddressPublisher::removeAddressFile(QString::fromLatin1(FirstAddress));
+
+    QVERIFY(QFileInfo(runtimeDirectory->path() + QString::fromLatin1("/maliit-server")).isDir());
+}
+
+void Ut_DBusAddress::testStaleAddressFallback()
+{
+    QVERIFY(AddressPublisher::writeAddressFile(QString::fromLatin1(FirstAddress)));
+
+    DynamicAddress address;
+    QSignalSpy spy(&address, SIGNAL(addressReceived(QString)));
+    address.get();
+    QCOMPARE(spy.count(), 1);
+
+    // only the address from the file is retried through the session bus, and only once
+    QVERIFY(!address.addressFailed(QString::fromLatin1(SecondAddress)));
+    QVERIFY(address.addressFailed(QString::fromLatin1(FirstAddress)));
+    QVERIFY(!address.addressFailed(QString::fromLatin1(FirstAddress)));
+
+    // the stale file is not used again, the session bus is asked instead
+    address.get();
+    QTest::qWait(50);
+    Q_FOREACH (const QList<QVariant> &arguments, spy.mid(1)) {
+        QVERIFY(arguments.first().toString() != QString::fromLatin1(FirstAddress));
+    }
+
+    // a new server replaces the file
+    spy.clear();
+    QVERIFY(AddressPublisher::writeAddressFile(QString::fromLatin1(SecondAddress)));
+    address.get();
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().first().toString(), QString::fromLatin1(SecondAddress));
+}
+
+void Ut_DBusAddress::testNoRuntimeDirectory()
+{
+    qputenv("XDG_RUNTIME_DIR", QByteArray());
+
+    QVERIFY(AddressPublisher::addressFilePath().isEmpty());
+    QVERIFY(!AddressPublisher::writeAddressFile(QString::fromLatin1(FirstAddress)));
+}
+
+QTEST_MAIN(Ut_DBusAddress)
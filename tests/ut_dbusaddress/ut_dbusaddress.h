@@ -0,0 +1,40 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_DBUSADDRESS_H
+#define UT_DBUSADDRESS_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class QTemporaryDir;
+
+class Ut_DBusAddress : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testAddressFileRoundTrip();
+    void testAddressFileNextToSocket();
+    void testStaleAddressFallback();
+    void testNoRuntimeDirectory();
+
+private:
+    QTemporaryDir *runtimeDirectory;
+    QByteArray savedRuntimeDirectory;
+};
+
+#endif // UT_DBUSADDRESS_H
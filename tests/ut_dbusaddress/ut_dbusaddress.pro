@@ -0,0 +1,12 @@
+include(../common_top.pri)
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_dbusaddress.h \
+
+SOURCES += \
+    ut_dbusaddress.cpp \
+
+include(../common_check.pri)
@@ -0,0 +1,359 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_inputcontextmessages.h"
+
+#include <inputcontextmessages.h>
+#include <mimserverconnection.h>
+#include <minputcontextconnection.h>
+
+namespace {
+    //! Counts the full preedits asked for
+    class ResyncingConnection : public MImServerConnection
+    {
+    public:
+        ResyncingConnection() : requests(0) {}
+
+        virtual void requestFullPreedit() { ++requests; }
+
+        int requests;
+    };
+}
+
+MessageRecorder::MessageRecorder(MImServerConnection *connection)
+    : QObject()
+{
+    connect(connection, SIGNAL(commitString(QString,int,int,int)),
+            this, SLOT(commitString(QString,int,int,int)));
+    connect(connection, SIGNAL(updatePreedit(QString,QList<Maliit::PreeditTextFormat>,int,int,int)),
+            this, SLOT(updatePreedit(QString,QList<Maliit::PreeditTextFormat>,int,int,int)));
+    connect(connection, SIGNAL(keyEvent(int,int,int,QString,bool,int,Maliit::EventRequestType)),
+            this, SLOT(keyEvent(int,int,int,QString,bool,int,Maliit::EventRequestType)));
+}
+
+MessageRecorder::MessageRecorder(MInputContextConnection *connection)
+    : QObject()
+{
+    connect(connection, SIGNAL(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)),
+            this, SLOT(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)));
+    connect(connection, SIGNAL(receivedKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)),
+            this, SLOT(receivedKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)));
+}
+
+void MessageRecorder::commitString(const QString &string, int replacementStart,
+                                   int replacementLength, int cursorPos)
+{
+    calls.append(QString("commit %1 %2 %3 %4").arg(string).arg(replacementStart)
+                 .arg(replacementLength).arg(cursorPos));
+}
+
+void MessageRecorder::updatePreedit(const QString &string,
+                                    const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                                    int replacementStart, int replacementLength, int cursorPos)
+{
+    QString formats;
+    Q_FOREACH (const Maliit::PreeditTextFormat &format, preeditFormats) {
+        formats += QString("(%1,%2,%3)").arg(format.start).arg(format.length).arg(format.preeditFace);
+    }
+
+    calls.append(QString("preedit %1 %2 %3 %4 %5").arg(string).arg(formats).arg(replacementStart)
+                 .arg(replacementLength).arg(cursorPos));
+}
+
+void MessageRecorder::keyEvent(int type, int key, int modifiers, const QString &text, bool autoRepeat,
+                               int count, Maliit::EventRequestType requestType)
+{
+    calls.append(QString("key %1 %2 %3 %4 %5 %6 %7").arg(type).arg(key).arg(modifiers).arg(text)
+                 .arg(autoRepeat).arg(count).arg(requestType));
+}
+
+void MessageRecorder::receivedKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                       Qt::KeyboardModifiers modifiers, const QString &text,
+                                       bool autoRepeat, int count, quint32 nativeScanCode,
+                                       quint32 nativeModifiers, unsigned long time)
+{
+    calls.append(QString("process %1 %2 %3 %4 %5 %6 %7 %8 %9").arg(int(keyType)).arg(int(keyCode))
+                 .arg(int(modifiers)).arg(text).arg(autoRepeat).arg(count)
+                 .arg(nativeScanCode).arg(nativeModifiers).arg(time));
+}
+
+void MessageRecorder::receivedKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                                        const QString &text, int repeats, bool releases,
+                                        quint32 nativeScanCode, quint32 nativeModifiers,
+                                        unsigned long time)
+{
+    calls.append(QString("repeat %1 %2 %3 %4 %5 %6 %7 %8").arg(int(keyCode)).arg(int(modifiers))
+                 .arg(text).arg(repeats).arg(releases).arg(nativeScanCode).arg(nativeModifiers)
+                 .arg(time));
+}
+
+void Ut_InputContextMessages::init()
+{
+    connection = new MImServerConnection;
+    recorder = new MessageRecorder(connection);
+}
+
+void Ut_InputContextMessages::cleanup()
+{
+    delete recorder;
+    recorder = 0;
+    delete connection;
+    connection = 0;
+}
+
+void Ut_InputContextMessages::testCommitString()
+{
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeCommitString("hello", -1, 2, 3), connection));
+    QCOMPARE(recorder->calls, QStringList() << "commit hello -1 2 3");
+}
+
+void Ut_InputContextMessages::testUpdatePreedit()
+{
+    QList<Maliit::PreeditTextFormat> formats;
+    formats << Maliit::PreeditTextFormat(0, 2, Maliit::PreeditDefault)
+            << Maliit::PreeditTextFormat(2, 3, Maliit::PreeditNoCandidates);
+
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit("hello", formats, 0, 0, 5), connection));
+    QCOMPARE(recorder->calls,
+             QStringList() << QString("preedit hello (0,2,%1)(2,3,%2) 0 0 5")
+                              .arg(Maliit::PreeditDefault).arg(Maliit::PreeditNoCandidates));
+}
+
+void Ut_InputContextMessages::testKeyEvent()
+{
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::ShiftModifier,
+                                                            "A", true, 2, Maliit::EventRequestSignalOnly),
+                connection));
+    QCOMPARE(recorder->calls,
+             QStringList() << QString("key %1 %2 %3 A 1 2 %4")
+                              .arg(int(QEvent::KeyPress)).arg(int(Qt::Key_A)).arg(int(Qt::ShiftModifier))
+                              .arg(int(Maliit::EventRequestSignalOnly)));
+}
+
+void Ut_InputContextMessages::testBatch()
+{
+    QList<QByteArray> messages;
+    messages << Maliit::InputContextMessage::encodeUpdatePreedit("hel", QList<Maliit::PreeditTextFormat>(), 0, 0, 3)
+             << Maliit::InputContextMessage::encodeCommitString("hello", 0, 0, -1)
+             << Maliit::InputContextMessage::encodeUpdatePreedit("", QList<Maliit::PreeditTextFormat>(), 0, 0, -1);
+
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeBatch(messages), connection));
+    QCOMPARE(recorder->calls, QStringList() << "preedit hel  0 0 3"
+                                            << "commit hello 0 0 -1"
+                                            << "preedit   0 0 -1");
+
+    // batches are not nested
+    recorder->calls.clear();
+    const QByteArray inner = Maliit::InputContextMessage::encodeBatch(messages);
+    QVERIFY(not Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeBatch(QList<QByteArray>() << inner), connection));
+    QVERIFY(recorder->calls.isEmpty());
+}
+
+void Ut_InputContextMessages::testResetEpoch()
+{
+    const quint32 first = connection->startResetEpoch();
+    const quint32 second = connection->startResetEpoch();
+    QVERIFY(first != second);
+    QCOMPARE(connection->resetEpoch(), second);
+
+    // sent before the latest reset was handled by the server
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeCommitString("stale", 0, 0, -1, first), connection));
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit("stale", QList<Maliit::PreeditTextFormat>(),
+                                                                 0, 0, -1, first), connection));
+    QVERIFY(recorder->calls.isEmpty());
+
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeCommitString("current", 0, 0, -1, second), connection));
+    // messages without an epoch are always delivered
+    QByteArray untagged = Maliit::InputContextMessage::encodeCommitString("untagged", 0, 0, -1, first);
+    untagged.chop(sizeof(quint32));
+    QVERIFY(Maliit::InputContextMessage::dispatch(untagged, connection));
+    QCOMPARE(recorder->calls, QStringList() << "commit current 0 0 -1"
+                                            << "commit untagged 0 0 -1");
+}
+
+void Ut_InputContextMessages::testPreeditDelta()
+{
+    Maliit::InputContextMessage::PreeditBase base;
+    const QString composition("nihaoshijiewomenzou");
+
+    QList<Maliit::PreeditTextFormat> formats;
+    formats << Maliit::PreeditTextFormat(0, 5, Maliit::PreeditActive)
+            << Maliit::PreeditTextFormat(5, 14, Maliit::PreeditDefault);
+
+    // nothing to build on yet
+    QByteArray message = Maliit::InputContextMessage::encodeUpdatePreedit(&base, composition, formats, 0, 0, 19, 0);
+    QCOMPARE(int(quint8(message.at(0))), int(Maliit::InputContextMessage::UpdatePreedit));
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, connection));
+
+    const QByteArray full = Maliit::InputContextMessage::encodeUpdatePreedit("nihaoshijiewomenzoub", formats, 0, 0, 20, 0);
+    formats.last().length = 15;
+    message = Maliit::InputContextMessage::encodeUpdatePreedit(&base, "nihaoshijiewomenzoub", formats, 0, 0, 20, 0);
+    QCOMPARE(int(quint8(message.at(0))), int(Maliit::InputContextMessage::UpdatePreeditDelta));
+    QVERIFY(message.size() < full.size());
+    QCOMPARE(base.string, QString("nihaoshijiewomenzoub"));
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, connection));
+
+    // replacing in the middle
+    message = Maliit::InputContextMessage::encodeUpdatePreedit(&base, "nihaoSHIJIEwomenzoub", formats, 0, 0, 20, 0);
+    QCOMPARE(int(quint8(message.at(0))), int(Maliit::InputContextMessage::UpdatePreeditDelta));
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, connection));
+
+    const QString expectedFormats = QString("(0,5,%1)(5,%3,%2)")
+                                    .arg(Maliit::PreeditActive).arg(Maliit::PreeditDefault);
+    QCOMPARE(recorder->calls, QStringList() << "preedit nihaoshijiewomenzou " + expectedFormats.arg(14) + " 0 0 19"
+                                            << "preedit nihaoshijiewomenzoub " + expectedFormats.arg(15) + " 0 0 20"
+                                            << "preedit nihaoSHIJIEwomenzoub " + expectedFormats.arg(15) + " 0 0 20");
+    QCOMPARE(connection->preeditBase().string, base.string);
+
+    // too little in common
+    message = Maliit::InputContextMessage::encodeUpdatePreedit(&base, "ni", QList<Maliit::PreeditTextFormat>(), 0, 0, 2, 0);
+    QCOMPARE(int(quint8(message.at(0))), int(Maliit::InputContextMessage::UpdatePreedit));
+}
+
+void Ut_InputContextMessages::testPreeditDeltaBase()
+{
+    Maliit::InputContextMessage::PreeditBase base;
+    const QList<Maliit::PreeditTextFormat> formats;
+
+    const quint32 epoch = connection->startResetEpoch();
+
+    // dropped for its epoch, still what the next delta applies to
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijkl", formats, 0, 0, -1, 0),
+                connection));
+    QVERIFY(recorder->calls.isEmpty());
+
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklm", formats, 0, 0, -1, epoch),
+                connection));
+    QCOMPARE(recorder->calls, QStringList() << "preedit abcdefghijklm  0 0 -1");
+
+    // a delta not matching the base of the application is rejected
+    recorder->calls.clear();
+    connection->setPreeditBase("abc", formats);
+    QVERIFY(not Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklmn", formats, 0, 0, -1, epoch),
+                connection));
+    QVERIFY(recorder->calls.isEmpty());
+}
+
+void Ut_InputContextMessages::testPreeditResync()
+{
+    ResyncingConnection client;
+    MessageRecorder clientRecorder(&client);
+    Maliit::InputContextMessage::PreeditBase base;
+    const QList<Maliit::PreeditTextFormat> formats;
+
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijkl", formats, 0, 0, -1, 0),
+                &client));
+
+    // the server moved on to a preedit the application never got
+    Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklm", formats, 0, 0, -1, 0);
+    const QByteArray rejected =
+        Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklmno", formats, 0, 0, -1, 0);
+    client.setPreeditBase("abc", formats);
+    QVERIFY(not Maliit::InputContextMessage::dispatch(rejected, &client));
+    client.discardPreeditBase();
+    QVERIFY(not client.hasPreeditBase());
+    QCOMPARE(client.requests, 1);
+
+    // deltas sent before the server got the request are dropped, it is only made once
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklmnop", formats, 0, 0, -1, 0),
+                &client));
+    client.discardPreeditBase();
+    QCOMPARE(client.requests, 1);
+
+    // the server dropped its base, so the next preedit is sent in full
+    base = Maliit::InputContextMessage::PreeditBase();
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklmnopq", formats, 0, 0, -1, 0),
+                &client));
+    QVERIFY(client.hasPreeditBase());
+    QVERIFY(Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeUpdatePreedit(&base, "abcdefghijklmnopqr", formats, 0, 0, -1, 0),
+                &client));
+
+    QCOMPARE(clientRecorder.calls, QStringList() << "preedit abcdefghijkl  0 0 -1"
+                                                 << "preedit abcdefghijklmnopq  0 0 -1"
+                                                 << "preedit abcdefghijklmnopqr  0 0 -1");
+    QCOMPARE(client.requests, 1);
+}
+
+void Ut_InputContextMessages::testProcessKeyEvent()
+{
+    MInputContextConnection server;
+    MessageRecorder serverRecorder(&server);
+    server.activateContext(1);
+
+    const QByteArray message =
+        Maliit::InputContextMessage::encodeProcessKeyEvent(QEvent::KeyRelease, Qt::Key_B, Qt::ControlModifier,
+                                                           "b", false, 1, 56, 4, 1234);
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, &server, 1));
+    QCOMPARE(serverRecorder.calls,
+             QStringList() << QString("process %1 %2 %3 b 0 1 56 4 1234")
+                              .arg(int(QEvent::KeyRelease)).arg(int(Qt::Key_B)).arg(int(Qt::ControlModifier)));
+
+    // each direction only accepts its own messages
+    QVERIFY(not Maliit::InputContextMessage::dispatch(message, connection));
+    QVERIFY(not Maliit::InputContextMessage::dispatch(
+                Maliit::InputContextMessage::encodeCommitString("hello", 0, 0, -1), &server, 1));
+    QVERIFY(recorder->calls.isEmpty());
+    QCOMPARE(serverRecorder.calls.size(), 1);
+}
+
+void Ut_InputContextMessages::testProcessKeyRepeat()
+{
+    MInputContextConnection server;
+    MessageRecorder serverRecorder(&server);
+
+    const QByteArray message =
+        Maliit::InputContextMessage::encodeProcessKeyRepeat(Qt::Key_A, Qt::ShiftModifier, "A", 7, true,
+                                                            38, 1, 5678);
+
+    // dropped while the client is not active
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, &server, 1));
+    QVERIFY(serverRecorder.calls.isEmpty());
+
+    server.activateContext(1);
+    QVERIFY(Maliit::InputContextMessage::dispatch(message, &server, 1));
+    QCOMPARE(serverRecorder.calls,
+             QStringList() << QString("repeat %1 %2 A 7 1 38 1 5678")
+                              .arg(int(Qt::Key_A)).arg(int(Qt::ShiftModifier)));
+
+    QVERIFY(not Maliit::InputContextMessage::dispatch(message, connection));
+    QVERIFY(recorder->calls.isEmpty());
+}
+
+void Ut_InputContextMessages::testMalformed()
+{
+    QByteArray message = Maliit::InputContextMessage::encodeCommitString("hello", 0, 0, -1);
+    message.chop(2);
+    QVERIFY(not Maliit::InputContextMessage::dispatch(message, connection));
+
+    message = Maliit::InputContextMessage::encodeBatch(QList<QByteArray>() << message);
+    QVERIFY(not Maliit::InputContextMessage::dispatch(message, connection));
+
+    QVERIFY(recorder->calls.isEmpty());
+}
+
+QTEST_MAIN(Ut_InputContextMessages)
@@ -0,0 +1,76 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_INPUTCONTEXTMESSAGES_H
+#define UT_INPUTCONTEXTMESSAGES_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+#include <maliit/namespace.h>
+
+class MImServerConnection;
+class MInputContextConnection;
+
+//! Records the signals emitted by MImServerConnection or MInputContextConnection, in order
+class MessageRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MessageRecorder(MImServerConnection *connection);
+    explicit MessageRecorder(MInputContextConnection *connection);
+
+    QStringList calls;
+
+public Q_SLOTS:
+    void commitString(const QString &string, int replacementStart,
+                      int replacementLength, int cursorPos);
+    void updatePreedit(const QString &string, const QList<Maliit::PreeditTextFormat> &preeditFormats,
+                       int replacementStart, int replacementLength, int cursorPos);
+    void keyEvent(int type, int key, int modifiers, const QString &text, bool autoRepeat,
+                  int count, Maliit::EventRequestType requestType);
+    void receivedKeyEvent(QEvent::Type keyType, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                          const QString &text, bool autoRepeat, int count,
+                          quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    void receivedKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers, const QString &text,
+                           int repeats, bool releases,
+                           quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+};
+
+class Ut_InputContextMessages : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testCommitString();
+    void testUpdatePreedit();
+    void testKeyEvent();
+    void testBatch();
+    void testResetEpoch();
+    void testPreeditDelta();
+    void testPreeditDeltaBase();
+    void testPreeditResync();
+    void testProcessKeyEvent();
+    void testProcessKeyRepeat();
+    void testMalformed();
+
+private:
+    MImServerConnection *connection;
+    MessageRecorder *recorder;
+};
+
+#endif // UT_INPUTCONTEXTMESSAGES_H
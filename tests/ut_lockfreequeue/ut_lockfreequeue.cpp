@@ -0,0 +1,121 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_lockfreequeue.h"
+
+#include <lockfreequeue.h>
+
+#include <QThread>
+
+namespace {
+    const int ProducedCount = 100000;
+
+    class Producer : public QThread
+    {
+    public:
+        explicit Producer(LockFreeQueue<int> *queue)
+            : mQueue(queue)
+        {}
+
+    protected:
+        void run()
+        {
+            for (int i = 0; i < ProducedCount; ++i) {
+                mQueue->enqueue(i);
+            }
+        }
+
+    private:
+        LockFreeQueue<int> *mQueue;
+    };
+}
+
+void Ut_LockFreeQueue::testEmpty()
+{
+    LockFreeQueue<int> queue;
+    QVERIFY(queue.isEmpty());
+
+    int value = -1;
+    QVERIFY(!queue.dequeue(&value));
+    QCOMPARE(value, -1);
+}
+
+void Ut_LockFreeQueue::testOrder()
+{
+    LockFreeQueue<QString> queue;
+    queue.enqueue("first");
+    queue.enqueue("second");
+    QVERIFY(!queue.isEmpty());
+
+    QString value;
+    QVERIFY(queue.dequeue(&value));
+    QCOMPARE(value, QString("first"));
+
+    queue.enqueue("third");
+    QVERIFY(queue.dequeue(&value));
+    QCOMPARE(value, QString("second"));
+    QVERIFY(queue.dequeue(&value));
+    QCOMPARE(value, QString("third"));
+
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.dequeue(&value));
+}
+
+void Ut_LockFreeQueue::testValuesReleased()
+{
+    QSharedPointer<int> shared(new int(1));
+
+    LockFreeQueue<QSharedPointer<int> > queue;
+    queue.enqueue(shared);
+    queue.enqueue(shared);
+    QVERIFY(!shared.isNull());
+
+    // the queue keeps no copy of what was taken out
+    QSharedPointer<int> value;
+    QVERIFY(queue.dequeue(&value));
+    value.clear();
+    QVERIFY(queue.dequeue(&value));
+    value.clear();
+
+    QWeakPointer<int> weak(shared);
+    shared.clear();
+    QVERIFY(weak.isNull());
+}
+
+void Ut_LockFreeQueue::testAcrossThreads()
+{
+    LockFreeQueue<int> queue;
+    Producer producer(&queue);
+    producer.start();
+
+    // compared after the producer finished, a failing test must not leave it running
+    int received = 0;
+    int outOfOrder = 0;
+    int value;
+    while (received < ProducedCount) {
+        if (queue.dequeue(&value)) {
+            if (value != received) {
+                ++outOfOrder;
+            }
+            ++received;
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    QVERIFY(producer.wait(5000));
+    QCOMPARE(outOfOrder, 0);
+    QVERIFY(queue.isEmpty());
+}
+
+QTEST_MAIN(Ut_LockFreeQueue)
@@ -0,0 +1,31 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_LOCKFREEQUEUE_H
+#define UT_LOCKFREEQUEUE_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class Ut_LockFreeQueue : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmpty();
+    void testOrder();
+    void testValuesReleased();
+    void testAcrossThreads();
+};
+
+#endif // UT_LOCKFREEQUEUE_H
@@ -0,0 +1,12 @@
+include(../common_top.pri)
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_lockfreequeue.h \
+
+SOURCES += \
+    ut_lockfreequeue.cpp \
+
+include(../common_check.pri)
@@ -0,0 +1,177 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_loopbackconnection.h"
+
+#include <connectionfactory.h>
+#include <loopbackinputcontextconnection.h>
+#include <mimserverconnection.h>
+
+#include <QRegion>
+
+void PreeditRectangleResponder::getPreeditRectangle(QRect &rectangle, bool &valid)
+{
+    rectangle = QRect(1, 2, 3, 4);
+    valid = true;
+}
+
+void Ut_LoopbackConnection::init()
+{
+    server = Maliit::Loopback::createInputContextConnection();
+    client = Maliit::Loopback::createServerConnection(server);
+    clientId = 0;
+}
+
+void Ut_LoopbackConnection::cleanup()
+{
+    delete client;
+    delete server;
+}
+
+bool Ut_LoopbackConnection::connectPair()
+{
+    QSignalSpy connected(client, SIGNAL(connected()));
+    QSignalSpy activated(server, SIGNAL(clientActivated(uint)));
+
+    for (int i = 0; i < 50 && connected.isEmpty(); ++i) {
+        QTest::qWait(10);
+    }
+    if (connected.isEmpty())
+        return false;
+
+    // no event loop needed from here on
+    client->activateContext();
+    if (activated.isEmpty())
+        return false;
+
+    clientId = activated.first().first().toUInt();
+    return true;
+}
+
+void Ut_LoopbackConnection::testConnected()
+{
+    QSignalSpy connected(client, SIGNAL(connected()));
+
+    // deferred to the mainloop, as for the other connections
+    QCOMPARE(connected.count(), 0);
+    QTRY_COMPARE(connected.count(), 1);
+}
+
+void Ut_LoopbackConnection::testApplicationToServer()
+{
+    QVERIFY(connectPair());
+
+    QSignalSpy shown(server, SIGNAL(showInputMethodRequest()));
+    QSignalSpy copyPaste(server, SIGNAL(copyPasteStateChanged(bool,bool)));
+
+    QVariantMap state;
+    state["focusState"] = true;
+    state["surroundingText"] = "surrounding";
+    state["cursorPosition"] = 3;
+    client->updateWidgetInformation(state, true);
+    client->showInputMethod();
+    client->setCopyPasteState(true, false);
+
+    QCOMPARE(shown.count(), 1);
+    QCOMPARE(copyPaste.count(), 1);
+    QCOMPARE(copyPaste.first().at(0).toBool(), true);
+    QCOMPARE(copyPaste.first().at(1).toBool(), false);
+
+    QString text;
+    int cursorPosition;
+    QVERIFY(server->surroundingText(text, cursorPosition));
+    QCOMPARE(text, QString("surrounding"));
+    QCOMPARE(cursorPosition, 3);
+
+    // resets are handled before reset() returns
+    client->reset(true);
+    QVERIFY(!client->pendingResets());
+}
+
+void Ut_LoopbackConnection::testServerToApplication()
+{
+    QVERIFY(connectPair());
+
+    QSignalSpy commits(client, SIGNAL(commitString(QString,int,int,int)));
+    QSignalSpy areas(client, SIGNAL(updateInputMethodArea(QRect)));
+    QSignalSpy languages(client, SIGNAL(setLanguage(QString)));
+
+    server->sendCommitString("hello", 1, 2, 3);
+    server->updateInputMethodArea(QRegion(QRect(1, 2, 3, 4)));
+    server->setLanguage("fi");
+
+    QCOMPARE(commits.count(), 1);
+    QCOMPARE(commits.first().at(0).toString(), QString("hello"));
+    QCOMPARE(commits.first().at(1).toInt(), 1);
+    QCOMPARE(commits.first().at(2).toInt(), 2);
+    QCOMPARE(commits.first().at(3).toInt(), 3);
+
+    QCOMPARE(areas.count(), 1);
+    QCOMPARE(areas.first().first().toRect(), QRect(1, 2, 3, 4));
+
+    QCOMPARE(languages.count(), 1);
+    QCOMPARE(languages.first().first().toString(), QString("fi"));
+}
+
+void Ut_LoopbackConnection::testPreeditRectangleRequest()
+{
+    QVERIFY(connectPair());
+
+    PreeditRectangleResponder responder;
+    connect(client, SIGNAL(getPreeditRectangle(QRect&,bool&)),
+            &responder, SLOT(getPreeditRectangle(QRect&,bool&)));
+
+    QSignalSpy rectangles(server, SIGNAL(preeditRectangleReceived(int,QRect,bool)));
+
+    const int requestId = server->requestPreeditRectangle();
+    // answers are never delivered from within the request
+    QCOMPARE(rectangles.count(), 0);
+
+    QTRY_COMPARE(rectangles.count(), 1);
+    QCOMPARE(rectangles.first().at(0).toInt(), requestId);
+    QCOMPARE(rectangles.first().at(1).toRect(), QRect(1, 2, 3, 4));
+    QCOMPARE(rectangles.first().at(2).toBool(), true);
+}
+
+void Ut_LoopbackConnection::testClientDisconnection()
+{
+    QVERIFY(connectPair());
+
+    QSignalSpy disconnected(server, SIGNAL(clientDisconnected(uint)));
+
+    delete client;
+    client = 0;
+
+    QCOMPARE(disconnected.count(), 1);
+    QCOMPARE(disconnected.first().first().toUInt(), clientId);
+
+    // nobody to send to any more
+    server->sendCommitString("ignored");
+}
+
+void Ut_LoopbackConnection::testServerDestruction()
+{
+    QVERIFY(connectPair());
+
+    QSignalSpy disconnected(client, SIGNAL(disconnected()));
+
+    delete server;
+    server = 0;
+
+    QCOMPARE(disconnected.count(), 1);
+
+    // calls after the server is gone are dropped
+    client->showInputMethod();
+}
+
+QTEST_MAIN(Ut_LoopbackConnection)
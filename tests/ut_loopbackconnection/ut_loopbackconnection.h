@@ -0,0 +1,55 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_LOOPBACKCONNECTION_H
+#define UT_LOOPBACKCONNECTION_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class LoopbackInputContextConnection;
+class MImServerConnection;
+
+//! Answers the preedit rectangle query of the server
+class PreeditRectangleResponder : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void getPreeditRectangle(QRect &rectangle, bool &valid);
+};
+
+class Ut_LoopbackConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testConnected();
+    void testApplicationToServer();
+    void testServerToApplication();
+    void testPreeditRectangleRequest();
+    void testClientDisconnection();
+    void testServerDestruction();
+
+private:
+    bool connectPair();
+
+    LoopbackInputContextConnection *server;
+    MImServerConnection *client;
+    unsigned int clientId;
+};
+
+#endif // UT_LOOPBACKCONNECTION_H
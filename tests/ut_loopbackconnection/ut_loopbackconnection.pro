@@ -0,0 +1,14 @@
+include(../common_top.pri)
+
+QT += gui
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_loopbackconnection.h \
+
+SOURCES += \
+    ut_loopbackconnection.cpp \
+
+include(../common_check.pri)
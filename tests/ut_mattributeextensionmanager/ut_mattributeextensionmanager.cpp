@@ -106,4 +106,38 @@ void Ut_MAttributeExtensionManager::testSetExtendedAttribute()
     QVERIFY(subject->keyOverrides(idList.at(1)).value("testKey")->icon().isEmpty());
 }
 
+void Ut_MAttributeExtensionManager::testHibernation()
+{
+    const MAttributeExtensionId id(1, "7");
+    subject->handleAttributeExtensionRegistered(7, 1, "");
+    subject->handleExtendedAttributeUpdate(7, 1, "/keys", "testKey", "label", QVariant("testLabel"));
+    subject->handleExtendedAttributeUpdate(7, 1, "/keys", "testKey", "highlighted", QVariant(true));
+    QCOMPARE(subject->keyOverrides(id).count(), 1);
+
+    // the extension is released, but its key overrides come back on resume
+    subject->handleClientHibernated(7);
+    QVERIFY(!subject->contains(id));
+
+    subject->handleClientResumed(7);
+    QVERIFY(subject->contains(id));
+    QSharedPointer<MKeyOverride> keyOverride = subject->keyOverrides(id).value("testKey");
+    QVERIFY(keyOverride);
+    QCOMPARE(keyOverride->label(), QString("testLabel"));
+    QCOMPARE(keyOverride->highlighted(), true);
+
+    // changing an attribute of a hibernated client restores its extension first
+    subject->handleClientHibernated(7);
+    subject->handleExtendedAttributeUpdate(7, 1, "/keys", "testKey", "icon", QVariant("testIcon"));
+    keyOverride = subject->keyOverrides(id).value("testKey");
+    QVERIFY(keyOverride);
+    QCOMPARE(keyOverride->label(), QString("testLabel"));
+    QCOMPARE(keyOverride->icon(), QString("testIcon"));
+
+    // nothing is left once the client is gone
+    subject->handleClientHibernated(7);
+    subject->handleClientDisconnect(7);
+    subject->handleClientResumed(7);
+    QVERIFY(!subject->contains(id));
+}
+
 QTEST_MAIN(Ut_MAttributeExtensionManager);
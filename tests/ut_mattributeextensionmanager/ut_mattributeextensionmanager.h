@@ -30,6 +30,7 @@ private Q_SLOTS:
     void init();
     void cleanup();
     void testSetExtendedAttribute();
+    void testHibernation();
 
 private:
     MAttributeExtensionManager *subject;
@@ -38,6 +38,11 @@ namespace {
     Args ProgramNameOnly   = { 1, { "name" } };
     Args BypassedParameter = { 1, { "name", "-help" } };
 
+    Args HibernateAfterMinute  = { 3, { "", "-hibernate-after", "60" } };
+    Args HibernateAfterLongest = { 3, { "", "-hibernate-after", "2147483" } };
+    Args HibernateAfterTooLong = { 3, { "", "-hibernate-after", "2147484" } };
+    Args HibernateAfterNegative = { 3, { "", "-hibernate-after", "-1" } };
+
     Args Ignored = { 15, { "", "-style", "STYLE", "-session", "SESSION",
                            "-graphicssystem", "GRAPHICSSYSTEM",
                           "-testability", "TESTABILITY", "-qdevel", "-reverse",
@@ -108,4 +113,30 @@ void Ut_MImServerOptions::testCommonOptions()
     QCOMPARE(commonOptions, expectedCommonOptions);
 }
 
+void Ut_MImServerOptions::testHibernationTimeout_data()
+{
+    QTest::addColumn<Args>("args");
+    QTest::addColumn<int>("expectedTimeout");
+    QTest::addColumn<bool>("expectedRecognition");
+
+    QTest::newRow("minute") << HibernateAfterMinute << 60 << true;
+    // the longest timeout which still fits into an int in ms
+    QTest::newRow("longest") << HibernateAfterLongest << 2147483 << true;
+    QTest::newRow("too long") << HibernateAfterTooLong << 0 << false;
+    QTest::newRow("negative") << HibernateAfterNegative << 0 << false;
+}
+
+void Ut_MImServerOptions::testHibernationTimeout()
+{
+    QFETCH(Args, args);
+    QFETCH(int, expectedTimeout);
+    QFETCH(bool, expectedRecognition);
+
+    MImServerConnectionOptions connectionOptions;
+    bool everythingRecognized = parseCommandLine(args.argc, args.argv);
+
+    QCOMPARE(everythingRecognized, expectedRecognition);
+    QCOMPARE(connectionOptions.hibernationTimeout, expectedTimeout);
+}
+
 QTEST_MAIN(Ut_MImServerOptions)
@@ -33,6 +33,8 @@ private Q_SLOTS:
 
     void testCommonOptions_data();
     void testCommonOptions();
+    void testHibernationTimeout_data();
+    void testHibernationTimeout();
 
 private:
     MImServerCommonOptions commonOptions;
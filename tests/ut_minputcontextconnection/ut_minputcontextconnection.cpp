@@ -0,0 +1,354 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_minputcontextconnection.h"
+
+#include <minputcontextconnection.h>
+
+namespace {
+    QVariantMap editorState(const QString &text)
+    {
+        QVariantMap state;
+        state["focusState"] = true;
+        state["surroundingText"] = text;
+        state["cursorPosition"] = text.length();
+        return state;
+    }
+
+    QVariantMap textChange(const QString &text)
+    {
+        QVariantMap change;
+        change["surroundingText"] = text;
+        change["cursorPosition"] = text.length();
+        return change;
+    }
+
+    QVariantMap textEdit(int position, int removed, const QString &text)
+    {
+        QVariantMap change;
+        change[Maliit::WidgetStateEdit::SurroundingTextEditPosition] = position;
+        change[Maliit::WidgetStateEdit::SurroundingTextEditRemoved] = removed;
+        change[Maliit::WidgetStateEdit::SurroundingTextEditText] = text;
+        return change;
+    }
+}
+
+void Ut_MInputContextConnection::initTestCase()
+{
+    qRegisterMetaType<Maliit::WidgetState>();
+}
+
+void Ut_MInputContextConnection::init()
+{
+    subject = new MInputContextConnection;
+}
+
+void Ut_MInputContextConnection::cleanup()
+{
+    delete subject;
+}
+
+QString Ut_MInputContextConnection::surroundingText() const
+{
+    QString text;
+    int cursorPosition;
+    return subject->surroundingText(text, cursorPosition) ? text : QString();
+}
+
+void Ut_MInputContextConnection::testStateRestoredOnActivation()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("first"), true);
+
+    subject->activateContext(2);
+    subject->updateWidgetInformation(2, editorState("second"), true);
+    QCOMPARE(surroundingText(), QString("second"));
+
+    // no need to wait for the client to send its state again
+    subject->activateContext(1);
+    QCOMPARE(surroundingText(), QString("first"));
+
+    // and it can continue with deltas on top of what it sent before
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("first!"), QStringList(), 1, false));
+    QCOMPARE(surroundingText(), QString("first!"));
+}
+
+void Ut_MInputContextConnection::testInactiveUpdates()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("first"), true);
+    subject->activateContext(2);
+
+    // updates of inactive clients are kept, but do not affect the active state
+    subject->updateWidgetInformation(2, editorState("second"), true);
+    subject->updateWidgetInformation(1, editorState("updated"), false);
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("updated!"), QStringList(), 1, false));
+    QCOMPARE(surroundingText(), QString("second"));
+
+    subject->activateContext(1);
+    QCOMPARE(surroundingText(), QString("updated!"));
+    QVERIFY(subject->updateWidgetInformationDelta(1, QVariantMap(), QStringList(), 2, false));
+}
+
+void Ut_MInputContextConnection::testInactiveDeltaOutOfSync()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("first"), true);
+    subject->activateContext(2);
+
+    QVERIFY(!subject->updateWidgetInformationDelta(1, textChange("lost"), QStringList(), 5, false));
+    // unknown clients have nothing to apply deltas to
+    QVERIFY(!subject->updateWidgetInformationDelta(3, textChange("lost"), QStringList(), 1, false));
+
+    // the client sends its full state again
+    subject->updateWidgetInformation(1, editorState("resent"), false);
+    subject->activateContext(1);
+    QCOMPARE(surroundingText(), QString("resent"));
+}
+
+void Ut_MInputContextConnection::testEviction()
+{
+    const unsigned int clients = 64;
+
+    for (unsigned int id = 1; id <= clients; ++id) {
+        subject->activateContext(id);
+        subject->updateWidgetInformation(id, editorState(QString::number(id)), true);
+    }
+
+    // the most recently used clients are still known
+    subject->activateContext(clients - 1);
+    QCOMPARE(surroundingText(), QString::number(clients - 1));
+
+    // the oldest ones are not, they have to send a full update
+    subject->activateContext(1);
+    QCOMPARE(surroundingText(), QString::number(clients - 1));
+    QVERIFY(!subject->updateWidgetInformationDelta(1, textChange("1!"), QStringList(), 1, false));
+}
+
+void Ut_MInputContextConnection::testDisconnectionDropsState()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("first"), true);
+    subject->activateContext(2);
+    subject->updateWidgetInformation(2, editorState("second"), true);
+
+    subject->handleDisconnection(1);
+    QVERIFY(!subject->updateWidgetInformationDelta(1, textChange("gone"), QStringList(), 1, false));
+}
+
+void Ut_MInputContextConnection::testSurroundingTextFromWindow()
+{
+    QVariantMap state = editorState("window");
+    state["surroundingTextOffset"] = 100;
+    state["surroundingTextLength"] = 1000;
+
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, state, true);
+
+    bool valid = false;
+    QCOMPARE(subject->surroundingTextOffset(valid), 100);
+    QVERIFY(valid);
+
+    QSignalSpy spy(subject, SIGNAL(surroundingTextReceived(int,int,QString,bool)));
+
+    // inside the window the cached text is enough
+    const int inside = subject->requestSurroundingText(102, 3);
+    // outside of it the connection cannot answer without the application
+    const int outside = subject->requestSurroundingText(10, 3);
+    QVERIFY(inside != outside);
+    QCOMPARE(spy.count(), 0);
+
+    QTRY_COMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(0).at(0).toInt(), inside);
+    QCOMPARE(spy.at(0).at(1).toInt(), 102);
+    QCOMPARE(spy.at(0).at(2).toString(), QString("ndo"));
+    QVERIFY(spy.at(0).at(3).toBool());
+    QCOMPARE(spy.at(1).at(0).toInt(), outside);
+    QVERIFY(!spy.at(1).at(3).toBool());
+}
+
+void Ut_MInputContextConnection::testSurroundingTextEdit()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("Hello world"), true);
+
+    QVERIFY(subject->updateWidgetInformationDelta(1, textEdit(5, 0, ","), QStringList(), 1, false));
+    QCOMPARE(surroundingText(), QString("Hello, world"));
+
+    QVariantMap change = textEdit(7, 5, "there");
+    change["cursorPosition"] = 12;
+    QVERIFY(subject->updateWidgetInformationDelta(1, change, QStringList(), 2, false));
+    QString text;
+    int cursorPosition = 0;
+    QVERIFY(subject->surroundingText(text, cursorPosition));
+    QCOMPARE(text, QString("Hello, there"));
+    QCOMPARE(cursorPosition, 12);
+
+    // inactive clients get their edits applied to the cached text
+    subject->activateContext(2);
+    QVERIFY(subject->updateWidgetInformationDelta(1, textEdit(12, 0, "!"), QStringList(), 3, false));
+    subject->activateContext(1);
+    QCOMPARE(surroundingText(), QString("Hello, there!"));
+}
+
+void Ut_MInputContextConnection::testSurroundingTextEditOutOfSync()
+{
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("short"), true);
+
+    // an edit which does not fit the text means the copies diverged
+    QVERIFY(!subject->updateWidgetInformationDelta(1, textEdit(10, 1, "x"), QStringList(), 1, false));
+    QCOMPARE(surroundingText(), QString("short"));
+    // no further deltas until the client sent its full state
+    QVERIFY(!subject->updateWidgetInformationDelta(1, textEdit(0, 0, "x"), QStringList(), 2, false));
+
+    subject->updateWidgetInformation(1, editorState("resent"), false);
+    QVERIFY(subject->updateWidgetInformationDelta(1, textEdit(6, 0, "!"), QStringList(), 1, false));
+    QCOMPARE(surroundingText(), QString("resent!"));
+}
+
+void Ut_MInputContextConnection::testWidgetStateCoalescing()
+{
+    subject->setWidgetStateCoalescing(true);
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("a"), true);
+
+    QSignalSpy spy(subject, SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("ab"), QStringList(), 1, false));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abc"), QStringList(), 2, false));
+
+    // the state is up to date, only the notification waits for the next frame
+    QCOMPARE(surroundingText(), QString("abc"));
+    QCOMPARE(spy.count(), 0);
+
+    QTRY_COMPARE(spy.count(), 1);
+    const Maliit::WidgetState newState = spy.first().at(1).value<Maliit::WidgetState>();
+    const Maliit::WidgetState oldState = spy.first().at(2).value<Maliit::WidgetState>();
+    QCOMPARE(newState.surroundingText(), QString("abc"));
+    QCOMPARE(oldState.surroundingText(), QString("a"));
+    QCOMPARE(spy.first().at(3).toBool(), false);
+
+    // key events see the plugins up to date
+    spy.clear();
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abcd"), QStringList(), 3, false));
+    subject->processKeyEvent(1, QEvent::KeyPress, Qt::Key_E, Qt::NoModifier, "e", false, 1, 0, 0, 0);
+    QCOMPARE(spy.count(), 1);
+}
+
+void Ut_MInputContextConnection::testWidgetStateCoalescingFocusChange()
+{
+    subject->setWidgetStateCoalescing(true);
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("a"), true);
+
+    QSignalSpy spy(subject, SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("ab"), QStringList(), 1, false));
+    QCOMPARE(spy.count(), 0);
+
+    // focus changes are delivered right away, together with what was held back
+    subject->updateWidgetInformation(1, editorState("other"), true);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(2).value<Maliit::WidgetState>().surroundingText(), QString("a"));
+    QCOMPARE(spy.first().at(3).toBool(), true);
+
+    QTest::qWait(50);
+    QCOMPARE(spy.count(), 1);
+}
+
+void Ut_MInputContextConnection::testClientQuotaWidgetState()
+{
+    // one token every 100 ms
+    subject->setClientQuota(10, 2);
+    subject->activateContext(1);
+    subject->updateWidgetInformation(1, editorState("a"), true);
+
+    QSignalSpy spy(subject, SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("ab"), QStringList(), 1, false));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abc"), QStringList(), 2, false));
+    QCOMPARE(spy.count(), 2);
+
+    // out of tokens: the state is up to date, the notification waits
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abcd"), QStringList(), 3, false));
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abcde"), QStringList(), 4, false));
+    QCOMPARE(surroundingText(), QString("abcde"));
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(subject->throttleCounters(1).deferred, quint64(1));
+    QCOMPARE(subject->throttleCounters(1).coalesced, quint64(1));
+
+    QTRY_COMPARE(spy.count(), 3);
+    QCOMPARE(spy.last().at(1).value<Maliit::WidgetState>().surroundingText(), QString("abcde"));
+    QCOMPARE(spy.last().at(2).value<Maliit::WidgetState>().surroundingText(), QString("abc"));
+
+    // focus changes do not wait
+    spy.clear();
+    QVERIFY(subject->updateWidgetInformationDelta(1, textChange("abcdef"), QStringList(), 5, false));
+    subject->updateWidgetInformation(1, editorState("other"), true);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(3).toBool(), true);
+}
+
+void Ut_MInputContextConnection::testClientQuotaExtendedAttributes()
+{
+    subject->setClientQuota(10, 1);
+
+    QSignalSpy spy(subject, SIGNAL(extendedAttributeChanged(uint,int,QString,QString,QString,QVariant)));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("a"));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("b"));
+    subject->setExtendedAttribute(1, 1, "/keys", "otherKey", "label", QVariant("x"));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("c"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(subject->throttleCounters(1).deferred, quint64(3));
+    QCOMPARE(subject->throttleCounters(1).coalesced, quint64(1));
+
+    // other clients have quotas of their own
+    subject->setExtendedAttribute(2, 1, "/keys", "actionKey", "label", QVariant("z"));
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(subject->throttleCounters(2).deferred, quint64(0));
+
+    // deferred attributes keep their order, with the latest values
+    QTRY_COMPARE(spy.count(), 4);
+    QCOMPARE(spy.at(2).at(3).toString(), QString("actionKey"));
+    QCOMPARE(spy.at(2).at(5).toString(), QString("c"));
+    QCOMPARE(spy.at(3).at(3).toString(), QString("otherKey"));
+
+    // disabling the quota counts no more deferrals
+    subject->setClientQuota(0, 0);
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("d"));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("e"));
+    QCOMPARE(spy.count(), 6);
+    QCOMPARE(subject->throttleCounters(1).deferred, quint64(3));
+}
+
+void Ut_MInputContextConnection::testClientQuotaAttributeOrder()
+{
+    subject->setClientQuota(1, 1);
+
+    QSignalSpy spy(subject, SIGNAL(extendedAttributeChanged(uint,int,QString,QString,QString,QVariant)));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("a"));
+    subject->setExtendedAttribute(1, 1, "/keys", "actionKey", "label", QVariant("b"));
+    QCOMPARE(spy.count(), 1);
+
+    // attributes of an extension reach plugins before it goes away
+    subject->unregisterAttributeExtension(1, 1);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.last().at(5).toString(), QString("b"));
+
+    // and nothing is left for a client which disconnected
+    subject->setExtendedAttribute(1, 2, "/keys", "actionKey", "label", QVariant("c"));
+    subject->handleDisconnection(1);
+    QTest::qWait(50);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(subject->throttleCounters(1).deferred, quint64(0));
+}
+
+QTEST_MAIN(Ut_MInputContextConnection)
@@ -0,0 +1,52 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_MINPUTCONTEXTCONNECTION_H
+#define UT_MINPUTCONTEXTCONNECTION_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class MInputContextConnection;
+
+class Ut_MInputContextConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testStateRestoredOnActivation();
+    void testInactiveUpdates();
+    void testInactiveDeltaOutOfSync();
+    void testEviction();
+    void testDisconnectionDropsState();
+    void testSurroundingTextFromWindow();
+    void testSurroundingTextEdit();
+    void testSurroundingTextEditOutOfSync();
+    void testWidgetStateCoalescing();
+    void testWidgetStateCoalescingFocusChange();
+    void testClientQuotaWidgetState();
+    void testClientQuotaExtendedAttributes();
+    void testClientQuotaAttributeOrder();
+
+private:
+    //! Returns the surrounding text the connection currently knows
+    QString surroundingText() const;
+
+    MInputContextConnection *subject;
+};
+
+#endif // UT_MINPUTCONTEXTCONNECTION_H
@@ -0,0 +1,164 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_sharedmemorylane.h"
+
+#include <sharedmemorylane.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace {
+    const quint32 Capacity = 256;
+
+    // Offsets of the positions in SharedMemoryLaneHeader, each on its own cache line
+    const int WritePositionOffset = 0;
+    const int ReadPositionOffset = 64;
+
+    //! Overwrites a position in the memory of \a lane, like a misbehaving other side would
+    bool corruptPosition(SharedMemoryLane *lane, int offset, quint32 position)
+    {
+#ifdef Q_OS_LINUX
+        const size_t length = ReadPositionOffset + sizeof(quint32);
+        void *memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, lane->memoryFd(), 0);
+        if (memory == MAP_FAILED) {
+            return false;
+        }
+
+        *reinterpret_cast<quint32 *>(static_cast<char *>(memory) + offset) = position;
+        munmap(memory, length);
+        return true;
+#else
+        Q_UNUSED(lane);
+        Q_UNUSED(offset);
+        Q_UNUSED(position);
+        return false;
+#endif
+    }
+}
+
+void Ut_SharedMemoryLane::init()
+{
+    reader = 0;
+    writer = SharedMemoryLane::create(Capacity);
+    if (!writer) {
+        QSKIP("Shared memory lanes are not supported on this system");
+    }
+
+    reader = SharedMemoryLane::attach(writer->memoryFd(), writer->eventFd(), writer->capacity());
+    QVERIFY(reader);
+}
+
+void Ut_SharedMemoryLane::cleanup()
+{
+    delete reader;
+    reader = 0;
+    delete writer;
+    writer = 0;
+}
+
+void Ut_SharedMemoryLane::testWriteRead()
+{
+    QByteArray message;
+
+    QVERIFY(not reader->hasPending());
+    QVERIFY(not reader->read(&message, 0));
+
+    QVERIFY(writer->write("first", 0));
+    QVERIFY(writer->write("second", 0));
+    QVERIFY(reader->hasPending());
+
+    QVERIFY(reader->read(&message, 0));
+    QCOMPARE(message, QByteArray("first"));
+    QVERIFY(reader->read(&message, 0));
+    QCOMPARE(message, QByteArray("second"));
+
+    QVERIFY(not reader->hasPending());
+    reader->clearDoorbell();
+}
+
+void Ut_SharedMemoryLane::testWrapAround()
+{
+    const QByteArray payload(100, 'x');
+    QByteArray message;
+
+    // Messages end up crossing the end of the buffer
+    for (int i = 0; i < 10; ++i) {
+        QByteArray numbered = payload;
+        numbered[0] = 'a' + i;
+        QVERIFY(writer->write(numbered, 0));
+        QVERIFY(reader->read(&message, 0));
+        QCOMPARE(message, numbered);
+    }
+}
+
+void Ut_SharedMemoryLane::testFull()
+{
+    const QByteArray payload(100, 'x');
+    QByteArray message;
+
+    QVERIFY(writer->write(payload, 0));
+    QVERIFY(writer->write(payload, 0));
+    QVERIFY(not writer->write(payload, 0));
+
+    QVERIFY(reader->read(&message, 0));
+    QVERIFY(writer->write(payload, 0));
+}
+
+void Ut_SharedMemoryLane::testControlSerial()
+{
+    QByteArray message;
+
+    QVERIFY(writer->write("after one", 1));
+    QVERIFY(writer->write("after two", 2));
+
+    QVERIFY(not reader->read(&message, 0));
+    QVERIFY(reader->read(&message, 1));
+    QCOMPARE(message, QByteArray("after one"));
+    QVERIFY(not reader->read(&message, 1));
+    QVERIFY(reader->read(&message, 2));
+    QCOMPARE(message, QByteArray("after two"));
+}
+
+void Ut_SharedMemoryLane::testCorruptedPosition_data()
+{
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<quint32>("position");
+
+    // "first" takes 13 bytes with its header
+    QTest::newRow("read position ahead of write position") << ReadPositionOffset << quint32(14);
+    QTest::newRow("write position beyond capacity") << WritePositionOffset << quint32(2 * Capacity + 13);
+}
+
+void Ut_SharedMemoryLane::testCorruptedPosition()
+{
+    QFETCH(int, offset);
+    QFETCH(quint32, position);
+
+    QByteArray message;
+
+    QVERIFY(writer->write("first", 0));
+    QVERIFY(corruptPosition(writer, offset, position));
+
+    // Neither side copies past the end of the buffer, both give up on the lane
+    QVERIFY(not writer->write(QByteArray(100, 'x'), 0));
+    QVERIFY(not reader->read(&message, 0));
+    QVERIFY(not reader->hasPending());
+
+    QVERIFY(corruptPosition(writer, offset, offset == ReadPositionOffset ? 0 : 13));
+    QVERIFY(not writer->write("second", 0));
+    QVERIFY(not reader->read(&message, 0));
+}
+
+QTEST_MAIN(Ut_SharedMemoryLane)
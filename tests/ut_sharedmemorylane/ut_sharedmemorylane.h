@@ -0,0 +1,42 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_SHAREDMEMORYLANE_H
+#define UT_SHAREDMEMORYLANE_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class SharedMemoryLane;
+
+class Ut_SharedMemoryLane : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testWriteRead();
+    void testWrapAround();
+    void testFull();
+    void testControlSerial();
+    void testCorruptedPosition_data();
+    void testCorruptedPosition();
+
+private:
+    SharedMemoryLane *writer;
+    SharedMemoryLane *reader;
+};
+
+#endif // UT_SHAREDMEMORYLANE_H
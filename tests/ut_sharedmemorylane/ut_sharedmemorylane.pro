@@ -0,0 +1,14 @@
+include(../common_top.pri)
+
+QT += gui
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_sharedmemorylane.h \
+
+SOURCES += \
+    ut_sharedmemorylane.cpp \
+
+include(../common_check.pri)
@@ -0,0 +1,113 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_textmirror.h"
+
+#include <maliit/textmirror.h>
+
+void Ut_TextMirror::testInsert()
+{
+    Maliit::TextMirror mirror(QString("Hello world"));
+
+    QVERIFY(mirror.insert(5, ","));
+    QVERIFY(mirror.insert(12, "!"));
+    QVERIFY(mirror.insert(0, ">"));
+    QCOMPARE(mirror.text(), QString(">Hello, world!"));
+    QCOMPARE(mirror.length(), 14);
+
+    // typing at the same place extends the piece inserted before
+    Maliit::TextMirror typed;
+    QVERIFY(typed.insert(0, "a"));
+    QVERIFY(typed.insert(1, "b"));
+    QVERIFY(typed.insert(2, "c"));
+    QCOMPARE(typed.text(), QString("abc"));
+    QCOMPARE(typed.pieceCount(), 1);
+}
+
+void Ut_TextMirror::testRemove()
+{
+    Maliit::TextMirror mirror(QString("Hello world"));
+
+    QVERIFY(mirror.insert(5, ", dear"));
+    QVERIFY(mirror.remove(3, 5));
+    QCOMPARE(mirror.text(), QString("Helear world"));
+    QVERIFY(mirror.remove(mirror.length() - 1, 1));
+    QCOMPARE(mirror.text(), QString("Helear worl"));
+    QVERIFY(mirror.remove(0, mirror.length()));
+    QVERIFY(mirror.isEmpty());
+    QCOMPARE(mirror.text(), QString());
+}
+
+void Ut_TextMirror::testReplace()
+{
+    Maliit::TextMirror mirror(QString("Hello world"));
+
+    QVERIFY(mirror.replace(6, 5, "there"));
+    QCOMPARE(mirror.text(), QString("Hello there"));
+    QVERIFY(mirror.replace(0, 0, "Oh, "));
+    QCOMPARE(mirror.text(), QString("Oh, Hello there"));
+}
+
+void Ut_TextMirror::testOutOfRange()
+{
+    Maliit::TextMirror mirror(QString("abc"));
+
+    QVERIFY(not mirror.insert(4, "x"));
+    QVERIFY(not mirror.insert(-1, "x"));
+    QVERIFY(not mirror.remove(2, 2));
+    QVERIFY(not mirror.replace(1, 3, "x"));
+    QCOMPARE(mirror.text(), QString("abc"));
+}
+
+void Ut_TextMirror::testMid()
+{
+    Maliit::TextMirror mirror(QString("Hello world"));
+    QVERIFY(mirror.insert(5, ","));
+
+    QCOMPARE(mirror.mid(3, 5), QString("lo, w"));
+    QCOMPARE(mirror.mid(10, 100), QString("ld"));
+    QCOMPARE(mirror.mid(-5, 2), QString("He"));
+}
+
+void Ut_TextMirror::testCopiesAreIndependent()
+{
+    Maliit::TextMirror original(QString("text"));
+    QVERIFY(original.insert(4, " one"));
+
+    Maliit::TextMirror copy = original;
+    QVERIFY(copy.insert(8, " two"));
+    QVERIFY(original.insert(8, " three"));
+
+    QCOMPARE(copy.text(), QString("text one two"));
+    QCOMPARE(original.text(), QString("text one three"));
+    QVERIFY(copy != original);
+    QVERIFY(Maliit::TextMirror(QString("text one two")) == copy);
+}
+
+void Ut_TextMirror::testCompaction()
+{
+    Maliit::TextMirror mirror(QString(1000, QChar('a')));
+    QString expected = mirror.text();
+
+    // edits spread over the text create a new piece each time
+    for (int i = 0; i < 200; ++i) {
+        const int position = (i * 37) % mirror.length();
+        QVERIFY(mirror.insert(position, "b"));
+        expected.insert(position, "b");
+    }
+
+    QVERIFY(mirror.pieceCount() <= 64);
+    QCOMPARE(mirror.text(), expected);
+}
+
+QTEST_MAIN(Ut_TextMirror)
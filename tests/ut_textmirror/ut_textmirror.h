@@ -0,0 +1,34 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_TEXTMIRROR_H
+#define UT_TEXTMIRROR_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class Ut_TextMirror : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testInsert();
+    void testRemove();
+    void testReplace();
+    void testOutOfRange();
+    void testMid();
+    void testCopiesAreIndependent();
+    void testCompaction();
+};
+
+#endif // UT_TEXTMIRROR_H
@@ -0,0 +1,12 @@
+include(../common_top.pri)
+
+include($$TOP_DIR/common/libmaliit-common.pri)
+
+# Input
+HEADERS += \
+    ut_textmirror.h \
+
+SOURCES += \
+    ut_textmirror.cpp \
+
+include(../common_check.pri)
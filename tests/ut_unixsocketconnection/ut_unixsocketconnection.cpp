@@ -0,0 +1,491 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_unixsocketconnection.h"
+
+#include <unixsocketframe.h>
+#include <unixsocketinputcontextconnection.h>
+#include <unixsocketserverconnection.h>
+#include <dbusinputcontextconnection.h>
+#include <dbusserverconnection.h>
+#include <serverdbusaddress.h>
+#include <inputcontextdbusaddress.h>
+
+#include <maliit/settingdata.h>
+
+#include <QKeySequence>
+#include <QRegion>
+
+using namespace Maliit::UnixSocket;
+
+namespace {
+    const int RoundTripTimeout = 5000; // in ms
+
+    QString surroundingText(MInputContextConnection *connection)
+    {
+        QString text;
+        int cursorPosition;
+        return connection->surroundingText(text, cursorPosition) ? text : QString();
+    }
+}
+
+CommitEcho::CommitEcho(MInputContextConnection *connection)
+    : QObject()
+    , mConnection(connection)
+{}
+
+void CommitEcho::echo()
+{
+    mConnection->sendCommitString("a");
+}
+
+void WidgetQueryResponder::getPreeditRectangle(QRect &rectangle, bool &valid)
+{
+    rectangle = QRect(1, 2, 3, 4);
+    valid = true;
+}
+
+void WidgetQueryResponder::getSelection(QString &selection, bool &valid)
+{
+    selection = "selected";
+    valid = true;
+}
+
+CallRecorder::CallRecorder(MInputContextConnection *connection)
+    : QObject()
+{
+    connect(connection, SIGNAL(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)),
+            this, SLOT(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)));
+    connect(connection, SIGNAL(receivedKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)),
+            this, SLOT(receivedKeyRepeat(Qt::Key,Qt::KeyboardModifiers,QString,int,bool,quint32,quint32,ulong)));
+    connect(connection, SIGNAL(resetInputMethodRequest()),
+            this, SLOT(resetInputMethodRequest()));
+    connect(connection, SIGNAL(showInputMethodRequest()),
+            this, SLOT(showInputMethodRequest()));
+    connect(connection, SIGNAL(attributeExtensionRegistered(uint,int,QString)),
+            this, SLOT(attributeExtensionRegistered(uint,int,QString)));
+    connect(connection, SIGNAL(extendedAttributeChanged(uint,int,QString,QString,QString,QVariant)),
+            this, SLOT(extendedAttributeChanged(uint,int,QString,QString,QString,QVariant)));
+    connect(connection, SIGNAL(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)),
+            this, SLOT(widgetStateChanged(uint,Maliit::WidgetState,Maliit::WidgetState,bool)));
+}
+
+void CallRecorder::receivedKeyEvent(QEvent::Type keyType, Qt::Key, Qt::KeyboardModifiers,
+                                        const QString &, bool autoRepeat, int, quint32, quint32,
+                                        unsigned long)
+{
+    calls.append(QString("%1 %2").arg(keyType == QEvent::KeyPress ? "press" : "release")
+                 .arg(autoRepeat ? "autorepeat" : "first"));
+}
+
+void CallRecorder::receivedKeyRepeat(Qt::Key, Qt::KeyboardModifiers, const QString &,
+                                         int repeats, bool releases, quint32, quint32, unsigned long)
+{
+    calls.append(QString("%1 repeats%2").arg(repeats).arg(releases ? " with releases" : ""));
+}
+
+void CallRecorder::resetInputMethodRequest()
+{
+    calls.append("reset");
+}
+
+void CallRecorder::showInputMethodRequest()
+{
+    calls.append("show");
+}
+
+void CallRecorder::attributeExtensionRegistered(unsigned int, int id, const QString &attributeExtension)
+{
+    calls.append(QString("register %1 %2").arg(id).arg(attributeExtension));
+}
+
+void CallRecorder::extendedAttributeChanged(unsigned int, int id, const QString &, const QString &,
+                                            const QString &attribute, const QVariant &value)
+{
+    calls.append(QString("attribute %1 %2 %3").arg(id).arg(attribute).arg(value.toString()));
+}
+
+void CallRecorder::widgetStateChanged(unsigned int, const Maliit::WidgetState &,
+                                      const Maliit::WidgetState &, bool)
+{
+    calls.append("widget state");
+}
+
+void Ut_UnixSocketConnection::init()
+{
+    qRegisterMetaType<QList<MImPluginSettingsInfo> >();
+
+    directory = new QTemporaryDir;
+    server = 0;
+    client = 0;
+    clientId = 0;
+}
+
+void Ut_UnixSocketConnection::cleanup()
+{
+    delete client;
+    delete server;
+    delete directory;
+}
+
+bool Ut_UnixSocketConnection::connectPair(const QString &transport)
+{
+    if (transport == "dbus") {
+        const QString address = "unix:path=" + directory->path() + "/dbus";
+        server = new DBusInputContextConnection(QSharedPointer<Maliit::Server::DBus::Address>(
+                                                    new Maliit::Server::DBus::FixedAddress(address)));
+        client = new DBusServerConnection(QSharedPointer<Maliit::InputContext::DBus::Address>(
+                                              new Maliit::InputContext::DBus::FixedAddress(address)));
+    } else {
+        const QString path = directory->path() + "/socket";
+        server = new UnixSocketInputContextConnection(path);
+        client = new UnixSocketServerConnection(path);
+    }
+
+    QSignalSpy connected(client, SIGNAL(connected()));
+    QSignalSpy activated(server, SIGNAL(clientActivated(uint)));
+
+    for (int i = 0; i < 50 && connected.isEmpty(); ++i) {
+        QTest::qWait(10);
+    }
+    if (connected.isEmpty())
+        return false;
+
+    client->activateContext();
+    for (int i = 0; i < 50 && activated.isEmpty(); ++i) {
+        QTest::qWait(10);
+    }
+    if (activated.isEmpty())
+        return false;
+
+    clientId = activated.first().first().toUInt();
+    return true;
+}
+
+void Ut_UnixSocketConnection::testFrame()
+{
+    const QByteArray frame = (FrameWriter(SetPreedit) << QString("abc") << qint32(2)).frame();
+    QVERIFY(frame.size() > FrameHeaderSize);
+
+    FrameReader reader(frame);
+    QVERIFY(reader.isValid());
+    QCOMPARE(reader.method(), SetPreedit);
+
+    QString text;
+    qint32 cursorPos;
+    reader >> text >> cursorPos;
+    QVERIFY(reader.isValid());
+    QCOMPARE(text, QString("abc"));
+    QCOMPARE(cursorPos, 2);
+
+    // nothing left
+    quint8 extra;
+    reader >> extra;
+    QVERIFY(!reader.isValid());
+}
+
+void Ut_UnixSocketConnection::testMalformedFrame()
+{
+    const QByteArray frame = (FrameWriter(SetPreedit) << QString("abc") << qint32(2)).frame();
+
+    QVERIFY(!FrameReader(frame.left(frame.size() - 1)).isValid());
+    QVERIFY(!FrameReader(frame + 'x').isValid());
+    QVERIFY(!FrameReader(frame.left(FrameHeaderSize - 1)).isValid());
+    QVERIFY(!FrameReader(QByteArray()).isValid());
+}
+
+void Ut_UnixSocketConnection::testApplicationToServer()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    QSignalSpy shown(server, SIGNAL(showInputMethodRequest()));
+    QSignalSpy copyPaste(server, SIGNAL(copyPasteStateChanged(bool,bool)));
+
+    QVariantMap state;
+    state["focusState"] = true;
+    state["surroundingText"] = "surrounding";
+    state["cursorPosition"] = 3;
+    state["cursorRectangle"] = QRect(10, 20, 30, 40);
+    client->updateWidgetInformation(state, true);
+    client->showInputMethod();
+    client->setCopyPasteState(true, false);
+
+    QTRY_COMPARE(copyPaste.count(), 1);
+    QCOMPARE(copyPaste.first().at(0).toBool(), true);
+    QCOMPARE(copyPaste.first().at(1).toBool(), false);
+
+    // frames are handled in order
+    QCOMPARE(shown.count(), 1);
+    QCOMPARE(surroundingText(server), QString("surrounding"));
+    bool valid = false;
+    QCOMPARE(server->cursorRectangle(valid), QRect(10, 20, 30, 40));
+    QVERIFY(valid);
+}
+
+void Ut_UnixSocketConnection::testServerToApplication()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    QSignalSpy commits(client, SIGNAL(commitString(QString,int,int,int)));
+    QSignalSpy areas(client, SIGNAL(updateInputMethodArea(QRect)));
+    QSignalSpy languages(client, SIGNAL(setLanguage(QString)));
+    QSignalSpy actions(client, SIGNAL(invokeAction(QString,QKeySequence)));
+
+    server->sendCommitString("hello", 1, 2, 3);
+    server->updateInputMethodArea(QRegion(QRect(1, 2, 3, 4)));
+    server->setLanguage("fi");
+    server->invokeAction("copy", QKeySequence(QKeySequence::Copy));
+
+    QTRY_COMPARE(actions.count(), 1);
+    QCOMPARE(actions.first().at(0).toString(), QString("copy"));
+    QCOMPARE(actions.first().at(1).value<QKeySequence>(), QKeySequence(QKeySequence::Copy));
+
+    QCOMPARE(commits.count(), 1);
+    QCOMPARE(commits.first().at(0).toString(), QString("hello"));
+    QCOMPARE(commits.first().at(1).toInt(), 1);
+    QCOMPARE(commits.first().at(2).toInt(), 2);
+    QCOMPARE(commits.first().at(3).toInt(), 3);
+
+    QCOMPARE(areas.count(), 1);
+    QCOMPARE(areas.first().first().toRect(), QRect(1, 2, 3, 4));
+
+    QVERIFY(!languages.isEmpty());
+    QCOMPARE(languages.last().first().toString(), QString("fi"));
+}
+
+void Ut_UnixSocketConnection::testPluginSettings()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    QSignalSpy received(client, SIGNAL(pluginSettingsReceived(QList<MImPluginSettingsInfo>)));
+
+    MImPluginSettingsEntry entry;
+    entry.description = "Entry";
+    entry.extension_key = "/plugin/entry";
+    entry.type = Maliit::IntType;
+    entry.value = 42;
+    entry.attributes[Maliit::SettingEntryAttributes::defaultValue] = 7;
+
+    MImPluginSettingsInfo info;
+    info.description_language = "en";
+    info.plugin_name = "plugin";
+    info.plugin_description = "Plugin";
+    info.extension_id = 5;
+    info.entries.append(entry);
+
+    server->pluginSettingsLoaded(clientId, QList<MImPluginSettingsInfo>() << info);
+
+    QTRY_COMPARE(received.count(), 1);
+    const QList<MImPluginSettingsInfo> settings = received.first().first().value<QList<MImPluginSettingsInfo> >();
+    QCOMPARE(settings.size(), 1);
+    QCOMPARE(settings.first().plugin_name, QString("plugin"));
+    QCOMPARE(settings.first().extension_id, 5);
+    QCOMPARE(settings.first().entries.size(), 1);
+    QCOMPARE(settings.first().entries.first().extension_key, QString("/plugin/entry"));
+    QCOMPARE(settings.first().entries.first().type, Maliit::IntType);
+    QCOMPARE(settings.first().entries.first().value.toInt(), 42);
+    QCOMPARE(settings.first().entries.first().attributes.value(Maliit::SettingEntryAttributes::defaultValue).toInt(), 7);
+}
+
+void Ut_UnixSocketConnection::testRequests()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    WidgetQueryResponder responder;
+    connect(client, SIGNAL(getPreeditRectangle(QRect&,bool&)),
+            &responder, SLOT(getPreeditRectangle(QRect&,bool&)));
+    connect(client, SIGNAL(getSelection(QString&,bool&)),
+            &responder, SLOT(getSelection(QString&,bool&)));
+
+    QSignalSpy rectangles(server, SIGNAL(preeditRectangleReceived(int,QRect,bool)));
+    QSignalSpy selections(server, SIGNAL(selectionReceived(int,QString,bool)));
+
+    const int rectangleRequest = server->requestPreeditRectangle();
+    const int selectionRequest = server->requestSelection();
+    QVERIFY(rectangleRequest != selectionRequest);
+
+    QTRY_COMPARE(selections.count(), 1);
+    QCOMPARE(rectangles.count(), 1);
+
+    QCOMPARE(rectangles.first().at(0).toInt(), rectangleRequest);
+    QCOMPARE(rectangles.first().at(1).toRect(), QRect(1, 2, 3, 4));
+    QCOMPARE(rectangles.first().at(2).toBool(), true);
+
+    QCOMPARE(selections.first().at(0).toInt(), selectionRequest);
+    QCOMPARE(selections.first().at(1).toString(), QString("selected"));
+    QCOMPARE(selections.first().at(2).toBool(), true);
+}
+
+void Ut_UnixSocketConnection::testSynchronizedReset()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    QSignalSpy resets(server, SIGNAL(resetInputMethodRequest()));
+    QSignalSpy commits(client, SIGNAL(commitString(QString,int,int,int)));
+
+    client->reset(false);
+    QVERIFY(!client->pendingResets());
+    QTRY_COMPARE(resets.count(), 1);
+
+    server->sendCommitString("before", 0, 0, -1);
+
+    // nothing to wait for, "before" reaches the application after the new epoch started
+    client->reset(true);
+    QVERIFY(!client->pendingResets());
+    QTRY_COMPARE(resets.count(), 2);
+
+    server->sendCommitString("after", 0, 0, -1);
+
+    QTRY_COMPARE(commits.count(), 1);
+    QCOMPARE(commits.first().first().toString(), QString("after"));
+}
+
+void Ut_UnixSocketConnection::testDisconnection()
+{
+    QVERIFY(connectPair("unix-socket"));
+
+    QSignalSpy disconnected(server, SIGNAL(clientDisconnected(uint)));
+    QSignalSpy rectangles(server, SIGNAL(preeditRectangleReceived(int,QRect,bool)));
+
+    // never answered, the application goes away first
+    const int requestId = server->requestPreeditRectangle();
+    delete client;
+    client = 0;
+
+    QTRY_COMPARE(disconnected.count(), 1);
+    QCOMPARE(disconnected.first().first().toUInt(), clientId);
+
+    QCOMPARE(rectangles.count(), 1);
+    QCOMPARE(rectangles.first().at(0).toInt(), requestId);
+    QCOMPARE(rectangles.first().at(2).toBool(), false);
+}
+
+void Ut_UnixSocketConnection::testKeyRepeatCoalescing_data()
+{
+    QTest::addColumn<bool>("releases");
+    QTest::addColumn<QStringList>("expectedCalls");
+
+    // The first autorepeat press goes out right away, with the release before it
+    QTest::newRow("release and press")
+        << true
+        << (QStringList() << "press first" << "release autorepeat" << "press autorepeat"
+                          << "3 repeats with releases" << "reset");
+    QTest::newRow("press only")
+        << false
+        << (QStringList() << "press first" << "press autorepeat" << "3 repeats" << "reset");
+}
+
+void Ut_UnixSocketConnection::testKeyRepeatCoalescing()
+{
+    QFETCH(bool, releases);
+    QFETCH(QStringList, expectedCalls);
+
+    QVERIFY(connectPair("dbus"));
+    // Only version 2 servers get coalesced autorepeats
+    QTRY_VERIFY(static_cast<DBusServerConnection *>(client)->mSequencedProxy);
+
+    CallRecorder recorder(server);
+
+    // Four autorepeats piling up within one event loop iteration
+    client->processKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a", false, 1, 38, 0, 100);
+    for (int i = 1; i <= 4; ++i) {
+        if (releases) {
+            client->processKeyEvent(QEvent::KeyRelease, Qt::Key_A, Qt::NoModifier, "a", true, 1, 38, 0, 100 + i);
+        }
+        client->processKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a", true, 1, 38, 0, 100 + i);
+    }
+
+    // Reaches the server after the autorepeats sent before it
+    client->reset(false);
+
+    QTRY_COMPARE(recorder.calls, expectedCalls);
+}
+
+void Ut_UnixSocketConnection::testBulkCalls()
+{
+    QVERIFY(connectPair("dbus"));
+
+    DBusInputContextConnection *dbusServer = static_cast<DBusInputContextConnection *>(server);
+    const DBusInputContextConnection::InboundQueueCounters before = dbusServer->inboundQueueCounters();
+    CallRecorder recorder(server);
+
+    // Bulk calls keep their order among each other, wherever critical calls end up
+    for (int i = 0; i < 10; ++i) {
+        client->setExtendedAttribute(1, "/toolbar", "item", "size", i);
+    }
+    client->showInputMethod();
+
+    QTRY_COMPARE(recorder.calls.size(), 11);
+    QVERIFY(recorder.calls.contains("show"));
+    recorder.calls.removeAll("show");
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(recorder.calls.at(i), QString("attribute 1 size %1").arg(i));
+    }
+
+    // The widget state refers to the attribute extension registered before it
+    recorder.calls.clear();
+    client->registerAttributeExtension(2, "toolbar.xml");
+    client->setExtendedAttribute(2, "/toolbar", "item", "enabled", false);
+    QVariantMap state;
+    state["focusState"] = true;
+    state["toolbarId"] = 2;
+    client->updateWidgetInformation(state, true);
+
+    QTRY_COMPARE(recorder.calls, QStringList() << "register 2 toolbar.xml" << "attribute 2 enabled false"
+                                               << "widget state");
+
+    const DBusInputContextConnection::InboundQueueCounters after = dbusServer->inboundQueueCounters();
+    QCOMPARE(after.bulkDepth, 0);
+    QVERIFY(after.bulkMaximumDepth >= 1);
+    QCOMPARE(after.bulkHandled - before.bulkHandled, quint64(12));
+    QVERIFY(after.handedOver - before.handedOver >= 14);
+}
+
+void Ut_UnixSocketConnection::benchmarkRoundTrip_data()
+{
+    QTest::addColumn<QString>("transport");
+
+    QTest::newRow("unix-socket") << "unix-socket";
+    QTest::newRow("dbus") << "dbus";
+}
+
+void Ut_UnixSocketConnection::benchmarkRoundTrip()
+{
+    QFETCH(QString, transport);
+    QVERIFY(connectPair(transport));
+
+    // showInputMethod() to the server, a commit string back to the application
+    CommitEcho echo(server);
+    connect(server, SIGNAL(showInputMethodRequest()), &echo, SLOT(echo()));
+
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.setInterval(RoundTripTimeout);
+    connect(client, SIGNAL(commitString(QString,int,int,int)), &loop, SLOT(quit()));
+    connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+
+    QSignalSpy commits(client, SIGNAL(commitString(QString,int,int,int)));
+    int roundTrips = 0;
+
+    QBENCHMARK {
+        client->showInputMethod();
+        timeout.start();
+        loop.exec();
+        ++roundTrips;
+    }
+
+    QCOMPARE(commits.count(), roundTrips);
+}
+
+QTEST_MAIN(Ut_UnixSocketConnection)
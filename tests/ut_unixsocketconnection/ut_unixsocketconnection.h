@@ -0,0 +1,112 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_UNIXSOCKETCONNECTION_H
+#define UT_UNIXSOCKETCONNECTION_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QTemporaryDir>
+
+class MInputContextConnection;
+class MImServerConnection;
+
+namespace Maliit {
+    class WidgetState;
+}
+
+//! Answers every showInputMethod() with a commit string, for measuring round trips
+class CommitEcho : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CommitEcho(MInputContextConnection *connection);
+
+public Q_SLOTS:
+    void echo();
+
+private:
+    MInputContextConnection *mConnection;
+};
+
+//! Answers the preedit rectangle and selection queries of the server
+class WidgetQueryResponder : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void getPreeditRectangle(QRect &rectangle, bool &valid);
+    void getSelection(QString &selection, bool &valid);
+};
+
+//! Records the calls the server received, in order
+class CallRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CallRecorder(MInputContextConnection *connection);
+
+    QStringList calls;
+
+public Q_SLOTS:
+    void receivedKeyEvent(QEvent::Type keyType, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                          const QString &text, bool autoRepeat, int count,
+                          quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    void receivedKeyRepeat(Qt::Key keyCode, Qt::KeyboardModifiers modifiers, const QString &text,
+                           int repeats, bool releases,
+                           quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    void resetInputMethodRequest();
+    void showInputMethodRequest();
+    void attributeExtensionRegistered(unsigned int connectionId, int id, const QString &attributeExtension);
+    void extendedAttributeChanged(unsigned int connectionId, int id, const QString &target,
+                                  const QString &targetName, const QString &attribute, const QVariant &value);
+    void widgetStateChanged(unsigned int clientId, const Maliit::WidgetState &newState,
+                            const Maliit::WidgetState &oldState, bool focusChanged);
+};
+
+class Ut_UnixSocketConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testFrame();
+    void testMalformedFrame();
+    void testApplicationToServer();
+    void testServerToApplication();
+    void testPluginSettings();
+    void testRequests();
+    void testSynchronizedReset();
+    void testDisconnection();
+    void testKeyRepeatCoalescing_data();
+    void testKeyRepeatCoalescing();
+    void testBulkCalls();
+
+    void benchmarkRoundTrip_data();
+    void benchmarkRoundTrip();
+
+private:
+    //! Connects a server and an application over \a transport, "unix-socket" or "dbus"
+    bool connectPair(const QString &transport);
+
+    QTemporaryDir *directory;
+    MInputContextConnection *server;
+    MImServerConnection *client;
+    unsigned int clientId;
+};
+
+#endif // UT_UNIXSOCKETCONNECTION_H
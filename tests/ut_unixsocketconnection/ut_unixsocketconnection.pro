@@ -0,0 +1,14 @@
+include(../common_top.pri)
+
+QT += gui
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_unixsocketconnection.h \
+
+SOURCES += \
+    ut_unixsocketconnection.cpp \
+
+include(../common_check.pri)
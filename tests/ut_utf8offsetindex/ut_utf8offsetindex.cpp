@@ -0,0 +1,150 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_utf8offsetindex.h"
+
+#include <utf8offsetindex.h>
+
+namespace {
+    // "Grinning face", outside the BMP
+    const ushort Emoji[] = { 0xd83d, 0xde00 };
+
+    QString emoji()
+    {
+        return QString::fromUtf16(Emoji, 2);
+    }
+
+    //! Long enough for several blocks and SIMD chunks, with characters of every length
+    QString mixedText()
+    {
+        QString text;
+        for (int i = 0; i < 40; ++i) {
+            text += QString::fromLatin1("abc");
+            text += QChar(0x00e9); // 2 bytes
+            text += QChar(0x4e2d); // 3 bytes
+            if (i % 7 == 0) {
+                text += emoji();
+            }
+        }
+        return text;
+    }
+}
+
+void Ut_Utf8OffsetIndex::testUtf8Length_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("ascii") << QString::fromLatin1("The quick brown fox jumps over the lazy dog");
+    QTest::newRow("long ascii") << QString(1000, QChar('x'));
+    QTest::newRow("mixed") << mixedText();
+}
+
+void Ut_Utf8OffsetIndex::testUtf8Length()
+{
+    QFETCH(QString, text);
+
+    QCOMPARE(Utf8OffsetIndex::utf8Length(text.constData(), text.size()), text.toUtf8().size());
+    QCOMPARE(Utf8OffsetIndex(text).utf8Size(), text.toUtf8().size());
+
+    for (int start = 0; start < text.size(); start += 5) {
+        const QStringRef part = text.midRef(start, 37);
+        // halves of pairs are encoded differently by Qt versions
+        if (part.at(0).isLowSurrogate() || part.at(part.size() - 1).isHighSurrogate()) {
+            continue;
+        }
+        QCOMPARE(Utf8OffsetIndex::utf8Length(part), part.toUtf8().size());
+    }
+}
+
+void Ut_Utf8OffsetIndex::testOffsets_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("ascii") << QString(300, QChar('x'));
+    QTest::newRow("mixed") << mixedText();
+}
+
+void Ut_Utf8OffsetIndex::testOffsets()
+{
+    QFETCH(QString, text);
+
+    const Utf8OffsetIndex index(text);
+    const QByteArray utf8 = text.toUtf8();
+
+    for (int position = 0; position <= text.size(); ++position) {
+        if (position > 0 && text.at(position - 1).isHighSurrogate()) {
+            continue;
+        }
+
+        const int offset = text.leftRef(position).toUtf8().size();
+        QCOMPARE(index.utf8Offset(position), offset);
+        QCOMPARE(index.utf16Offset(offset), QString::fromUtf8(utf8.constData(), offset).size());
+    }
+}
+
+void Ut_Utf8OffsetIndex::testSurrogatePairs()
+{
+    // The pair starts at the last unit of the first block
+    QString text(Utf8OffsetIndex::BlockSize - 1, QChar('a'));
+    text += emoji();
+    text += QChar('b');
+
+    const int pair = Utf8OffsetIndex::BlockSize - 1;
+    const Utf8OffsetIndex index(text);
+
+    QCOMPARE(index.utf8Size(), text.toUtf8().size());
+    QCOMPARE(index.utf8Offset(pair), pair);
+    QCOMPARE(index.utf8Offset(pair + 2), pair + 4);
+    // positions and offsets inside the pair belong to its end
+    QCOMPARE(index.utf8Offset(pair + 1), pair + 4);
+    QCOMPARE(index.utf16Offset(pair + 2), pair + 2);
+    QCOMPARE(index.utf16Offset(pair + 4), pair + 2);
+    QCOMPARE(index.utf16Offset(pair + 5), pair + 3);
+}
+
+void Ut_Utf8OffsetIndex::testClamping()
+{
+    const QString text = QString::fromUtf8("h\xc3\xa9llo");
+    const Utf8OffsetIndex index(text);
+
+    QCOMPARE(index.utf8Offset(-1), 0);
+    QCOMPARE(index.utf8Offset(100), 6);
+    QCOMPARE(index.utf16Offset(-1), 0);
+    QCOMPARE(index.utf16Offset(100), 5);
+    // inside the two bytes of the e with acute
+    QCOMPARE(index.utf16Offset(2), 2);
+
+    const Utf8OffsetIndex empty;
+    QCOMPARE(empty.utf8Size(), 0);
+    QCOMPARE(empty.utf8Offset(3), 0);
+    QCOMPARE(empty.utf16Offset(3), 0);
+}
+
+void Ut_Utf8OffsetIndex::testSharedText()
+{
+    QString text = mixedText();
+    Utf8OffsetIndex index(text);
+    const QString copy = text;
+
+    index.setText(copy);
+    QVERIFY(index.text().constData() == text.constData());
+
+    // edited text is indexed again
+    text.prepend(emoji());
+    index.setText(text);
+    QCOMPARE(index.utf8Size(), text.toUtf8().size());
+    QCOMPARE(index.utf8Offset(2), 4);
+}
+
+QTEST_MAIN(Ut_Utf8OffsetIndex)
@@ -0,0 +1,12 @@
+include(../common_top.pri)
+
+include($$TOP_DIR/connection/libmaliit-connection.pri)
+
+# Input
+HEADERS += \
+    ut_utf8offsetindex.h \
+
+SOURCES += \
+    ut_utf8offsetindex.cpp \
+
+include(../common_check.pri)
@@ -0,0 +1,121 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#include "ut_widgetstate.h"
+
+#include <maliit/widgetstate.h>
+#include <maliit/namespaceinternal.h>
+
+namespace {
+    QVariantMap sampleState()
+    {
+        QVariantMap map;
+        map.insert("focusState", true);
+        map.insert("contentType", 3);
+        map.insert("surroundingText", QString("Hello world"));
+        map.insert("cursorPosition", 5);
+        map.insert("anchorPosition", 5);
+        map.insert("winId", qulonglong(42));
+        map.insert("cursorRectangle", QRect(1, 2, 3, 4));
+        map.insert("preeditRectangle", QRect(5, 6, 7, 8));
+        map.insert("selection", QString("world"));
+        map.insert("surroundingTextOffset", 20);
+        map.insert("surroundingTextLength", 31);
+        map.insert(Maliit::Internal::inputMethodHints, qint64(Qt::ImhNoAutoUppercase));
+        map.insert("someExtension", QString("value"));
+        return map;
+    }
+}
+
+void Ut_WidgetState::testFromVariantMap()
+{
+    const Maliit::WidgetState state = Maliit::WidgetState::fromVariantMap(sampleState());
+
+    QVERIFY(state.contains(Maliit::WidgetState::FocusState));
+    QCOMPARE(state.focusState(), true);
+    QCOMPARE(state.contentType(), 3);
+    QCOMPARE(state.surroundingText(), QString("Hello world"));
+    QCOMPARE(state.cursorPosition(), 5);
+    QCOMPARE(state.anchorPosition(), 5);
+    QCOMPARE(state.winId(), qulonglong(42));
+    QCOMPARE(state.cursorRectangle(), QRect(1, 2, 3, 4));
+    QCOMPARE(state.preeditRectangle(), QRect(5, 6, 7, 8));
+    QCOMPARE(state.selection(), QString("world"));
+    QCOMPARE(state.surroundingTextOffset(), 20);
+    QCOMPARE(state.surroundingTextLength(), 31);
+    QCOMPARE(state.inputMethodHints(), qint64(Qt::ImhNoAutoUppercase));
+
+    QVERIFY(not state.contains(Maliit::WidgetState::HiddenText));
+    QCOMPARE(state.hiddenText(), false);
+
+    QCOMPARE(state.extensions().count(), 1);
+    QCOMPARE(state.value("someExtension").toString(), QString("value"));
+    QVERIFY(not state.value("missing").isValid());
+}
+
+void Ut_WidgetState::testRoundTrip()
+{
+    const QVariantMap map = sampleState();
+    const Maliit::WidgetState state = Maliit::WidgetState::fromVariantMap(map);
+
+    QCOMPARE(state.toVariantMap(), map);
+    QVERIFY(Maliit::WidgetState::fromVariantMap(state.toVariantMap()) == state);
+}
+
+void Ut_WidgetState::testInvalidValues()
+{
+    Maliit::WidgetState state;
+
+    state.insert("contentType", QString("not a number"));
+    QVERIFY(not state.contains(Maliit::WidgetState::ContentType));
+
+    state.insert("winId", uint(7));
+    QCOMPARE(state.winId(), qulonglong(7));
+
+    state.insert("winId", QVariant());
+    QVERIFY(not state.contains("winId"));
+    QVERIFY(state.isEmpty());
+}
+
+void Ut_WidgetState::testChangedKeys()
+{
+    const Maliit::WidgetState oldState = Maliit::WidgetState::fromVariantMap(sampleState());
+    Maliit::WidgetState newState = oldState;
+
+    QVERIFY(newState.changedKeys(oldState).isEmpty());
+
+    newState.setCursorPosition(6);
+    newState.setHiddenText(true);
+    newState.insert("someExtension", QString("other value"));
+
+    QStringList changed = newState.changedKeys(oldState);
+    changed.sort();
+    QCOMPARE(changed, QStringList() << "cursorPosition" << "hiddenText" << "someExtension");
+    QCOMPARE(newState.changedAttributes(oldState),
+             Maliit::WidgetState::Attributes(Maliit::WidgetState::CursorPosition
+                                             | Maliit::WidgetState::HiddenText));
+}
+
+void Ut_WidgetState::testRemove()
+{
+    Maliit::WidgetState state = Maliit::WidgetState::fromVariantMap(sampleState());
+
+    state.remove("surroundingText");
+    state.remove("someExtension");
+
+    QVERIFY(not state.contains(Maliit::WidgetState::SurroundingText));
+    QVERIFY(state.extensions().isEmpty());
+    QVERIFY(not state.toVariantMap().contains("surroundingText"));
+}
+
+QTEST_MAIN(Ut_WidgetState)
@@ -0,0 +1,32 @@
+/* * This file is part of Maliit framework *
+ *
+ * Copyright (C) 2013 Jolla Ltd.
+ *
+ * Contact: maliit-discuss@lists.maliit.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+#ifndef UT_WIDGETSTATE_H
+#define UT_WIDGETSTATE_H
+
+#include <QtTest/QtTest>
+#include <QObject>
+
+class Ut_WidgetState : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFromVariantMap();
+    void testRoundTrip();
+    void testInvalidValues();
+    void testChangedKeys();
+    void testRemove();
+};
+
+#endif // UT_WIDGETSTATE_H
@@ -0,0 +1,12 @@
+include(../common_top.pri)
+
+include($$TOP_DIR/common/libmaliit-common.pri)
+
+# Input
+HEADERS += \
+    ut_widgetstate.h \
+
+SOURCES += \
+    ut_widgetstate.cpp \
+
+include(../common_check.pri)